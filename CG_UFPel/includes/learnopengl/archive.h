@@ -0,0 +1,395 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/cache.h>
+#include <learnopengl/job_system.h>
+#include <learnopengl/log.h>
+
+#include <string>
+#include <vector>
+#include <set>
+#include <mutex>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Packed resources: every file under resources/ in one archive (built by src/pack_assets), mapped into memory once.
+// Layout: ArchiveHeader, ArchiveEntry[count] sorted by path hash, the paths, then the file data, each 16 byte aligned.
+// Files are stored as is (images are compressed already and can be read in place) or, when it pays off, with the small
+// LZ77 codec below.
+const uint32_t ARCHIVE_MAGIC   = 0x4b41504c; // "LPAK"
+const uint32_t ARCHIVE_VERSION = 1;
+const uint32_t ARCHIVE_STORED  = 0;
+const uint32_t ARCHIVE_LZ      = 1;
+const size_t ARCHIVE_ALIGNMENT = 16;
+
+struct ArchiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t namesSize;
+};
+
+struct ArchiveEntry {
+    uint64_t hash;       // Cache::Hash of the path relative to the root, '/' separated
+    uint64_t offset;     // from the start of the archive
+    uint64_t size;       // uncompressed
+    uint64_t storedSize;
+    uint32_t compression;
+    uint32_t nameOffset; // in the path table
+    uint32_t nameSize;
+    uint32_t reserved;
+};
+
+// LZ77 with LZ4 style sequences: a token (literal count << 4 | match length - 4, 15 continues in 255 runs), the
+// literals, a 2 byte offset and the rest of the match length. The last sequence has literals only.
+const int ARCHIVE_LZ_MIN_MATCH = 4;
+const int ARCHIVE_LZ_HASH_BITS = 16;
+
+void ArchiveWriteLength(std::vector<char> &out, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        out.push_back((char)255);
+    out.push_back((char)length);
+}
+
+void ArchiveCompress(const char* src, size_t size, std::vector<char> &out)
+{
+    out.clear();
+    std::vector<size_t> table((size_t)1 << ARCHIVE_LZ_HASH_BITS, (size_t)-1);
+    size_t anchor = 0, pos = 0;
+    while (pos + ARCHIVE_LZ_MIN_MATCH <= size)
+    {
+        uint32_t sequence;
+        std::memcpy(&sequence, src + pos, 4);
+        uint32_t slot = (sequence * 2654435761u) >> (32 - ARCHIVE_LZ_HASH_BITS);
+        size_t candidate = table[slot];
+        table[slot] = pos;
+        if (candidate == (size_t)-1 || pos - candidate > 0xFFFF || std::memcmp(src + candidate, src + pos, 4) != 0)
+        {
+            pos++;
+            continue;
+        }
+        size_t length = 4;
+        while (pos + length < size && src[candidate + length] == src[pos + length])
+            length++;
+
+        size_t literals = pos - anchor, extra = length - ARCHIVE_LZ_MIN_MATCH;
+        out.push_back((char)((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(extra, 15)));
+        if (literals >= 15)
+            ArchiveWriteLength(out, literals - 15);
+        out.insert(out.end(), src + anchor, src + pos);
+        size_t offset = pos - candidate;
+        out.push_back((char)(offset & 0xFF));
+        out.push_back((char)(offset >> 8));
+        if (extra >= 15)
+            ArchiveWriteLength(out, extra - 15);
+        pos += length;
+        anchor = pos;
+    }
+    size_t literals = size - anchor;
+    out.push_back((char)(std::min<size_t>(literals, 15) << 4));
+    if (literals >= 15)
+        ArchiveWriteLength(out, literals - 15);
+    out.insert(out.end(), src + anchor, src + size);
+}
+
+// decodes exactly dstSize bytes; false for malformed input
+bool ArchiveDecompress(const char* src, size_t srcSize, char* dst, size_t dstSize)
+{
+    const unsigned char* in = (const unsigned char*)src;
+    const unsigned char* end = in + srcSize;
+    size_t out = 0;
+    for (;;)
+    {
+        if (in >= end)
+            return false;
+        unsigned int token = *in++;
+        size_t literals = token >> 4;
+        if (literals == 15)
+            for (unsigned int b = 255; b == 255; literals += b)
+            {
+                if (in >= end)
+                    return false;
+                b = *in++;
+            }
+        if (literals > (size_t)(end - in) || literals > dstSize - out)
+            return false;
+        std::memcpy(dst + out, in, literals);
+        in += literals;
+        out += literals;
+        if (in == end)
+            return out == dstSize;
+
+        if (end - in < 2)
+            return false;
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        size_t length = (token & 15) + ARCHIVE_LZ_MIN_MATCH;
+        if ((token & 15) == 15)
+            for (unsigned int b = 255; b == 255; length += b)
+            {
+                if (in >= end)
+                    return false;
+                b = *in++;
+            }
+        if (offset == 0 || offset > out || length > dstSize - out)
+            return false;
+        // byte by byte: the match may overlap what it is producing
+        for (size_t i = 0; i < length; i++, out++)
+            dst[out] = dst[out - offset];
+    }
+}
+
+// archive key of a path: relative to the root, with '/' separators
+std::string ArchiveKey(const std::string &path)
+{
+    std::string key = path;
+    std::replace(key.begin(), key.end(), '\\', '/');
+    std::string root = FileSystem::getPath("");
+    if (key.compare(0, root.size(), root) == 0)
+        key = key.substr(root.size());
+    while (key.compare(0, 2, "./") == 0)
+        key = key.substr(2);
+    return key;
+}
+
+// A mapped archive. Lookups are a binary search over the hashes; the data of stored files is used in place.
+class Archive
+{
+public:
+    Archive() : base(NULL), mappedSize(0), header(NULL), entries(NULL), names(NULL) {}
+    ~Archive() { close(); }
+
+    // the resources archive, opened on first use (from any thread) from LOGL_ARCHIVE_PATH or the build directory's
+    // resources.pak. Without one every resource is read from its loose file.
+    static Archive &Resources()
+    {
+        static Archive archive;
+        static std::once_flag opened;
+        std::call_once(opened, []() {
+            const char* path = std::getenv("LOGL_ARCHIVE_PATH");
+            archive.open(path ? std::string(path) : std::string(logl_archive));
+        });
+        return archive;
+    }
+
+    bool open(const std::string &path)
+    {
+        close();
+        if (!map(path))
+            return false;
+        header = (const ArchiveHeader*)base;
+        if (mappedSize < sizeof(ArchiveHeader) || header->magic != ARCHIVE_MAGIC || header->version != ARCHIVE_VERSION ||
+            mappedSize < sizeof(ArchiveHeader) + (size_t)header->count * sizeof(ArchiveEntry) + header->namesSize)
+        {
+            LOG_WARN("ARCHIVE:: %s is not a valid archive, using loose files", path);
+            close();
+            return false;
+        }
+        entries = (const ArchiveEntry*)(base + sizeof(ArchiveHeader));
+        names = base + sizeof(ArchiveHeader) + (size_t)header->count * sizeof(ArchiveEntry);
+        LOG_INFO("ARCHIVE:: %s mapped, %u files", path, header->count);
+        return true;
+    }
+
+    bool isOpen() const { return base != NULL; }
+
+    // the entry of a path (as built by FileSystem::getPath or relative to the root), NULL when it isn't archived
+    const ArchiveEntry* find(const std::string &path) const
+    {
+        if (!base)
+            return NULL;
+        std::string key = ArchiveKey(path);
+        uint64_t hash = Cache::Hash(key);
+        const ArchiveEntry* first = entries;
+        const ArchiveEntry* last = entries + header->count;
+        while (first < last)
+        {
+            const ArchiveEntry* middle = first + (last - first) / 2;
+            if (middle->hash < hash)
+                first = middle + 1;
+            else
+                last = middle;
+        }
+        for (; first < entries + header->count && first->hash == hash; first++)
+            if (key.size() == first->nameSize && key.compare(0, key.size(), names + first->nameOffset, first->nameSize) == 0)
+                return first;
+        return NULL;
+    }
+
+    // the bytes of an entry: in place for stored files, decompressed into storage otherwise
+    bool read(const ArchiveEntry* entry, const char* &data, size_t &size, std::vector<char> &storage) const
+    {
+        if (entry->offset + entry->storedSize > mappedSize)
+            return false;
+        const char* stored = base + entry->offset;
+        size = (size_t)entry->size;
+        if (entry->compression == ARCHIVE_STORED)
+        {
+            data = stored;
+            return true;
+        }
+        storage.resize(size);
+        if (entry->compression != ARCHIVE_LZ || (size && !ArchiveDecompress(stored, (size_t)entry->storedSize, &storage[0], size)))
+        {
+            LOG_ERROR("ARCHIVE:: can't decode %s", std::string(names + entry->nameOffset, entry->nameSize));
+            return false;
+        }
+        data = size ? &storage[0] : stored;
+        return true;
+    }
+
+    void close()
+    {
+        if (!base)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+#else
+        munmap((void*)base, mappedSize);
+#endif
+        base = NULL;
+        mappedSize = 0;
+        header = NULL;
+        entries = NULL;
+        names = NULL;
+    }
+
+private:
+    const char* base;
+    size_t mappedSize;
+    const ArchiveHeader* header;
+    const ArchiveEntry* entries;
+    const char* names;
+
+    Archive(const Archive &) = delete;
+    Archive &operator=(const Archive &) = delete;
+
+    bool map(const std::string &path)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        HANDLE mapping = fileSize.QuadPart ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+        CloseHandle(file);
+        if (!mapping)
+            return false;
+        base = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        mappedSize = (size_t)fileSize.QuadPart;
+#else
+        int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0)
+            return false;
+        struct stat info;
+        void* mapped = MAP_FAILED;
+        if (fstat(file, &info) == 0 && info.st_size > 0)
+            mapped = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        ::close(file);
+        if (mapped == MAP_FAILED)
+            return false;
+        base = (const char*)mapped;
+        mappedSize = (size_t)info.st_size;
+#endif
+        return base != NULL;
+    }
+};
+
+// Contents of a resource file. data points into the mapped archive when the file is stored there uncompressed, so
+// nothing is copied; otherwise it points into owned.
+struct ResourceData {
+    const char* data;
+    size_t size;
+    std::vector<char> owned;
+
+    ResourceData() : data(NULL), size(0) {}
+    // data may point into owned, so copies would dangle
+    ResourceData(const ResourceData &) = delete;
+    ResourceData &operator=(const ResourceData &) = delete;
+};
+
+// Told about the resources read while it is installed, by the threads whose JobSystem::Context() is the listener: the
+// one that installed it and the jobs queued on its behalf (AssetDatabase records what an import depends on this way).
+class ResourceReadListener
+{
+public:
+    virtual ~ResourceReadListener() {}
+    virtual void resourceRead(const std::string &path, const char* data, size_t size) = 0;
+};
+
+// hot reload state: the installed listener, and the files read from disk even though the archive has them (edited
+// since it was packed)
+struct ResourceHooks {
+    std::mutex lock;
+    ResourceReadListener* listener;
+    std::set<std::string> loose;
+
+    ResourceHooks() : listener(NULL) {}
+
+    static ResourceHooks &Get()
+    {
+        static ResourceHooks hooks;
+        return hooks;
+    }
+};
+
+// makes ReadResource read path from its loose file from now on
+void PreferLooseResource(const std::string &path)
+{
+    std::lock_guard<std::mutex> guard(ResourceHooks::Get().lock);
+    ResourceHooks::Get().loose.insert(path);
+}
+
+bool ReadResourceData(const std::string &path, ResourceData &resource)
+{
+    bool loose;
+    {
+        std::lock_guard<std::mutex> guard(ResourceHooks::Get().lock);
+        loose = ResourceHooks::Get().loose.count(path) != 0;
+    }
+    const ArchiveEntry* entry = loose ? NULL : Archive::Resources().find(path);
+    if (entry)
+        return Archive::Resources().read(entry, resource.data, resource.size, resource.owned) && resource.size > 0;
+
+    std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    resource.owned.resize((size_t)file.tellg());
+    file.seekg(0, std::ios::beg);
+    if (resource.owned.empty() || !file.read(&resource.owned[0], resource.owned.size()))
+        return false;
+    resource.data = &resource.owned[0];
+    resource.size = resource.owned.size();
+    return true;
+}
+
+// reads a resource from the archive, or from its loose file when it isn't archived. Empty files count as missing.
+bool ReadResource(const std::string &path, ResourceData &resource)
+{
+    if (!ReadResourceData(path, resource))
+        return false;
+    std::lock_guard<std::mutex> guard(ResourceHooks::Get().lock);
+    ResourceReadListener* listener = ResourceHooks::Get().listener;
+    if (listener && JobSystem::Context() == listener)
+        listener->resourceRead(path, resource.data, resource.size);
+    return true;
+}
+#endif
@@ -0,0 +1,86 @@
+#ifndef ARCHIVE_IO_H
+#define ARCHIVE_IO_H
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include <learnopengl/archive.h>
+
+#include <string>
+#include <fstream>
+#include <cstring>
+
+// Read only Assimp stream over a resource, in place in the mapped archive when it is stored there uncompressed
+class ArchiveIOStream : public Assimp::IOStream
+{
+public:
+    ResourceData resource;
+
+    ArchiveIOStream() : position(0) {}
+
+    size_t Read(void* pvBuffer, size_t pSize, size_t pCount)
+    {
+        if (pSize == 0)
+            return 0;
+        size_t count = std::min(pCount, (resource.size - position) / pSize);
+        std::memcpy(pvBuffer, resource.data + position, count * pSize);
+        position += count * pSize;
+        return count;
+    }
+
+    size_t Write(const void* pvBuffer, size_t pSize, size_t pCount)
+    {
+        return 0;
+    }
+
+    aiReturn Seek(size_t pOffset, aiOrigin pOrigin)
+    {
+        size_t target = pOrigin == aiOrigin_SET ? pOffset : pOrigin == aiOrigin_CUR ? position + pOffset : resource.size + pOffset;
+        if (target > resource.size)
+            return aiReturn_FAILURE;
+        position = target;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const { return position; }
+    size_t FileSize() const { return resource.size; }
+    void Flush() {}
+
+private:
+    size_t position;
+};
+
+// Lets Assimp read models and their material files through ReadResource, so they come out of the resources archive
+// (or their loose files without one). Writing isn't supported.
+class ArchiveIOSystem : public Assimp::IOSystem
+{
+public:
+    bool Exists(const char* pFile) const
+    {
+        return Archive::Resources().find(pFile) != NULL || (bool)std::ifstream(pFile);
+    }
+
+    char getOsSeparator() const
+    {
+        return '/';
+    }
+
+    Assimp::IOStream* Open(const char* pFile, const char* pMode = "rb")
+    {
+        if (std::strchr(pMode, 'w') || std::strchr(pMode, 'a'))
+            return NULL;
+        ArchiveIOStream* stream = new ArchiveIOStream();
+        if (!ReadResource(pFile, stream->resource))
+        {
+            delete stream;
+            return NULL;
+        }
+        return stream;
+    }
+
+    void Close(Assimp::IOStream* pFile)
+    {
+        delete pFile;
+    }
+};
+#endif
@@ -0,0 +1,144 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+
+// Linear (bump) allocators. Importing a model makes a lot of short lived arrays and hash nodes; with an arena each of
+// them is a pointer increment and the whole load's temporaries are freed in one go. The frame arena holds transient
+// per-frame data and is rewound once a frame. Arenas aren't thread safe: parallel code uses one per thread.
+
+// heap allocations so far, counted by the application's operator new when it replaces it (LOGL_BENCHMARKS builds, for
+// --bench-import)
+std::atomic<unsigned long long> HeapAllocations(0);
+
+// when false the import temporaries use the heap like ordinary containers, for comparing the two (--bench-import)
+bool ImportArenasEnabled = true;
+
+class Arena
+{
+public:
+    explicit Arena(size_t blockSize = 64 * 1024) : blockSize(blockSize), current(0), offset(0) {}
+
+    ~Arena()
+    {
+        for (size_t i = 0; i < blocks.size(); i++)
+            std::free(blocks[i].data);
+    }
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t))
+    {
+        for (; current < blocks.size(); current++, offset = 0)
+        {
+            size_t start = (offset + align - 1) & ~(align - 1);
+            if (start + size <= blocks[current].size)
+            {
+                offset = start + size;
+                return blocks[current].data + start;
+            }
+        }
+        // a new block, at least twice the last one so a growing load needs few of them
+        Block block;
+        block.size = std::max(std::max(blockSize, size + align), blocks.empty() ? 0 : blocks.back().size * 2);
+        block.data = (char*)std::malloc(block.size);
+        if (!block.data)
+            throw std::bad_alloc();
+        blocks.push_back(block);
+        current = blocks.size() - 1;
+        offset = 0;
+        return allocate(size, align);
+    }
+
+    template <class T> T* allocate(size_t count)
+    {
+        return (T*)allocate(count * sizeof(T), alignof(T));
+    }
+
+    // frees everything allocated so far. The blocks are kept, merged into one when there were several, so an arena
+    // that is reset every frame settles on a single block of the size it needs.
+    void reset()
+    {
+        if (blocks.size() > 1)
+        {
+            size_t total = 0;
+            for (size_t i = 0; i < blocks.size(); i++)
+            {
+                total += blocks[i].size;
+                std::free(blocks[i].data);
+            }
+            blocks.clear();
+            Block block;
+            block.size = total;
+            block.data = (char*)std::malloc(total);
+            if (block.data)
+                blocks.push_back(block);
+        }
+        current = 0;
+        offset = 0;
+    }
+
+    size_t capacity() const
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < blocks.size(); i++)
+            total += blocks[i].size;
+        return total;
+    }
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    size_t blockSize;
+    std::vector<Block> blocks;
+    size_t current, offset;
+};
+
+// standard allocator over an arena; deallocate does nothing, the arena frees everything at once. Without an arena it
+// is the heap, so the same container types serve both cases.
+template <class T>
+struct ArenaAllocator {
+    typedef T value_type;
+    Arena* arena;
+
+    ArenaAllocator(Arena* arena = NULL) : arena(arena) {}
+    template <class U> ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T* allocate(size_t count)
+    {
+        return arena ? arena->allocate<T>(count) : (T*)::operator new(count * sizeof(T));
+    }
+
+    void deallocate(T* p, size_t)
+    {
+        if (!arena)
+            ::operator delete(p);
+    }
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena == b.arena; }
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena != b.arena; }
+
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+
+// the import arena to use, or none when they are disabled
+inline Arena* ImportArena(Arena &arena)
+{
+    return ImportArenasEnabled ? &arena : NULL;
+}
+
+// transient per-frame data, rewound by the application at the end of every frame
+Arena FrameArena;
+#endif
@@ -0,0 +1,265 @@
+#ifndef ASSET_DATABASE_H
+#define ASSET_DATABASE_H
+
+#include <learnopengl/archive.h>
+#include <learnopengl/cache.h>
+#include <learnopengl/upload_thread.h>
+#include <learnopengl/log.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <sys/stat.h>
+
+// Incremental reimport. Every asset is imported through a callback while ReadResource reads are recorded, so its
+// dependencies are exactly the files it read (model -> mtl -> textures, shader -> sources), each with the hash of the
+// contents it saw. A watcher thread polls those files; when one's contents really change, update() reimports only the
+// assets that read it. An import is split in two: building the new GPU resources, on the upload thread when there is
+// one, and swapping them in, on the render thread between frames once they have reached the GPU.
+class AssetDatabase : private ResourceReadListener
+{
+public:
+    // swaps a built asset in on the render thread, returning false (and keeping the old one) when it is unusable
+    typedef std::function<bool()> Swap;
+    // the callback builds the asset, returning an empty Swap (and keeping the old one) when that fails
+    typedef std::function<Swap()> Import;
+
+    // reimports are built on this thread when set, on the render thread inside update() otherwise
+    UploadThread *Uploads;
+
+    AssetDatabase() : Uploads(NULL), running(false) {}
+
+    ~AssetDatabase()
+    {
+        stopWatching();
+    }
+
+    // imports an asset now, on the calling thread; it is imported again whenever a file it read changes
+    bool add(const std::string &name, const Import &import)
+    {
+        Asset asset;
+        asset.name = name;
+        asset.import = import;
+        size_t index;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            assets.push_back(asset);
+            index = assets.size() - 1;
+        }
+        Swap swap = run(index);
+        return swap && swap();
+    }
+
+    // starts polling the recorded files every intervalMs milliseconds
+    void watch(int intervalMs = 250)
+    {
+        if (running)
+            return;
+        running = true;
+        watcher = std::thread([this, intervalMs]() {
+            while (running)
+            {
+                poll();
+                std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+            }
+        });
+    }
+
+    void stopWatching()
+    {
+        running = false;
+        if (watcher.joinable())
+            watcher.join();
+    }
+
+    // starts reimporting the assets whose files changed since the last call; call it at a frame boundary, on the GL
+    // thread. With an upload thread the new versions are swapped in by its poll() once they are built.
+    void update()
+    {
+        std::set<size_t> dirty;
+        size_t files;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (changed.empty())
+                return;
+            for (std::set<std::string>::iterator it = changed.begin(); it != changed.end(); ++it)
+            {
+                std::map<std::string, std::set<size_t> >::iterator users = dependents.find(*it);
+                if (users != dependents.end())
+                    dirty.insert(users->second.begin(), users->second.end());
+            }
+            files = changed.size();
+            changed.clear();
+        }
+        for (std::set<size_t>::iterator it = dirty.begin(); it != dirty.end(); ++it)
+        {
+            size_t index = *it;
+            if (Uploads)
+                Uploads->submit([this, index, files]() { return reimport(index, files); });
+            else
+                reimport(index, files)();
+        }
+    }
+
+private:
+    struct Asset {
+        std::string name;
+        Import import;
+        std::set<std::string> files;
+    };
+
+    // what the database last saw of a file: the hash of its contents, and the stat the watcher compares against
+    struct FileState {
+        uint64_t hash;
+        int64_t modified;
+        int64_t size;
+    };
+
+    std::mutex lock;
+    // held for a whole import, so the reads of one aren't recorded for another
+    std::mutex importLock;
+    std::vector<Asset> assets;
+    std::map<std::string, FileState> files;
+    std::map<std::string, std::set<size_t> > dependents;
+    std::set<std::string> changed;
+    std::atomic<bool> running;
+    std::thread watcher;
+
+    // files read by the import that is running (the reads may come from its jobs on other threads)
+    std::mutex recordLock;
+    std::map<std::string, uint64_t> recorded;
+
+    void resourceRead(const std::string &path, const char* data, size_t size)
+    {
+        std::lock_guard<std::mutex> guard(recordLock);
+        if (!recorded.count(path))
+            recorded[path] = Cache::Hash(data, size);
+    }
+
+    // builds a changed asset again and returns what swaps it in and reports the result, on the render thread
+    UploadThread::Completion reimport(size_t index, size_t files)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Swap swap = run(index);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::string name;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            name = assets[index].name;
+        }
+        return [swap, name, ms, files]() {
+            if (swap && swap())
+                LOG_INFO("ASSETS:: reimported %s in %.1f ms (%u files changed)", name, ms, (unsigned int)files);
+            else
+                LOG_ERROR("ASSETS:: reimport of %s failed, keeping the loaded version", name);
+        };
+    }
+
+    // runs an import with the reads recorded and replaces the asset's dependencies with them. Only the reads of this
+    // thread and the jobs it queues count, not the ones other threads make meanwhile.
+    Swap run(size_t index)
+    {
+        std::lock_guard<std::mutex> importing(importLock);
+        Import import;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            import = assets[index].import;
+        }
+        recorded.clear();
+        ResourceReadListener* listener = this;
+        const void* context = JobSystem::Context();
+        JobSystem::Context() = listener;
+        {
+            std::lock_guard<std::mutex> guard(ResourceHooks::Get().lock);
+            ResourceHooks::Get().listener = listener;
+        }
+        Swap swap = import();
+        {
+            std::lock_guard<std::mutex> guard(ResourceHooks::Get().lock);
+            ResourceHooks::Get().listener = NULL;
+        }
+        JobSystem::Context() = context;
+        std::lock_guard<std::mutex> guard(lock);
+        Asset &asset = assets[index];
+        // a failed import keeps its old dependencies, with the hashes of what it read so a fix is picked up
+        if (swap)
+        {
+            for (std::set<std::string>::iterator it = asset.files.begin(); it != asset.files.end(); ++it)
+                dependents[*it].erase(index);
+            asset.files.clear();
+        }
+        for (std::map<std::string, uint64_t>::iterator it = recorded.begin(); it != recorded.end(); ++it)
+        {
+            asset.files.insert(it->first);
+            dependents[it->first].insert(index);
+            FileState state = { it->second, 0, 0 };
+            stat(it->first, state.modified, state.size);
+            files[it->first] = state;
+        }
+        return swap;
+    }
+
+    // compares the files' stats with the last seen ones, and the contents of the ones that differ with their hashes
+    void poll()
+    {
+        std::map<std::string, FileState> snapshot;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            snapshot = files;
+        }
+        for (std::map<std::string, FileState>::iterator it = snapshot.begin(); it != snapshot.end(); ++it)
+        {
+            int64_t modified, size;
+            // files only in the archive have nothing to watch
+            if (!stat(it->first, modified, size) || (modified == it->second.modified && size == it->second.size))
+                continue;
+            // editors often save in several steps; the hash decides whether the contents really changed
+            ResourceData data;
+            uint64_t hash = 0;
+            // a file touched on disk is read from there from now on, even when the resources archive has it
+            PreferLooseResource(it->first);
+            if (ReadResourceData(it->first, data))
+                hash = Cache::Hash(data.data, data.size);
+            std::lock_guard<std::mutex> guard(lock);
+            FileState &state = files[it->first];
+            state.modified = modified;
+            state.size = size;
+            if (hash != 0 && hash != state.hash)
+            {
+                state.hash = hash;
+                changed.insert(it->first);
+            }
+        }
+    }
+
+    // the modification time is in nanoseconds (100 ns steps on Windows), so two saves within a second differ
+    static bool stat(const std::string &path, int64_t &modified, int64_t &size)
+    {
+#ifdef _WIN32
+        WIN32_FILE_ATTRIBUTE_DATA info;
+        if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info))
+            return false;
+        modified = (int64_t)((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32 | info.ftLastWriteTime.dwLowDateTime);
+        size = (int64_t)((uint64_t)info.nFileSizeHigh << 32 | info.nFileSizeLow);
+#else
+        struct ::stat info;
+        if (::stat(path.c_str(), &info) != 0)
+            return false;
+#ifdef __APPLE__
+        modified = (int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+        modified = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+        size = (int64_t)info.st_size;
+#endif
+        return true;
+    }
+};
+#endif
@@ -0,0 +1,128 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <learnopengl/filesystem.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// On-disk cache for derived data (program binaries, processed textures, ...). Entries are plain files named by a
+// content hash under one cache directory, which defaults to <root>/cache and can be moved with LOGL_CACHE_PATH.
+class Cache
+{
+public:
+    // 64-bit FNV-1a. Pass the previous result as seed to hash several buffers as one key.
+    static uint64_t Hash(const void* data, size_t size, uint64_t seed = 14695981039346656037ull)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        uint64_t hash = seed;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static uint64_t Hash(const std::string &text, uint64_t seed = 14695981039346656037ull)
+    {
+        return Hash(text.data(), text.size(), seed);
+    }
+
+    // 16 hex digit name for a hash, with an extension identifying the kind of entry
+    static std::string Key(uint64_t hash, const std::string &extension)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+        return std::string(name) + "." + extension;
+    }
+
+    // full path of an entry; the cache directory is created on first use
+    static std::string Path(const std::string &key)
+    {
+        return getDirectory() + "/" + key;
+    }
+
+    static bool Read(const std::string &key, std::vector<char> &data)
+    {
+        std::ifstream file(Path(key).c_str(), std::ios::binary | std::ios::ate);
+        if (!file)
+            return false;
+        std::streamsize size = file.tellg();
+        file.seekg(0, std::ios::beg);
+        data.resize((size_t)size);
+        return size == 0 || (bool)file.read(&data[0], size);
+    }
+
+    // writes to a temporary file first and renames it, so a crash never leaves a truncated entry behind. Every write
+    // has a temporary file of its own (process id and a counter), so threads and programs writing the same key at once
+    // each rename a whole entry and the last one wins.
+    static bool Write(const std::string &key, const void* data, size_t size)
+    {
+        static std::atomic<unsigned int> writes(0);
+        std::string path = Path(key);
+        char suffix[48];
+#ifdef _WIN32
+        std::snprintf(suffix, sizeof(suffix), ".%d.%u.tmp", (int)_getpid(), writes++);
+#else
+        std::snprintf(suffix, sizeof(suffix), ".%d.%u.tmp", (int)getpid(), writes++);
+#endif
+        std::string temp = path + suffix;
+        {
+            std::ofstream file(temp.c_str(), std::ios::binary | std::ios::trunc);
+            if (!file || !file.write((const char*)data, size))
+            {
+                file.close();
+                std::remove(temp.c_str());
+                return false;
+            }
+        }
+        // rename replaces the entry at once on POSIX; Windows refuses to rename over a file, so it goes first there
+#ifdef _WIN32
+        std::remove(path.c_str());
+#endif
+        if (std::rename(temp.c_str(), path.c_str()) == 0)
+            return true;
+        std::remove(temp.c_str());
+        return false;
+    }
+
+    static bool Write(const std::string &key, const std::vector<char> &data)
+    {
+        return Write(key, data.empty() ? NULL : &data[0], data.size());
+    }
+
+private:
+    static std::string const & getDirectory()
+    {
+        static std::string directory = createDirectory();
+        return directory;
+    }
+
+    static std::string createDirectory()
+    {
+        char const * envPath = getenv("LOGL_CACHE_PATH");
+        std::string directory = envPath != nullptr ? envPath : FileSystem::getPath("cache");
+#ifdef _WIN32
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+        return directory;
+    }
+};
+
+// CACHE_H
+#endif
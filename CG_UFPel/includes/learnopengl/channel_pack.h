@@ -0,0 +1,148 @@
+#ifndef CHANNEL_PACK_H
+#define CHANNEL_PACK_H
+
+#include <stb_image.h>
+
+#include <learnopengl/cache.h>
+#include <learnopengl/mipmap.h>
+#include <learnopengl/log.h>
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+
+// Channel packing of grayscale material maps (specular, reflection, alpha, ...). Such maps are often shipped as full
+// RGB(A) images although they hold one value per texel; the gray maps of a model's materials are stored as the channels
+// of shared textures instead (see Model::packGrayMaps), and a gray map left on its own as a single channel texture.
+// A packed texture's path lists its source files in channel order, separated by '|'.
+const char CHANNEL_PACK_SEPARATOR = '|';
+const uint32_t CHANNEL_PACK_VERSION = 1;
+// a map still counts as gray when its colour channels differ by at most this much per texel (8-bit levels) and by less
+// than CHANNEL_PACK_MAX_MEAN_DEVIATION on average, so compression noise doesn't keep a map unpacked
+const int CHANNEL_PACK_MAX_DEVIATION = 16;
+const double CHANNEL_PACK_MAX_MEAN_DEVIATION = 1.0;
+
+std::vector<std::string> SplitPackedPath(const std::string &path)
+{
+    std::vector<std::string> sources;
+    size_t begin = 0;
+    for (;;)
+    {
+        size_t end = path.find(CHANNEL_PACK_SEPARATOR, begin);
+        sources.push_back(path.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+        if (end == std::string::npos)
+            return sources;
+        begin = end + 1;
+    }
+}
+
+// true when the image holds a single channel worth of data: its colour channels agree and alpha, if any, is opaque.
+// The answer is cached per file content so the map is only decoded for this the first time.
+bool IsGrayscaleMap(const std::string &filename)
+{
+    ResourceData source;
+    if (!ReadResource(filename, source))
+        return false;
+    std::string key = Cache::Key(Cache::Hash(source.data, source.size, Cache::Hash(&CHANNEL_PACK_VERSION, sizeof(CHANNEL_PACK_VERSION))), "gray");
+    std::vector<char> cached;
+    if (Cache::Read(key, cached) && cached.size() == 1)
+        return cached[0] != 0;
+
+    int width, height, channels;
+    unsigned char* pixels = stbi_load_from_memory((const unsigned char*)source.data, (int)source.size, &width, &height, &channels, 0);
+    if (!pixels)
+        return false;
+    bool gray = true;
+    double deviation = 0.0;
+    size_t count = (size_t)width * height;
+    for (size_t i = 0; i < count && gray; i++)
+    {
+        const unsigned char* texel = pixels + i * channels;
+        if (channels == 2 || channels == 4)
+            gray = texel[channels - 1] == 255;
+        if (channels >= 3)
+        {
+            int d = std::max(std::abs(texel[0] - texel[1]), std::abs(texel[0] - texel[2]));
+            gray = gray && d <= CHANNEL_PACK_MAX_DEVIATION;
+            deviation += d;
+        }
+    }
+    gray = gray && deviation / count < CHANNEL_PACK_MAX_MEAN_DEVIATION;
+    stbi_image_free(pixels);
+
+    Cache::Write(key, std::vector<char>(1, gray ? 1 : 0));
+    return gray;
+}
+
+// Builds the mip chain of a packed texture: source k (relative to directory) becomes channel k. desiredChannels = 0
+// uses one channel per source; extra channels are zero, except alpha which is opaque. Cached like LoadMipChain.
+bool LoadChannelPackedChain(const std::string &directory, const std::string &path, int desiredChannels, MipChain &chain)
+{
+    std::vector<std::string> files = SplitPackedPath(path);
+    int channels = desiredChannels ? desiredChannels : (int)files.size();
+    if ((int)files.size() > channels)
+        return false;
+
+    std::vector<ResourceData> sources(files.size());
+    uint32_t params[3] = { CHANNEL_PACK_VERSION, (uint32_t)channels, (uint32_t)files.size() };
+    uint64_t hash = Cache::Hash(params, sizeof(params));
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (!ReadResource(directory + '/' + files[i], sources[i]))
+            return false;
+        hash = Cache::Hash(sources[i].data, sources[i].size, hash);
+    }
+    std::string key = Cache::Key(hash, "mips");
+    if (ReadCachedMipChain(key, chain))
+        return true;
+
+    int width = 0, height = 0;
+    std::vector<unsigned char> packed;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        int w, h, n;
+        unsigned char* pixels = stbi_load_from_memory((const unsigned char*)sources[i].data, (int)sources[i].size, &w, &h, &n, 1);
+        if (!pixels || (i > 0 && (w != width || h != height)))
+        {
+            LOG_ERROR("CHANNEL_PACK:: can't pack %s (missing or size mismatch)", files[i]);
+            stbi_image_free(pixels);
+            return false;
+        }
+        if (i == 0)
+        {
+            width = w;
+            height = h;
+            packed.assign((size_t)width * height * channels, 0);
+            if (channels == 4)
+                for (size_t t = 0; t < (size_t)width * height; t++)
+                    packed[t * 4 + 3] = 255;
+        }
+        for (size_t t = 0; t < (size_t)width * height; t++)
+            packed[t * channels + i] = pixels[t];
+        stbi_image_free(pixels);
+    }
+    BuildMipChain(&packed[0], width, height, channels, false, chain);
+    WriteCachedMipChain(key, chain);
+    return true;
+}
+
+// Loads any material texture path, a single file or a channel packed list, relative to directory.
+bool LoadMaterialChain(const std::string &directory, const std::string &path, int desiredChannels, bool srgb, MipChain &chain)
+{
+    if (path.find(CHANNEL_PACK_SEPARATOR) != std::string::npos)
+        return LoadChannelPackedChain(directory, path, desiredChannels, chain);
+    return LoadMipChain(directory + '/' + path, desiredChannels, srgb, chain);
+}
+
+// size of a material texture without decoding it (the first source's size for packed textures)
+bool MaterialImageInfo(const std::string &directory, const std::string &path, int &width, int &height)
+{
+    int channels;
+    std::string filename = directory + '/' + SplitPackedPath(path)[0];
+    if (!Archive::Resources().find(filename))
+        return stbi_info(filename.c_str(), &width, &height, &channels) != 0;
+    ResourceData source;
+    return ReadResource(filename, source) && stbi_info_from_memory((const unsigned char*)source.data, (int)source.size, &width, &height, &channels) != 0;
+}
+#endif
@@ -0,0 +1,81 @@
+#ifndef GL_HANDLE_H
+#define GL_HANDLE_H
+
+#include <glad/glad.h>
+
+// Move-only owners of GL object names. A handle deletes its object when it's destroyed or given another one, and a
+// moved-from handle holds 0, so the classes built on them (Mesh, Shader, TexturePacker) can't be copied by accident
+// and free their GPU memory on their own. Handles must die while the context they were created in is current.
+
+struct GLBufferTraits {
+    static unsigned int generate() { unsigned int id = 0; glGenBuffers(1, &id); return id; }
+    static void destroy(unsigned int id) { glDeleteBuffers(1, &id); }
+};
+
+struct GLVertexArrayTraits {
+    static unsigned int generate() { unsigned int id = 0; glGenVertexArrays(1, &id); return id; }
+    static void destroy(unsigned int id) { glDeleteVertexArrays(1, &id); }
+};
+
+struct GLTextureTraits {
+    static unsigned int generate() { unsigned int id = 0; glGenTextures(1, &id); return id; }
+    static void destroy(unsigned int id) { glDeleteTextures(1, &id); }
+};
+
+struct GLProgramTraits {
+    static unsigned int generate() { return glCreateProgram(); }
+    static void destroy(unsigned int id) { glDeleteProgram(id); }
+};
+
+template <class Traits>
+class GLHandle
+{
+public:
+    GLHandle() : id(0) {}
+    // takes ownership of an existing object
+    explicit GLHandle(unsigned int id) : id(id) {}
+    GLHandle(GLHandle &&other) noexcept : id(other.id) { other.id = 0; }
+    GLHandle &operator=(GLHandle &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset(other.id);
+            other.id = 0;
+        }
+        return *this;
+    }
+    GLHandle(const GLHandle &) = delete;
+    GLHandle &operator=(const GLHandle &) = delete;
+    ~GLHandle() { reset(); }
+
+    // a handle owning a new object
+    static GLHandle generate() { return GLHandle(Traits::generate()); }
+
+    unsigned int get() const { return id; }
+    explicit operator bool() const { return id != 0; }
+
+    // deletes the object and takes ownership of another one (or of none)
+    void reset(unsigned int other = 0)
+    {
+        if (id && id != other)
+            Traits::destroy(id);
+        id = other;
+    }
+
+    // gives up ownership without deleting the object, for names another owner frees
+    unsigned int detach()
+    {
+        unsigned int other = id;
+        id = 0;
+        return other;
+    }
+
+private:
+    unsigned int id;
+};
+
+typedef GLHandle<GLBufferTraits> GLBuffer;
+typedef GLHandle<GLVertexArrayTraits> GLVertexArray;
+typedef GLHandle<GLTextureTraits> GLTexture;
+typedef GLHandle<GLProgramTraits> GLProgram;
+#endif
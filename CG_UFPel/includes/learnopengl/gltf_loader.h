@@ -0,0 +1,561 @@
+#ifndef GLTF_LOADER_H
+#define GLTF_LOADER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mipmap.h>
+#include <learnopengl/archive.h>
+#include <learnopengl/job_system.h>
+#include <learnopengl/log.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+// Native glTF 2.0 reader (.glb, and .gltf with external buffers). glTF buffer views are already laid out the way GL
+// wants vertices and indices, so a primitive is described as a MeshBuffers pointing into the file (in place in the
+// mapped resources archive) and uploaded with one glBufferData per buffer instead of being copied through Vertex.
+
+const uint32_t GLB_MAGIC      = 0x46546c67; // "glTF"
+const uint32_t GLB_CHUNK_JSON = 0x4e4f534a; // "JSON"
+const uint32_t GLB_CHUNK_BIN  = 0x004e4942; // "BIN\0"
+
+// glTF component types and primitive modes
+const int GLTF_UNSIGNED_BYTE  = 5121;
+const int GLTF_UNSIGNED_SHORT = 5123;
+const int GLTF_UNSIGNED_INT   = 5125;
+const int GLTF_FLOAT          = 5126;
+const int GLTF_TRIANGLES      = 4;
+
+// Just enough JSON for glTF documents: a parsed value, with lookups that return a null value when something is missing
+struct GltfJson {
+    enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+    Type type;
+    double number;
+    std::string text;
+    std::vector<GltfJson> items;
+    std::vector<std::pair<std::string, GltfJson> > members;
+
+    GltfJson() : type(NUL), number(0.0) {}
+
+    const GltfJson &operator[](const char* key) const
+    {
+        for (size_t i = 0; i < members.size(); i++)
+            if (members[i].first == key)
+                return members[i].second;
+        return Null();
+    }
+
+    const GltfJson &operator[](size_t index) const
+    {
+        return index < items.size() ? items[index] : Null();
+    }
+
+    size_t size() const { return items.size(); }
+    bool has(const char* key) const { return (*this)[key].type != NUL; }
+    int integer(int fallback = -1) const { return type == NUMBER ? (int)number : fallback; }
+    double real(double fallback = 0.0) const { return type == NUMBER ? number : fallback; }
+
+    static const GltfJson &Null()
+    {
+        static GltfJson null;
+        return null;
+    }
+
+    // parses the document in [p, end); false on malformed input
+    static bool Parse(const char* &p, const char* end, GltfJson &value, int depth = 0)
+    {
+        skipBlanks(p, end);
+        if (p >= end || depth > 64)
+            return false;
+        if (*p == '{')
+        {
+            value.type = OBJECT;
+            p++;
+            skipBlanks(p, end);
+            if (p < end && *p == '}')
+                return ++p, true;
+            for (;;)
+            {
+                std::string key;
+                skipBlanks(p, end);
+                if (!parseString(p, end, key))
+                    return false;
+                skipBlanks(p, end);
+                if (p >= end || *p++ != ':')
+                    return false;
+                value.members.push_back(std::make_pair(key, GltfJson()));
+                if (!Parse(p, end, value.members.back().second, depth + 1))
+                    return false;
+                skipBlanks(p, end);
+                if (p < end && *p == ',')
+                    p++;
+                else
+                    return p < end && *p++ == '}';
+            }
+        }
+        if (*p == '[')
+        {
+            value.type = ARRAY;
+            p++;
+            skipBlanks(p, end);
+            if (p < end && *p == ']')
+                return ++p, true;
+            for (;;)
+            {
+                value.items.push_back(GltfJson());
+                if (!Parse(p, end, value.items.back(), depth + 1))
+                    return false;
+                skipBlanks(p, end);
+                if (p < end && *p == ',')
+                    p++;
+                else
+                    return p < end && *p++ == ']';
+            }
+        }
+        if (*p == '"')
+        {
+            value.type = STRING;
+            return parseString(p, end, value.text);
+        }
+        if (end - p >= 4 && std::strncmp(p, "true", 4) == 0)
+            return value.type = BOOLEAN, value.number = 1.0, p += 4, true;
+        if (end - p >= 5 && std::strncmp(p, "false", 5) == 0)
+            return value.type = BOOLEAN, p += 5, true;
+        if (end - p >= 4 && std::strncmp(p, "null", 4) == 0)
+            return p += 4, true;
+        // numbers; the chunk is not null terminated, so copy the token for strtod
+        char token[64];
+        size_t n = 0;
+        while (p < end && n + 1 < sizeof(token) && std::strchr("+-0123456789.eE", *p))
+            token[n++] = *p++;
+        token[n] = 0;
+        char* parsed;
+        value.type = NUMBER;
+        value.number = std::strtod(token, &parsed);
+        return n > 0 && parsed == token + n;
+    }
+
+private:
+    static void skipBlanks(const char* &p, const char* end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            p++;
+    }
+
+    static bool parseString(const char* &p, const char* end, std::string &out)
+    {
+        if (p >= end || *p++ != '"')
+            return false;
+        while (p < end && *p != '"')
+        {
+            if (*p != '\\')
+            {
+                out += *p++;
+                continue;
+            }
+            if (++p >= end)
+                return false;
+            char c = *p++;
+            if (c == 'u')
+            {
+                // \uXXXX as UTF-8 (names only; surrogate pairs come out as two code points)
+                if (end - p < 4)
+                    return false;
+                unsigned int code = (unsigned int)std::strtoul(std::string(p, 4).c_str(), NULL, 16);
+                p += 4;
+                if (code < 0x80)
+                    out += (char)code;
+                else if (code < 0x800)
+                    out += (char)(0xC0 | (code >> 6)), out += (char)(0x80 | (code & 0x3F));
+                else
+                    out += (char)(0xE0 | (code >> 12)), out += (char)(0x80 | ((code >> 6) & 0x3F)), out += (char)(0x80 | (code & 0x3F));
+            }
+            else
+                out += c == 'n' ? '\n' : c == 't' ? '\t' : c == 'r' ? '\r' : c == 'b' ? '\b' : c == 'f' ? '\f' : c;
+        }
+        return p < end && *p++ == '"';
+    }
+};
+
+// a node of the scene: its parent (-1 for a root, else an index into the same list, always earlier), its transform
+// relative to the parent and its mesh (-1 for none)
+struct GltfNode {
+    int Parent;
+    glm::mat4 Transform;
+    int Mesh;
+};
+
+// A glTF asset with its buffers. The buffers stay valid (mapped or owned) for the object's lifetime.
+class GltfFile
+{
+public:
+    GltfJson document;
+    std::string directory;
+
+    // reads the asset and its buffers; false for files the native path doesn't handle (Model then uses Assimp)
+    bool open(const std::string &path)
+    {
+        directory = path.substr(0, path.find_last_of('/'));
+        file.reset(new ResourceData());
+        if (!ReadResource(path, *file))
+            return false;
+
+        const char* json = file->data;
+        size_t jsonSize = file->size;
+        const char* bin = NULL;
+        size_t binSize = 0;
+        uint32_t header[3];
+        if (file->size >= sizeof(header))
+            std::memcpy(header, file->data, sizeof(header));
+        if (file->size >= sizeof(header) && header[0] == GLB_MAGIC)
+        {
+            // binary container: the JSON chunk, then optionally the BIN chunk with buffer 0
+            if (header[1] != 2 || header[2] > file->size)
+                return fail(path, "unsupported GLB version or truncated file");
+            json = NULL;
+            for (size_t offset = sizeof(header); offset + 8 <= header[2]; )
+            {
+                uint32_t chunk[2];
+                std::memcpy(chunk, file->data + offset, sizeof(chunk));
+                if (offset + 8 + chunk[0] > header[2])
+                    return fail(path, "truncated chunk");
+                if (chunk[1] == GLB_CHUNK_JSON && !json)
+                    json = file->data + offset + 8, jsonSize = chunk[0];
+                else if (chunk[1] == GLB_CHUNK_BIN && !bin)
+                    bin = file->data + offset + 8, binSize = chunk[0];
+                offset += 8 + ((chunk[0] + 3) & ~3u);
+            }
+            if (!json)
+                return fail(path, "no JSON chunk");
+        }
+        const char* p = json;
+        if (!GltfJson::Parse(p, json + jsonSize, document) || document.type != GltfJson::OBJECT)
+            return fail(path, "malformed JSON");
+        if (document["extensionsRequired"].size() > 0)
+            return fail(path, "requires extensions");
+
+        const GltfJson &list = document["buffers"];
+        for (size_t i = 0; i < list.size(); i++)
+        {
+            Buffer buffer = { NULL, (size_t)list[i]["byteLength"].real() };
+            if (!list[i].has("uri") && i == 0 && bin)
+                buffer.data = bin;
+            else if (list[i]["uri"].type == GltfJson::STRING && list[i]["uri"].text.compare(0, 5, "data:") != 0)
+            {
+                std::shared_ptr<ResourceData> external(new ResourceData());
+                if (!ReadResource(directory + '/' + list[i]["uri"].text, *external))
+                    return fail(path, "can't read buffer");
+                buffer.data = external->data;
+                externals.push_back(external);
+            }
+            else
+                return fail(path, "embedded base64 buffers aren't supported");
+            if ((buffer.data == bin && buffer.size > binSize) || (buffer.data != bin && buffer.size > externals.back()->size))
+                return fail(path, "buffer larger than its data");
+            buffers.push_back(buffer);
+        }
+        return true;
+    }
+
+    // the scene's nodes that lead to a mesh, depth first like Model::processNode, with their transforms relative to
+    // their parents; without a scene every mesh is a root node
+    std::vector<GltfNode> sceneNodes() const
+    {
+        std::vector<GltfNode> nodes;
+        const GltfJson &scenes = document["scenes"];
+        const GltfJson &scene = scenes[(size_t)std::max(0, document["scene"].integer(0))];
+        if (scene.type == GltfJson::OBJECT)
+            for (size_t i = 0; i < scene["nodes"].size(); i++)
+                collectNodes(scene["nodes"][i].integer(), -1, nodes, 0);
+        else
+            for (size_t i = 0; i < document["meshes"].size(); i++)
+            {
+                GltfNode node = { -1, glm::mat4(), (int)i };
+                nodes.push_back(node);
+            }
+        return nodes;
+    }
+
+    // describes a triangle primitive as raw buffers. Returns false for primitives the fast path can't draw as they are
+    // (other modes, sparse or unaligned accessors, no normals).
+    bool primitive(const GltfJson &prim, MeshBuffers &out) const
+    {
+        if (prim["mode"].integer(GLTF_TRIANGLES) != GLTF_TRIANGLES)
+            return false;
+        // the shader's attribute locations (see Mesh::setupMesh); TANGENT keeps its w, the handedness the shader builds the
+        // bitangent with
+        static const char* names[] = { "POSITION", "NORMAL", "TEXCOORD_0", "TANGENT" };
+        const GltfJson &attributes = prim["attributes"];
+        View views[4];
+        int buffer = -1;
+        size_t lo = (size_t)-1, hi = 0;
+        unsigned int count = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            if (!attributes.has(names[i]))
+            {
+                if (i < 2)
+                    return false;
+                continue;
+            }
+            if (!accessor(attributes[names[i]].integer(), views[i]) || (buffer >= 0 && views[i].buffer != buffer))
+                return false;
+            buffer = views[i].buffer;
+            count = i == 0 ? views[i].count : count;
+            lo = std::min(lo, views[i].viewOffset);
+            hi = std::max(hi, views[i].viewOffset + views[i].viewLength);
+        }
+        // one vertex buffer covering every attribute's buffer view, offsets relative to its start
+        out.vertexData = buffers[buffer].data + lo;
+        out.vertexSize = hi - lo;
+        out.attributes.clear();
+        for (int i = 0; i < 4; i++)
+            if (views[i].buffer >= 0)
+            {
+                MeshAttribute a = { (unsigned int)i, views[i].components, views[i].type, views[i].normalized,
+                                    views[i].stride ? views[i].stride : views[i].elementSize, views[i].offset - lo };
+                out.attributes.push_back(a);
+            }
+
+        out.indexData = NULL;
+        out.indexSize = 0;
+        out.indexType = 0;
+        out.count = count;
+        if (prim.has("indices"))
+        {
+            View indices;
+            if (!accessor(prim["indices"].integer(), indices) || indices.components != 1 ||
+                (indices.stride && indices.stride != indices.elementSize))
+                return false;
+            // glTF only allows unsigned indices, the types glDrawElements takes
+            if (indices.type != GL_UNSIGNED_BYTE && indices.type != GL_UNSIGNED_SHORT && indices.type != GL_UNSIGNED_INT)
+            {
+                LOG_WARN("GLTF:: index component type %d isn't an unsigned integer type", (int)indices.type);
+                return false;
+            }
+            out.indexData = buffers[indices.buffer].data + indices.offset;
+            out.indexSize = (size_t)indices.count * indices.elementSize;
+            out.indexType = indices.type;
+            out.count = indices.count;
+        }
+
+        // glTF requires POSITION bounds; fall back to scanning float positions when an exporter left them out
+        const GltfJson &position = document["accessors"][(size_t)attributes["POSITION"].integer()];
+        if (position["min"].size() == 3 && position["max"].size() == 3)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                out.boundsMin[c] = (float)position["min"][c].real();
+                out.boundsMax[c] = (float)position["max"][c].real();
+            }
+        }
+        else
+        {
+            out.boundsMin = out.boundsMax = glm::vec3(0.0f);
+            const View &v = views[0];
+            for (unsigned int i = 0; v.type == GL_FLOAT && i < v.count; i++)
+            {
+                glm::vec3 p;
+                std::memcpy(&p, buffers[v.buffer].data + v.offset + (size_t)i * (v.stride ? v.stride : v.elementSize), sizeof(p));
+                out.boundsMin = i ? glm::min(out.boundsMin, p) : p;
+                out.boundsMax = i ? glm::max(out.boundsMax, p) : p;
+            }
+        }
+        return true;
+    }
+
+    // encoded bytes of an image stored in a buffer view; false for images referenced by uri
+    bool embeddedImage(int image, const char* &data, size_t &size) const
+    {
+        const GltfJson &img = document["images"][(size_t)image];
+        if (!img.has("bufferView"))
+            return false;
+        const GltfJson &view = document["bufferViews"][(size_t)img["bufferView"].integer()];
+        int buffer = view["buffer"].integer();
+        size_t offset = (size_t)view["byteOffset"].real(), length = (size_t)view["byteLength"].real();
+        if (buffer < 0 || buffer >= (int)buffers.size() || offset + length > buffers[buffer].size)
+            return false;
+        data = buffers[buffer].data + offset;
+        size = length;
+        return true;
+    }
+
+    // image index behind a texture info object (material.normalTexture and the like), -1 without one
+    int textureImage(const GltfJson &info) const
+    {
+        if (!info.has("index"))
+            return -1;
+        return document["textures"][(size_t)info["index"].integer()]["source"].integer();
+    }
+
+private:
+    struct Buffer {
+        const char* data;
+        size_t size;
+    };
+
+    // an accessor resolved against its buffer view
+    struct View {
+        int buffer;
+        size_t viewOffset, viewLength; // the buffer view, in bytes from the buffer's start
+        size_t offset;                 // the accessor's first element
+        int stride;                    // 0 when tightly packed
+        int components, elementSize;
+        GLenum type;
+        bool normalized;
+        unsigned int count;
+
+        View() : buffer(-1) {}
+    };
+
+    std::shared_ptr<ResourceData> file;
+    std::vector<std::shared_ptr<ResourceData> > externals;
+    std::vector<Buffer> buffers;
+
+    bool fail(const std::string &path, const char* reason)
+    {
+        LOG_WARN("GLTF:: %s: %s", path, reason);
+        return false;
+    }
+
+    // adds the node and its subtree; nodes with neither a mesh nor a child that has one are left out
+    void collectNodes(int node, int parent, std::vector<GltfNode> &nodes, int depth) const
+    {
+        const GltfJson &n = document["nodes"][(size_t)node];
+        if (n.type != GltfJson::OBJECT || depth > 64)
+            return;
+        size_t index = nodes.size();
+        GltfNode entry = { parent, localTransform(n), n.has("mesh") ? n["mesh"].integer() : -1 };
+        nodes.push_back(entry);
+        for (size_t i = 0; i < n["children"].size(); i++)
+            collectNodes(n["children"][i].integer(), (int)index, nodes, depth + 1);
+        if (nodes.size() == index + 1 && entry.Mesh < 0)
+            nodes.pop_back();
+    }
+
+    // a node's matrix, or its translation, rotation and scale
+    static glm::mat4 localTransform(const GltfJson &n)
+    {
+        glm::mat4 m;
+        if (n["matrix"].size() == 16)
+        {
+            for (int i = 0; i < 16; i++)
+                m[i / 4][i % 4] = (float)n["matrix"][(size_t)i].real();
+            return m;
+        }
+        const GltfJson &t = n["translation"], &r = n["rotation"], &s = n["scale"];
+        if (t.size() == 3)
+            m = glm::translate(m, glm::vec3((float)t[(size_t)0].real(), (float)t[(size_t)1].real(), (float)t[(size_t)2].real()));
+        if (r.size() == 4)
+            m *= glm::mat4_cast(glm::quat((float)r[(size_t)3].real(), (float)r[(size_t)0].real(), (float)r[(size_t)1].real(), (float)r[(size_t)2].real()));
+        if (s.size() == 3)
+            m = glm::scale(m, glm::vec3((float)s[(size_t)0].real(1.0), (float)s[(size_t)1].real(1.0), (float)s[(size_t)2].real(1.0)));
+        return m;
+    }
+
+    bool accessor(int index, View &v) const
+    {
+        const GltfJson &a = document["accessors"][(size_t)index];
+        if (a.type != GltfJson::OBJECT || !a.has("bufferView") || a.has("sparse"))
+            return false;
+        const GltfJson &view = document["bufferViews"][(size_t)a["bufferView"].integer()];
+        v.buffer = view["buffer"].integer();
+        if (v.buffer < 0 || v.buffer >= (int)buffers.size())
+            return false;
+        const std::string &type = a["type"].text;
+        v.components = type == "SCALAR" ? 1 : type == "VEC2" ? 2 : type == "VEC3" ? 3 : type == "VEC4" ? 4 : 0;
+        int componentType = a["componentType"].integer();
+        int componentSize = componentType == GLTF_FLOAT || componentType == GLTF_UNSIGNED_INT ? 4 :
+                            componentType == GLTF_UNSIGNED_SHORT || componentType == 5122 ? 2 : 1;
+        if (!v.components || componentType < 5120 || componentType > GLTF_FLOAT || componentType == 5124)
+            return false;
+        // GL's enums for the component types have the same values
+        v.type = (GLenum)componentType;
+        v.normalized = a["normalized"].type == GltfJson::BOOLEAN && a["normalized"].number != 0.0;
+        v.count = (unsigned int)a["count"].real();
+        v.elementSize = v.components * componentSize;
+        v.viewOffset = (size_t)view["byteOffset"].real();
+        v.viewLength = (size_t)view["byteLength"].real();
+        v.stride = view["byteStride"].integer(0);
+        v.offset = v.viewOffset + (size_t)a["byteOffset"].real();
+        size_t last = v.count ? (size_t)(v.count - 1) * (v.stride ? v.stride : v.elementSize) + v.elementSize : 0;
+        return v.count > 0 && v.offset % componentSize == 0 && v.viewOffset + v.viewLength <= buffers[v.buffer].size &&
+               v.offset + last <= v.viewOffset + v.viewLength;
+    }
+};
+
+// Decodes embedded images in jobs while the caller goes on uploading meshes; wait() then uploads the finished mip
+// chains into the texture names handed out up front by add().
+class GltfImageDecoder
+{
+public:
+    ~GltfImageDecoder()
+    {
+        Jobs.wait(decoding);
+    }
+
+    // starts decoding; returns the texture name the image will be uploaded to
+    unsigned int add(const char* data, size_t size, bool srgb)
+    {
+        std::shared_ptr<Job> job(new Job());
+        glGenTextures(1, &job->id);
+        job->ok = false;
+        job->srgb = srgb;
+        Job* j = job.get();
+        Jobs.run([j, data, size, srgb]() {
+            j->ok = LoadMipChainFromMemory(data, size, 0, srgb, j->chain);
+        }, &decoding);
+        jobs.push_back(job);
+        return job->id;
+    }
+
+    // waits for the decoders (helping them) and uploads every image; returns the names of the textures uploaded. An
+    // image that doesn't decode gets a single neutral texel (white colour, or a flat normal for the linear maps) so its
+    // texture is still complete.
+    std::vector<unsigned int> wait()
+    {
+        Jobs.wait(decoding);
+        std::vector<unsigned int> uploaded;
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            Job &job = *jobs[i];
+            glBindTexture(GL_TEXTURE_2D, job.id);
+            if (job.ok)
+                UploadMipChain(job.chain);
+            else
+            {
+                LOG_ERROR("GLTF:: failed to decode embedded image %u", (unsigned int)i);
+                const unsigned char white[4] = { 255, 255, 255, 255 }, flat[4] = { 128, 128, 255, 255 };
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, job.srgb ? white : flat);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            uploaded.push_back(job.id);
+        }
+        jobs.clear();
+        return uploaded;
+    }
+
+private:
+    struct Job {
+        unsigned int id;
+        bool ok, srgb;
+        MipChain chain;
+    };
+
+    std::vector<std::shared_ptr<Job> > jobs;
+    JobCounter decoding;
+};
+#endif
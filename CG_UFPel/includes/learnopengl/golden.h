@@ -0,0 +1,188 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cmath>
+#include <cstdlib>
+
+#include <learnopengl/log.h>
+
+// A tightly packed 8-bit RGB image, stored top row first (the same order as a binary PPM file).
+struct GoldenImage {
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+
+    GoldenImage() : width(0), height(0) {}
+    GoldenImage(int w, int h) : width(w), height(h), pixels((size_t)w * h * 3, 0) {}
+};
+
+// Reads a binary (P6) PPM file. Reference images are stored as PPM so the harness doesn't need an image writer library.
+bool ReadPPM(const std::string &path, GoldenImage &image)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+
+    std::string magic;
+    int maxValue = 0;
+    file >> magic >> image.width >> image.height >> maxValue;
+    file.get(); // single whitespace before the pixel data
+    if (magic != "P6" || maxValue != 255 || image.width <= 0 || image.height <= 0)
+        return false;
+
+    image.pixels.resize((size_t)image.width * image.height * 3);
+    file.read((char*)&image.pixels[0], image.pixels.size());
+    return (bool)file;
+}
+
+// Writes a binary (P6) PPM file.
+bool WritePPM(const std::string &path, const GoldenImage &image)
+{
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+
+    file << "P6\n" << image.width << " " << image.height << "\n255\n";
+    file.write((const char*)&image.pixels[0], image.pixels.size());
+    return (bool)file;
+}
+
+// Peak signal-to-noise ratio in dB between two images of the same size. Identical images return +infinity.
+double ComputePSNR(const GoldenImage &a, const GoldenImage &b)
+{
+    if (a.width != b.width || a.height != b.height)
+        return 0.0;
+
+    double sum = 0.0;
+    for (size_t i = 0; i < a.pixels.size(); i++)
+    {
+        double d = (double)a.pixels[i] - (double)b.pixels[i];
+        sum += d * d;
+    }
+    double mse = sum / (double)a.pixels.size();
+    if (mse == 0.0)
+        return INFINITY;
+    return 10.0 * std::log10((255.0 * 255.0) / mse);
+}
+
+// Builds an amplified absolute difference image, so small deviations are still visible when inspecting a failure.
+GoldenImage MakeDiffImage(const GoldenImage &a, const GoldenImage &b, int gain = 8)
+{
+    GoldenImage diff(a.width, a.height);
+    if (a.width != b.width || a.height != b.height)
+        return diff;
+
+    for (size_t i = 0; i < a.pixels.size(); i++)
+    {
+        int d = std::abs((int)a.pixels[i] - (int)b.pixels[i]) * gain;
+        diff.pixels[i] = (unsigned char)(d > 255 ? 255 : d);
+    }
+    return diff;
+}
+
+// An offscreen framebuffer (color + depth renderbuffers) so frames can be rendered and read back without a visible window.
+class OffscreenTarget
+{
+public:
+    unsigned int FBO;
+    int Width, Height;
+
+    OffscreenTarget(int width, int height) : Width(width), Height(height)
+    {
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+        glGenRenderbuffers(1, &colorRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+
+        glGenRenderbuffers(1, &depthRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            LOG_ERROR("ERROR::FRAMEBUFFER:: Offscreen target is not complete!");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    ~OffscreenTarget()
+    {
+        glDeleteRenderbuffers(1, &colorRBO);
+        glDeleteRenderbuffers(1, &depthRBO);
+        glDeleteFramebuffers(1, &FBO);
+    }
+
+    // binds the target and sets the viewport to cover it
+    void bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(0, 0, Width, Height);
+    }
+
+    // reads the color attachment back; GL returns rows bottom-up so they are flipped into image order
+    GoldenImage readPixels() const
+    {
+        GoldenImage image(Width, Height);
+        std::vector<unsigned char> rows((size_t)Width * Height * 3);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, Width, Height, GL_RGB, GL_UNSIGNED_BYTE, &rows[0]);
+        size_t stride = (size_t)Width * 3;
+        for (int y = 0; y < Height; y++)
+            std::copy(rows.begin() + (Height - 1 - y) * stride, rows.begin() + (Height - y) * stride, image.pixels.begin() + y * stride);
+        return image;
+    }
+
+private:
+    unsigned int colorRBO, depthRBO;
+
+    // the target owns GL objects, so it must not be copied
+    OffscreenTarget(const OffscreenTarget&);
+    OffscreenTarget& operator=(const OffscreenTarget&);
+};
+
+// Compares a rendered frame against the stored reference; a missing reference fails like a mismatch. On failure the
+// actual frame and an amplified diff are written next to the output prefix for inspection. Update mode compares nothing
+// and writes the frame there as <prefix>.ppm: references only change by copying one over them and committing it.
+bool CompareGolden(const GoldenImage &actual, const std::string &referencePath, const std::string &outputPrefix, double minPSNR, bool update)
+{
+    if (update)
+    {
+        std::string path = outputPrefix + ".ppm";
+        if (!WritePPM(path, actual))
+        {
+            LOG_ERROR("GOLDEN::FAIL could not write %s", path);
+            return false;
+        }
+        LOG_INFO("GOLDEN::UPDATED %s, copy it over %s to accept it", path, referencePath);
+        return true;
+    }
+
+    GoldenImage reference;
+    if (!ReadPPM(referencePath, reference))
+    {
+        LOG_ERROR("GOLDEN::FAIL no reference %s (--golden-update renders one to review)", referencePath);
+        WritePPM(outputPrefix + "_actual.ppm", actual);
+        return false;
+    }
+
+    double psnr = ComputePSNR(actual, reference);
+    bool pass = reference.width == actual.width && reference.height == actual.height && psnr >= minPSNR;
+    if (pass)
+        LOG_INFO("GOLDEN::PASS %s psnr: %.2f dB (min %.2f)", referencePath, psnr, minPSNR);
+    else
+    {
+        LOG_ERROR("GOLDEN::FAIL %s psnr: %.2f dB (min %.2f)", referencePath, psnr, minPSNR);
+        WritePPM(outputPrefix + "_actual.ppm", actual);
+        WritePPM(outputPrefix + "_diff.ppm", MakeDiffImage(actual, reference));
+    }
+    return pass;
+}
+#endif
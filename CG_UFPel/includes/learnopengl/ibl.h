@@ -0,0 +1,503 @@
+#ifndef IBL_H
+#define IBL_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <stb_image.h>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/cache.h>
+#include <learnopengl/mipmap.h>
+#include <learnopengl/log.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+// Sizes and sample counts of the precomputed maps. Changing any of them changes the cache key.
+const int IBL_ENVIRONMENT_SIZE  = 256;
+const int IBL_IRRADIANCE_SIZE   = 32;
+const int IBL_PREFILTER_SIZE    = 128;
+const int IBL_PREFILTER_LEVELS  = 5;
+const int IBL_PREFILTER_SAMPLES = 64;
+const int IBL_BRDF_LUT_SIZE     = 128;
+const int IBL_BRDF_SAMPLES      = 256;
+// texture units of the irradiance map, prefiltered map and BRDF LUT (above the ones materials use)
+const int IBL_FIRST_UNIT = 8;
+
+const uint32_t IBL_MAGIC   = 0x314c4249; // "IBL1"
+const uint32_t IBL_VERSION = 2;
+
+// Image based lighting from an equirectangular HDR environment: the diffuse irradiance map, the GGX prefiltered specular
+// mip chain and the split-sum BRDF lookup table. The environment cubemap they are computed from is not kept; the
+// prefilter's level 0 is the sharpest reflection the shader needs.
+//
+// Everything is precomputed on the CPU (split across the hardware threads) and stored in the cache as half floats under
+// the hash of the HDR file, so only the first start pays for the convolutions. The GL objects are owned by the caller
+// through release(), like TexturePacker's.
+class IBL
+{
+public:
+    unsigned int IrradianceMap, PrefilterMap, BRDFLUT;
+    bool Ready;
+    bool FromCache;
+    double SetupMs;
+
+    IBL() : IrradianceMap(0), PrefilterMap(0), BRDFLUT(0), Ready(false), FromCache(false), SetupMs(0.0) {}
+
+    bool load(const std::string &hdrPath)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        ResourceData source;
+        if (!ReadResource(hdrPath, source))
+        {
+            LOG_ERROR("IBL:: can't read %s", hdrPath);
+            return false;
+        }
+        const uint32_t params[] = { IBL_VERSION, IBL_ENVIRONMENT_SIZE, IBL_IRRADIANCE_SIZE, IBL_PREFILTER_SIZE, IBL_PREFILTER_LEVELS,
+                                    IBL_PREFILTER_SAMPLES, IBL_BRDF_LUT_SIZE, IBL_BRDF_SAMPLES };
+        std::string key = Cache::Key(Cache::Hash(source.data, source.size, Cache::Hash(params, sizeof(params))), "ibl");
+
+        std::vector<char> blob;
+        FromCache = Cache::Read(key, blob) && blob.size() == blobSize() && *(const uint32_t*)&blob[0] == IBL_MAGIC;
+        if (!FromCache)
+        {
+            if (!precompute(source, blob))
+            {
+                LOG_ERROR("IBL:: can't decode %s", hdrPath);
+                return false;
+            }
+            if (!Cache::Write(key, blob))
+                LOG_WARN("IBL:: could not cache the precomputed maps of %s", hdrPath);
+        }
+        upload(blob);
+        Ready = true;
+        SetupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        LOG_INFO("IBL:: %s ready in %.1f ms (%s)", hdrPath, SetupMs, FromCache ? "warm: cache" : "cold: precomputed");
+        return true;
+    }
+
+    // binds the lighting maps to their units and points the shader's samplers at them. The units are not used by
+    // anything else, so this only has to be done once (it leaves the shader bound, so the sampler values have a program).
+    void bind(const Shader &shader) const
+    {
+        shader.use();
+        glActiveTexture(GL_TEXTURE0 + IBL_FIRST_UNIT);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, IrradianceMap);
+        glActiveTexture(GL_TEXTURE0 + IBL_FIRST_UNIT + 1);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, PrefilterMap);
+        glActiveTexture(GL_TEXTURE0 + IBL_FIRST_UNIT + 2);
+        glBindTexture(GL_TEXTURE_2D, BRDFLUT);
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("irradianceMap", IBL_FIRST_UNIT);
+        shader.setInt("prefilterMap", IBL_FIRST_UNIT + 1);
+        shader.setInt("brdfLUT", IBL_FIRST_UNIT + 2);
+        shader.setFloat("prefilterMaxLod", (float)(IBL_PREFILTER_LEVELS - 1));
+    }
+
+    void release()
+    {
+        unsigned int textures[] = { IrradianceMap, PrefilterMap, BRDFLUT };
+        glDeleteTextures(3, textures);
+        IrradianceMap = PrefilterMap = BRDFLUT = 0;
+        Ready = false;
+    }
+
+private:
+    // RGB float cubemap with a mip chain; each level holds the six faces one after the other
+    struct CubeImage {
+        int size;
+        std::vector<std::vector<float> > levels;
+
+        int levelSize(int level) const { return std::max(1, size >> level); }
+        float* texel(int level, int face, int x, int y) { return &levels[level][(((size_t)face * levelSize(level) + y) * levelSize(level) + x) * 3]; }
+        const float* texel(int level, int face, int x, int y) const { return &levels[level][(((size_t)face * levelSize(level) + y) * levelSize(level) + x) * 3]; }
+    };
+
+    // number of half floats of each map in the cache blob, which starts with an 8 word header
+    static size_t cubeHalfs(int size, int levels)
+    {
+        size_t count = 0;
+        for (int i = 0; i < levels; i++)
+            count += (size_t)6 * std::max(1, size >> i) * std::max(1, size >> i) * 3;
+        return count;
+    }
+
+    static size_t blobSize()
+    {
+        return 8 * sizeof(uint32_t) + sizeof(uint16_t) * (cubeHalfs(IBL_IRRADIANCE_SIZE, 1) +
+            cubeHalfs(IBL_PREFILTER_SIZE, IBL_PREFILTER_LEVELS) + (size_t)IBL_BRDF_LUT_SIZE * IBL_BRDF_LUT_SIZE * 2);
+    }
+
+    // direction through texel coordinates s, t in [-1, 1] of a cube face, using GL's face orientation
+    static glm::vec3 cubeDirection(int face, float s, float t)
+    {
+        switch (face)
+        {
+        case 0:  return glm::normalize(glm::vec3( 1.0f, -t, -s));
+        case 1:  return glm::normalize(glm::vec3(-1.0f, -t,  s));
+        case 2:  return glm::normalize(glm::vec3( s,  1.0f,  t));
+        case 3:  return glm::normalize(glm::vec3( s, -1.0f, -t));
+        case 4:  return glm::normalize(glm::vec3( s, -t,  1.0f));
+        default: return glm::normalize(glm::vec3(-s, -t, -1.0f));
+        }
+    }
+
+    static int cubeFace(const glm::vec3 &d, float &s, float &t)
+    {
+        glm::vec3 a = glm::abs(d);
+        if (a.x >= a.y && a.x >= a.z)
+        {
+            s = (d.x > 0.0f ? -d.z : d.z) / a.x;
+            t = -d.y / a.x;
+            return d.x > 0.0f ? 0 : 1;
+        }
+        if (a.y >= a.z)
+        {
+            s = d.x / a.y;
+            t = (d.y > 0.0f ? d.z : -d.z) / a.y;
+            return d.y > 0.0f ? 2 : 3;
+        }
+        s = (d.z > 0.0f ? d.x : -d.x) / a.z;
+        t = -d.y / a.z;
+        return d.z > 0.0f ? 4 : 5;
+    }
+
+    // bilinear lookup inside one face (clamped at the face edges), trilinear between levels
+    static glm::vec3 sampleCube(const CubeImage &cube, const glm::vec3 &dir, float lod)
+    {
+        float s, t;
+        int face = cubeFace(dir, s, t);
+        lod = std::min(std::max(lod, 0.0f), (float)cube.levels.size() - 1.0f);
+        int level = (int)lod;
+        glm::vec3 color = sampleFace(cube, level, face, s, t);
+        if (lod > level)
+            color = glm::mix(color, sampleFace(cube, level + 1, face, s, t), lod - level);
+        return color;
+    }
+
+    static glm::vec3 sampleFace(const CubeImage &cube, int level, int face, float s, float t)
+    {
+        int size = cube.levelSize(level);
+        float x = (s * 0.5f + 0.5f) * size - 0.5f, y = (t * 0.5f + 0.5f) * size - 0.5f;
+        int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+        float fx = x - x0, fy = y - y0;
+        int xa = std::min(std::max(x0, 0), size - 1), xb = std::min(std::max(x0 + 1, 0), size - 1);
+        int ya = std::min(std::max(y0, 0), size - 1), yb = std::min(std::max(y0 + 1, 0), size - 1);
+        glm::vec3 c00 = glm::make_vec3(cube.texel(level, face, xa, ya)), c10 = glm::make_vec3(cube.texel(level, face, xb, ya));
+        glm::vec3 c01 = glm::make_vec3(cube.texel(level, face, xa, yb)), c11 = glm::make_vec3(cube.texel(level, face, xb, yb));
+        return glm::mix(glm::mix(c00, c10, fx), glm::mix(c01, c11, fx), fy);
+    }
+
+    // texel centre of face texel x, y as s, t in [-1, 1]
+    static glm::vec3 texelDirection(int face, int x, int y, int size)
+    {
+        return cubeDirection(face, 2.0f * (x + 0.5f) / size - 1.0f, 2.0f * (y + 0.5f) / size - 1.0f);
+    }
+
+    static glm::vec2 hammersley(unsigned int i, unsigned int count)
+    {
+        unsigned int bits = i;
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return glm::vec2((float)i / count, bits * 2.3283064365386963e-10f);
+    }
+
+    static glm::vec3 importanceSampleGGX(const glm::vec2 &xi, const glm::vec3 &n, float roughness)
+    {
+        float a = roughness * roughness;
+        float phi = 2.0f * 3.14159265f * xi.x;
+        float cosTheta = std::sqrt((1.0f - xi.y) / (1.0f + (a * a - 1.0f) * xi.y));
+        float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+        glm::vec3 h(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+        glm::vec3 up = std::abs(n.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        glm::vec3 tangent = glm::normalize(glm::cross(up, n));
+        glm::vec3 bitangent = glm::cross(n, tangent);
+        return glm::normalize(tangent * h.x + bitangent * h.y + n * h.z);
+    }
+
+    static float distributionGGX(float NdotH, float roughness)
+    {
+        float a2 = roughness * roughness * roughness * roughness;
+        float d = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+        return a2 / (3.14159265f * d * d);
+    }
+
+    static float geometrySmith(float NdotV, float NdotL, float roughness)
+    {
+        float k = roughness * roughness / 2.0f;
+        return (NdotV / (NdotV * (1.0f - k) + k)) * (NdotL / (NdotL * (1.0f - k) + k));
+    }
+
+    // equirectangular HDR -> environment cubemap with a box filtered mip chain (read by the prefilter pass)
+    static void buildEnvironment(const float* hdr, int width, int height, CubeImage &env)
+    {
+        env.size = IBL_ENVIRONMENT_SIZE;
+        env.levels.resize(MipLevelCount(env.size, env.size));
+        env.levels[0].resize((size_t)6 * env.size * env.size * 3);
+        ParallelRows(6 * env.size, [&](int begin, int end) {
+            for (int row = begin; row < end; row++)
+            {
+                int face = row / env.size, y = row % env.size;
+                for (int x = 0; x < env.size; x++)
+                {
+                    glm::vec3 d = texelDirection(face, x, y, env.size);
+                    float u = std::atan2(d.z, d.x) * (0.5f / 3.14159265f) + 0.5f;
+                    float v = std::asin(std::min(std::max(d.y, -1.0f), 1.0f)) / 3.14159265f + 0.5f;
+                    // the image's first row is the top of the sphere
+                    float px = u * width - 0.5f, py = (1.0f - v) * height - 0.5f;
+                    int x0 = (int)std::floor(px), y0 = (int)std::floor(py);
+                    float fx = px - x0, fy = py - y0;
+                    int xa = (x0 % width + width) % width, xb = (xa + 1) % width;
+                    int ya = std::min(std::max(y0, 0), height - 1), yb = std::min(std::max(y0 + 1, 0), height - 1);
+                    float* out = env.texel(0, face, x, y);
+                    for (int c = 0; c < 3; c++)
+                    {
+                        float top = hdr[((size_t)ya * width + xa) * 3 + c] * (1.0f - fx) + hdr[((size_t)ya * width + xb) * 3 + c] * fx;
+                        float bottom = hdr[((size_t)yb * width + xa) * 3 + c] * (1.0f - fx) + hdr[((size_t)yb * width + xb) * 3 + c] * fx;
+                        out[c] = top * (1.0f - fy) + bottom * fy;
+                    }
+                }
+            }
+        });
+        for (size_t level = 1; level < env.levels.size(); level++)
+        {
+            int size = env.levelSize((int)level);
+            env.levels[level].resize((size_t)6 * size * size * 3);
+            for (int face = 0; face < 6; face++)
+                for (int y = 0; y < size; y++)
+                    for (int x = 0; x < size; x++)
+                        for (int c = 0; c < 3; c++)
+                            env.texel((int)level, face, x, y)[c] = 0.25f * (env.texel((int)level - 1, face, 2 * x, 2 * y)[c] + env.texel((int)level - 1, face, 2 * x + 1, 2 * y)[c] +
+                                                                             env.texel((int)level - 1, face, 2 * x, 2 * y + 1)[c] + env.texel((int)level - 1, face, 2 * x + 1, 2 * y + 1)[c]);
+        }
+    }
+
+    // Diffuse irradiance through the order 2 spherical harmonics of the environment (Ramamoorthi & Hanrahan), which is
+    // exact enough for a cosine lobe and far cheaper than a brute force convolution. Stores E(n) / pi like LearnOpenGL's
+    // irradiance map, so the shader multiplies it by the albedo directly.
+    static void buildIrradiance(const CubeImage &env, CubeImage &irradiance)
+    {
+        glm::vec3 sh[9];
+        float totalWeight = 0.0f;
+        int size = env.size;
+        for (int face = 0; face < 6; face++)
+            for (int y = 0; y < size; y++)
+                for (int x = 0; x < size; x++)
+                {
+                    float s = 2.0f * (x + 0.5f) / size - 1.0f, t = 2.0f * (y + 0.5f) / size - 1.0f;
+                    // solid angle of the texel
+                    float weight = 1.0f / std::pow(1.0f + s * s + t * t, 1.5f);
+                    float basis[9];
+                    shBasis(cubeDirection(face, s, t), basis);
+                    glm::vec3 color = glm::make_vec3(env.texel(0, face, x, y));
+                    for (int i = 0; i < 9; i++)
+                        sh[i] += color * basis[i] * weight;
+                    totalWeight += weight;
+                }
+        // convolution with the clamped cosine (A_l / pi) and the normalization of the solid angles to 4 pi
+        const float band[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+        for (int i = 0; i < 9; i++)
+            sh[i] *= band[i] * 4.0f * 3.14159265f / totalWeight;
+
+        irradiance.size = IBL_IRRADIANCE_SIZE;
+        irradiance.levels.assign(1, std::vector<float>((size_t)6 * irradiance.size * irradiance.size * 3));
+        for (int face = 0; face < 6; face++)
+            for (int y = 0; y < irradiance.size; y++)
+                for (int x = 0; x < irradiance.size; x++)
+                {
+                    float basis[9];
+                    shBasis(texelDirection(face, x, y, irradiance.size), basis);
+                    glm::vec3 e(0.0f);
+                    for (int i = 0; i < 9; i++)
+                        e += sh[i] * basis[i];
+                    e = glm::max(e, glm::vec3(0.0f));
+                    std::memcpy(irradiance.texel(0, face, x, y), &e[0], sizeof(e));
+                }
+    }
+
+    static void shBasis(const glm::vec3 &d, float basis[9])
+    {
+        basis[0] = 0.282095f;
+        basis[1] = 0.488603f * d.y;
+        basis[2] = 0.488603f * d.z;
+        basis[3] = 0.488603f * d.x;
+        basis[4] = 1.092548f * d.x * d.y;
+        basis[5] = 1.092548f * d.y * d.z;
+        basis[6] = 0.315392f * (3.0f * d.z * d.z - 1.0f);
+        basis[7] = 1.092548f * d.x * d.z;
+        basis[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+    }
+
+    // GGX prefiltered environment, one roughness per level (split-sum approximation with N = V = R). Samples read the
+    // environment's mip level matching their footprint (Karis' filtered importance sampling), which keeps the sample
+    // count low without fireflies.
+    static void buildPrefilter(const CubeImage &env, CubeImage &prefilter)
+    {
+        prefilter.size = IBL_PREFILTER_SIZE;
+        prefilter.levels.resize(IBL_PREFILTER_LEVELS);
+        float texelSolidAngle = 4.0f * 3.14159265f / (6.0f * env.size * env.size);
+        for (int level = 0; level < IBL_PREFILTER_LEVELS; level++)
+        {
+            int size = prefilter.levelSize(level);
+            float roughness = (float)level / (IBL_PREFILTER_LEVELS - 1);
+            prefilter.levels[level].resize((size_t)6 * size * size * 3);
+            ParallelRows(6 * size, [&](int begin, int end) {
+                for (int row = begin; row < end; row++)
+                {
+                    int face = row / size, y = row % size;
+                    for (int x = 0; x < size; x++)
+                    {
+                        glm::vec3 n = texelDirection(face, x, y, size);
+                        glm::vec3 color(0.0f);
+                        if (level == 0)
+                            color = sampleCube(env, n, std::log2((float)env.size / size));
+                        else
+                        {
+                            float weight = 0.0f;
+                            for (int i = 0; i < IBL_PREFILTER_SAMPLES; i++)
+                            {
+                                glm::vec3 h = importanceSampleGGX(hammersley(i, IBL_PREFILTER_SAMPLES), n, roughness);
+                                glm::vec3 l = glm::normalize(2.0f * glm::dot(n, h) * h - n);
+                                float NdotL = glm::dot(n, l);
+                                if (NdotL <= 0.0f)
+                                    continue;
+                                float NdotH = std::max(glm::dot(n, h), 0.0f);
+                                float pdf = distributionGGX(NdotH, roughness) / 4.0f + 0.0001f;
+                                float sampleSolidAngle = 1.0f / (IBL_PREFILTER_SAMPLES * pdf + 0.0001f);
+                                color += sampleCube(env, l, 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f) * NdotL;
+                                weight += NdotL;
+                            }
+                            color /= std::max(weight, 0.0001f);
+                        }
+                        std::memcpy(prefilter.texel(level, face, x, y), &color[0], sizeof(color));
+                    }
+                }
+            });
+        }
+    }
+
+    // split-sum BRDF integration: x = NdotV, y = roughness -> (scale, bias) applied to F0
+    static void buildBRDFLUT(std::vector<float> &lut)
+    {
+        int size = IBL_BRDF_LUT_SIZE;
+        lut.resize((size_t)size * size * 2);
+        ParallelRows(size, [&](int begin, int end) {
+            for (int y = begin; y < end; y++)
+                for (int x = 0; x < size; x++)
+                {
+                    float NdotV = (x + 0.5f) / size, roughness = (y + 0.5f) / size;
+                    glm::vec3 v(std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV);
+                    glm::vec3 n(0.0f, 0.0f, 1.0f);
+                    float a = 0.0f, b = 0.0f;
+                    for (int i = 0; i < IBL_BRDF_SAMPLES; i++)
+                    {
+                        glm::vec3 h = importanceSampleGGX(hammersley(i, IBL_BRDF_SAMPLES), n, roughness);
+                        glm::vec3 l = glm::normalize(2.0f * glm::dot(v, h) * h - v);
+                        float NdotL = std::max(l.z, 0.0f), NdotH = std::max(h.z, 0.0f), VdotH = std::max(glm::dot(v, h), 0.0f);
+                        if (NdotL <= 0.0f)
+                            continue;
+                        float visibility = geometrySmith(NdotV, NdotL, roughness) * VdotH / (NdotH * NdotV);
+                        float fresnel = std::pow(1.0f - VdotH, 5.0f);
+                        a += (1.0f - fresnel) * visibility;
+                        b += fresnel * visibility;
+                    }
+                    lut[((size_t)y * size + x) * 2] = a / IBL_BRDF_SAMPLES;
+                    lut[((size_t)y * size + x) * 2 + 1] = b / IBL_BRDF_SAMPLES;
+                }
+        });
+    }
+
+    static void appendHalfs(std::vector<uint16_t> &out, const std::vector<float> &values)
+    {
+        for (size_t i = 0; i < values.size(); i++)
+            out.push_back(glm::packHalf1x16(values[i]));
+    }
+
+    // runs every pass and serializes the results: header { magic, version, environment, irradiance, prefilter size,
+    // prefilter levels, LUT size, 0 }, then the irradiance, prefilter and LUT maps as half floats in that order
+    static bool precompute(const ResourceData &source, std::vector<char> &blob)
+    {
+        int width, height, channels;
+        float* hdr = stbi_loadf_from_memory((const unsigned char*)source.data, (int)source.size, &width, &height, &channels, 3);
+        if (!hdr)
+            return false;
+        CubeImage env, irradiance, prefilter;
+        std::vector<float> lut;
+        buildEnvironment(hdr, width, height, env);
+        stbi_image_free(hdr);
+        buildIrradiance(env, irradiance);
+        buildPrefilter(env, prefilter);
+        buildBRDFLUT(lut);
+
+        std::vector<uint16_t> halfs;
+        appendHalfs(halfs, irradiance.levels[0]);
+        for (int i = 0; i < IBL_PREFILTER_LEVELS; i++)
+            appendHalfs(halfs, prefilter.levels[i]);
+        appendHalfs(halfs, lut);
+        const uint32_t header[8] = { IBL_MAGIC, IBL_VERSION, IBL_ENVIRONMENT_SIZE, IBL_IRRADIANCE_SIZE, IBL_PREFILTER_SIZE, IBL_PREFILTER_LEVELS, IBL_BRDF_LUT_SIZE, 0 };
+        blob.resize(sizeof(header) + halfs.size() * sizeof(uint16_t));
+        std::memcpy(&blob[0], header, sizeof(header));
+        std::memcpy(&blob[sizeof(header)], &halfs[0], halfs.size() * sizeof(uint16_t));
+        return true;
+    }
+
+    // creates an RGB16F cubemap from levels of half float faces and returns the read position after them
+    static const uint16_t* uploadCube(unsigned int &texture, int size, int levels, const uint16_t* data)
+    {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+        if (glTexStorage2D)
+            glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels, GL_RGB16F, size, size);
+        for (int level = 0; level < levels; level++)
+        {
+            int s = std::max(1, size >> level);
+            for (int face = 0; face < 6; face++)
+            {
+                if (glTexStorage2D)
+                    glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0, s, s, GL_RGB, GL_HALF_FLOAT, data);
+                else
+                    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB16F, s, s, 0, GL_RGB, GL_HALF_FLOAT, data);
+                data += (size_t)s * s * 3;
+            }
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return data;
+    }
+
+    void upload(const std::vector<char> &blob)
+    {
+        const uint16_t* data = (const uint16_t*)&blob[8 * sizeof(uint32_t)];
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        // sample across cube face edges instead of clamping at each face (core since GL 3.2)
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+        data = uploadCube(IrradianceMap, IBL_IRRADIANCE_SIZE, 1, data);
+        data = uploadCube(PrefilterMap, IBL_PREFILTER_SIZE, IBL_PREFILTER_LEVELS, data);
+
+        glGenTextures(1, &BRDFLUT);
+        glBindTexture(GL_TEXTURE_2D, BRDFLUT);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, IBL_BRDF_LUT_SIZE, IBL_BRDF_LUT_SIZE, 0, GL_RG, GL_HALF_FLOAT, data);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+};
+#endif
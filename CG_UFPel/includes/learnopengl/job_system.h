@@ -0,0 +1,480 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <learnopengl/log.h>
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Work-stealing job scheduler for the short parallel tasks of the engine (importing meshes, decoding and filtering
+// textures). Every worker thread has a deque of jobs: it pushes and pops its own at the back, so it keeps working on
+// the data it just touched, and when it runs dry it steals from the front of another deque, where the oldest and
+// usually biggest pieces of work are. A thread that isn't a worker (the main thread, the upload thread) gets a deque
+// of its own on its first job, and while it waits it only runs the jobs of that deque: the render thread never picks
+// up a piece of an import the upload thread started, the workers do. Jobs are counted with a JobCounter: waiting on it runs other jobs until the counter drops to zero, so a job
+// can wait for the jobs it started without tying up its thread, and a job can be held back until a counter drops to
+// zero. A job runs with the context of the thread that queued it (see Context()). Long-lived threads (the log writer,
+// the asset watcher, the upload thread) stay threads of their own.
+
+class JobSystem;
+
+// the number of jobs started and not yet finished; jobs depending on it are held by it meanwhile. It must outlive them.
+class JobCounter
+{
+public:
+    JobCounter() : count(0) {}
+
+    JobCounter(const JobCounter &) = delete;
+    JobCounter &operator=(const JobCounter &) = delete;
+
+    // true once every job it counts has finished; it can be destroyed then
+    bool done()
+    {
+        if (count.load() != 0)
+            return false;
+        // the last job drops the count while holding the lock, wait for it to let go
+        std::lock_guard<std::mutex> guard(lock);
+        return true;
+    }
+
+private:
+    friend class JobSystem;
+
+    struct Held {
+        std::function<void()> fn;
+        JobCounter *counter;
+        const void *context;
+    };
+
+    std::atomic<int> count;
+    std::mutex lock;
+    std::vector<Held> held;
+};
+
+class JobSystem
+{
+public:
+    JobSystem() : started(false), stopping(false), queued(0) {}
+
+    ~JobSystem()
+    {
+        stop();
+    }
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    // a worker per hardware thread besides the one that waits for the jobs
+    static int DefaultWorkers()
+    {
+        return std::max(0, (int)std::thread::hardware_concurrency() - 1);
+    }
+
+    // (re)starts the system with the given number of workers, pinned to one core each when pin is set (worker i to
+    // core i + 1 modulo the hardware threads; the threads that aren't workers stay unpinned, so with DefaultWorkers()
+    // the main thread mostly gets core 0 to itself). Starts on first use with DefaultWorkers() otherwise. Call it while
+    // no jobs are running.
+    void start(int workerCount, bool pin = false)
+    {
+        std::lock_guard<std::mutex> guard(startLock);
+        stopLocked();
+        startLocked(workerCount, pin);
+    }
+
+    // finishes the queued jobs and joins the workers
+    void stop()
+    {
+        std::lock_guard<std::mutex> guard(startLock);
+        stopLocked();
+    }
+
+    // threads that run jobs: the workers and the one waiting
+    int threads()
+    {
+        ensureStarted();
+        return (int)queues.size() + 1;
+    }
+
+    // the calling thread's context, a tag for the task it works on. Jobs inherit the one of the thread that queued them
+    // while they run, so work done on behalf of a task is still recognised as such on a worker (AssetDatabase records
+    // the reads of the import it runs this way).
+    static const void* &Context()
+    {
+        static thread_local const void* context = NULL;
+        return context;
+    }
+
+    // queues fn, counted by counter (which may be NULL); with a dependency it is only queued once that counter is zero
+    void run(const std::function<void()> &fn, JobCounter *counter = NULL, JobCounter *dependency = NULL)
+    {
+        ensureStarted();
+        if (counter)
+            counter->count++;
+        if (dependency)
+        {
+            std::lock_guard<std::mutex> guard(dependency->lock);
+            if (dependency->count.load() > 0)
+            {
+                JobCounter::Held held = { fn, counter, Context() };
+                dependency->held.push_back(held);
+                return;
+            }
+        }
+        push(fn, counter, Context());
+    }
+
+    // runs jobs until the counter is zero: any job on a worker, only the thread's own ones elsewhere
+    void wait(JobCounter &counter)
+    {
+        ensureStarted();
+        while (!counter.done())
+            if (!runOne())
+                std::this_thread::yield();
+    }
+
+    // fn(begin, end) over [0, count) in chunks of at least grain items, a few chunks per thread so the ones that finish
+    // early can steal the rest; returns when all of them ran. Once the queues have grown it allocates nothing, so it
+    // can run every frame: the chunk jobs are small enough for std::function to keep them inline.
+    template <class Fn>
+    void parallelFor(size_t count, size_t grain, const Fn &fn)
+    {
+        if (count == 0)
+            return;
+        int threadCount = threads();
+        size_t chunk = std::max(std::max(grain, (size_t)1), count / ((size_t)threadCount * 4));
+        if (chunk >= count || threadCount == 1)
+        {
+            fn((size_t)0, count);
+            return;
+        }
+        struct Range {
+            const Fn *fn;
+            size_t count, chunk;
+        };
+        Range range = { &fn, count, chunk };
+        const Range *shared = &range;
+        JobCounter counter;
+        for (size_t begin = 0; begin < count; begin += chunk)
+            run([shared, begin]() { (*shared->fn)(begin, std::min(shared->count, begin + shared->chunk)); }, &counter);
+        wait(counter);
+    }
+
+private:
+    struct Job {
+        std::function<void()> fn;
+        JobCounter *counter;
+        const void *context;
+    };
+
+    // a deque of jobs in a ring buffer that only grows, so queuing one doesn't allocate once it's big enough
+    struct Queue {
+        std::mutex lock;
+        std::vector<Job> jobs;
+        size_t first, count;
+        std::thread thread;
+
+        Queue() : first(0), count(0) {}
+
+        void pushBack(const Job &job)
+        {
+            if (count == jobs.size())
+            {
+                std::vector<Job> grown(std::max((size_t)16, jobs.size() * 2));
+                for (size_t i = 0; i < count; i++)
+                    grown[i] = std::move(jobs[(first + i) % jobs.size()]);
+                jobs.swap(grown);
+                first = 0;
+            }
+            jobs[(first + count++) % jobs.size()] = job;
+        }
+
+        // the slots are cleared so the jobs' captures go with them
+        Job popBack()
+        {
+            Job &slot = jobs[(first + --count) % jobs.size()];
+            Job job = std::move(slot);
+            slot.fn = nullptr;
+            return job;
+        }
+
+        Job popFront()
+        {
+            Job &slot = jobs[first];
+            Job job = std::move(slot);
+            slot.fn = nullptr;
+            first = (first + 1) % jobs.size();
+            count--;
+            return job;
+        }
+    };
+
+    // a queue per worker
+    std::vector<std::unique_ptr<Queue> > queues;
+    // the queues of the threads that aren't workers, which the workers steal from too
+    std::mutex ownersLock;
+    std::vector<Queue*> owners;
+    std::mutex startLock;
+    std::atomic<bool> started;
+    bool stopping;
+    // jobs in all the queues, what the sleeping workers wait for
+    std::atomic<int> queued;
+    std::mutex sleepLock;
+    std::condition_variable wake;
+
+    void ensureStarted()
+    {
+        if (started)
+            return;
+        std::lock_guard<std::mutex> guard(startLock);
+        if (!started)
+            startLocked(DefaultWorkers(), false);
+    }
+
+    // both with startLock held
+    void startLocked(int workerCount, bool pin)
+    {
+        stopping = false;
+        queues.clear();
+        for (int i = 0; i < workerCount; i++)
+            queues.push_back(std::unique_ptr<Queue>(new Queue()));
+        for (int i = 0; i < workerCount; i++)
+        {
+            queues[i]->thread = std::thread([this, i]() { work(i); });
+            if (pin && !pinToCore(queues[i]->thread, (i + 1) % std::max(1u, std::thread::hardware_concurrency())))
+                LOG_WARN("JOBS:: could not pin worker %d", i);
+        }
+        started = true;
+    }
+
+    void stopLocked()
+    {
+        if (!started)
+            return;
+        {
+            std::lock_guard<std::mutex> sleeping(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < queues.size(); i++)
+            queues[i]->thread.join();
+        started = false;
+    }
+
+    // the queue a thread that isn't a worker owns while it lives. Jobs still in it when the thread ends run first.
+    struct OwnedQueue {
+        JobSystem *system;
+        Queue queue;
+
+        OwnedQueue() : system(NULL) {}
+
+        ~OwnedQueue()
+        {
+            if (!system)
+                return;
+            while (system->runOne())
+                ;
+            std::lock_guard<std::mutex> guard(system->ownersLock);
+            system->owners.erase(std::find(system->owners.begin(), system->owners.end(), &queue));
+        }
+    };
+
+    // true on the workers of this system
+    bool isWorker() const
+    {
+        return CurrentSystem() == this;
+    }
+
+    // the calling thread's queue: its worker queue, or the one it owns, registered on first use
+    Queue &current()
+    {
+        if (isWorker())
+            return *queues[CurrentQueue()];
+        static thread_local OwnedQueue owned;
+        if (!owned.system)
+        {
+            std::lock_guard<std::mutex> guard(ownersLock);
+            owned.system = this;
+            owners.push_back(&owned.queue);
+        }
+        return owned.queue;
+    }
+
+    static const JobSystem* &CurrentSystem()
+    {
+        static thread_local const JobSystem* system = NULL;
+        return system;
+    }
+
+    static int &CurrentQueue()
+    {
+        static thread_local int queue = 0;
+        return queue;
+    }
+
+    void push(const std::function<void()> &fn, JobCounter *counter, const void *context)
+    {
+        Queue &queue = current();
+        {
+            std::lock_guard<std::mutex> guard(queue.lock);
+            Job job = { fn, counter, context };
+            queue.pushBack(job);
+        }
+        queued++;
+        // taking the lock orders this with a worker that just found nothing and is about to sleep
+        {
+            std::lock_guard<std::mutex> guard(sleepLock);
+        }
+        wake.notify_one();
+    }
+
+    // takes the oldest job of the queue
+    static bool steal(Queue &victim, Job &job)
+    {
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (victim.count == 0)
+            return false;
+        job = victim.popFront();
+        return true;
+    }
+
+    // runs one job: the newest of the thread's own queue, or else, on a worker, the oldest of another worker's queue
+    // or of a queue a thread owns
+    bool runOne()
+    {
+        Job job;
+        bool found = false;
+        {
+            Queue &own = current();
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (own.count != 0)
+            {
+                job = own.popBack();
+                found = true;
+            }
+        }
+        if (!found && isWorker())
+        {
+            size_t self = (size_t)CurrentQueue();
+            for (size_t i = 1; !found && i < queues.size(); i++)
+                found = steal(*queues[(self + i) % queues.size()], job);
+            std::lock_guard<std::mutex> guard(ownersLock);
+            for (size_t i = 0; !found && i < owners.size(); i++)
+                found = steal(*owners[i], job);
+        }
+        if (!found)
+            return false;
+        queued--;
+        const void *context = Context();
+        Context() = job.context;
+        job.fn();
+        Context() = context;
+        if (job.counter)
+            finish(*job.counter);
+        return true;
+    }
+
+    // a job counted by counter ran; the last one releases the jobs held by it
+    void finish(JobCounter &counter)
+    {
+        std::vector<JobCounter::Held> released;
+        {
+            std::lock_guard<std::mutex> guard(counter.lock);
+            if (--counter.count > 0)
+                return;
+            released.swap(counter.held);
+        }
+        for (size_t i = 0; i < released.size(); i++)
+            push(released[i].fn, released[i].counter, released[i].context);
+    }
+
+    void work(int index)
+    {
+        CurrentSystem() = this;
+        CurrentQueue() = index;
+        for (;;)
+        {
+            if (runOne())
+                continue;
+            std::unique_lock<std::mutex> guard(sleepLock);
+            wake.wait(guard, [this]() { return queued.load() > 0 || stopping; });
+            if (stopping && queued.load() == 0)
+                return;
+        }
+    }
+
+    static bool pinToCore(std::thread &thread, unsigned int core)
+    {
+#if defined(_WIN32)
+        return SetThreadAffinityMask((HANDLE)thread.native_handle(), (DWORD_PTR)1 << core) != 0;
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#else
+        (void)thread;
+        (void)core;
+        return false;
+#endif
+    }
+};
+
+// the engine's job system
+JobSystem Jobs;
+
+// Logs how a workload scales with the number of threads (--bench-jobs): it runs on 1, 2, 4, ... and all the hardware
+// threads, with the workers free to move between cores and pinned to one each, at least 200 ms per configuration.
+// The engine's job system is restarted for every configuration and left at its default afterwards.
+void BenchmarkJobs(const char *name, const std::function<void()> &work)
+{
+    int hardware = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<int> counts;
+    for (int n = 1; n < hardware; n *= 2)
+        counts.push_back(n);
+    counts.push_back(hardware);
+    double single = 0.0;
+    for (size_t c = 0; c < counts.size(); c++)
+    {
+        double ms[2];
+        for (int pin = 0; pin < 2; pin++)
+        {
+            Jobs.start(counts[c] - 1, pin == 1);
+            work();
+            int runs = 0;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            double seconds = 0.0;
+            do
+            {
+                work();
+                runs++;
+                seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            } while (seconds < 0.2);
+            ms[pin] = seconds * 1000.0 / runs;
+        }
+        if (c == 0)
+            single = ms[0];
+        LOG_INFO("JOBS:: %s: %d threads %.2f ms (%.2fx), pinned %.2f ms (%.2fx)", name, counts[c], ms[0], single / ms[0], ms[1], single / ms[1]);
+    }
+    Jobs.start(JobSystem::DefaultWorkers());
+}
+#endif
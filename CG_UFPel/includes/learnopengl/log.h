@@ -0,0 +1,330 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+// Log levels. Messages below LOG_MIN_LEVEL are removed at compile time; define LOG_MIN_LEVEL before including this
+// header to override the default (everything in debug builds, info and above when NDEBUG is set).
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_ERROR 3
+
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+// Limits of a single queued message. Formatting happens on the writer thread, so a message only carries its format
+// string (which must be a literal), its raw arguments and a copy of any string arguments.
+const int LOG_MAX_ARGS    = 8;
+const int LOG_STRING_SIZE = 512;
+const int LOG_QUEUE_SIZE  = 1024; // must be a power of two
+
+struct LogArg {
+    enum Type { LOG_INT, LOG_UINT, LOG_DOUBLE, LOG_STRING, LOG_POINTER };
+    Type type;
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+        const void* p;
+        int offset; // into LogRecord::strings
+    };
+};
+
+struct LogRecord {
+    int level;
+    double time;
+    const char* format;
+    int numArgs;
+    int stringsUsed;
+    LogArg args[LOG_MAX_ARGS];
+    char strings[LOG_STRING_SIZE];
+};
+
+// Asynchronous logger. Any thread may push messages into a bounded lock-free MPSC ring (Vyukov's sequence-numbered
+// queue); a background thread formats and writes them. Producers never block: when the ring is full the message is
+// dropped and counted instead.
+class Logger
+{
+public:
+    static Logger& instance()
+    {
+        static Logger logger;
+        return logger;
+    }
+
+    template <typename... Args>
+    void log(int level, const char* format, const Args&... args)
+    {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;)
+        {
+            cell = &cells[pos & (LOG_QUEUE_SIZE - 1)];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if (dif == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            else
+                pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+
+        LogRecord &record = cell->record;
+        record.level = level;
+        record.time = now();
+        record.format = format;
+        record.numArgs = 0;
+        record.stringsUsed = 0;
+        pack(record, args...);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    // rate limiting for messages logged every frame: returns true at most once per intervalMs for a given call site
+    bool allow(std::atomic<long long> &last, int intervalMs)
+    {
+        long long t = (long long)(now() * 1000.0);
+        long long previous = last.load(std::memory_order_relaxed);
+        if (previous != 0 && t - previous < intervalMs)
+            return false;
+        return last.compare_exchange_strong(previous, t == 0 ? 1 : t, std::memory_order_relaxed);
+    }
+
+    // seconds since the logger started
+    double now() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    ~Logger()
+    {
+        running.store(false);
+        writer.join();
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        LogRecord record;
+    };
+
+    Cell cells[LOG_QUEUE_SIZE];
+    std::atomic<size_t> enqueuePos;
+    size_t dequeuePos;
+    std::atomic<unsigned long long> dropped;
+    std::atomic<bool> running;
+    std::chrono::steady_clock::time_point start;
+    std::thread writer;
+
+    Logger() : enqueuePos(0), dequeuePos(0), dropped(0), running(true), start(std::chrono::steady_clock::now())
+    {
+        for (size_t i = 0; i < (size_t)LOG_QUEUE_SIZE; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        writer = std::thread(&Logger::writerLoop, this);
+    }
+
+    Logger(const Logger&);
+    Logger& operator=(const Logger&);
+
+    // argument capture, one overload per family of printf argument types
+    static void pack(LogRecord &) {}
+
+    template <typename T, typename... Rest>
+    static void pack(LogRecord &record, const T &value, const Rest&... rest)
+    {
+        if (record.numArgs < LOG_MAX_ARGS)
+            packArg(record, record.args[record.numArgs++], value);
+        pack(record, rest...);
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    packArg(LogRecord &, LogArg &arg, const T &value) { arg.type = LogArg::LOG_INT; arg.i = value; }
+
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+    packArg(LogRecord &, LogArg &arg, const T &value) { arg.type = LogArg::LOG_UINT; arg.u = value; }
+
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type
+    packArg(LogRecord &, LogArg &arg, const T &value) { arg.type = LogArg::LOG_DOUBLE; arg.d = value; }
+
+    template <typename T>
+    static typename std::enable_if<std::is_enum<T>::value>::type
+    packArg(LogRecord &, LogArg &arg, const T &value) { arg.type = LogArg::LOG_INT; arg.i = (long long)value; }
+
+    static void packArg(LogRecord &, LogArg &arg, const void* value) { arg.type = LogArg::LOG_POINTER; arg.p = value; }
+    static void packArg(LogRecord &record, LogArg &arg, const char* value) { packString(record, arg, value ? value : "(null)", value ? std::strlen(value) : 6); }
+    static void packArg(LogRecord &record, LogArg &arg, char* value) { packArg(record, arg, (const char*)value); }
+    static void packArg(LogRecord &record, LogArg &arg, const std::string &value) { packString(record, arg, value.c_str(), value.size()); }
+    template <size_t N>
+    static void packArg(LogRecord &record, LogArg &arg, const char (&value)[N]) { packArg(record, arg, (const char*)value); }
+
+    // strings are copied (and truncated if needed) because the caller's buffer may be gone by the time it is written
+    static void packString(LogRecord &record, LogArg &arg, const char* value, size_t length)
+    {
+        arg.type = LogArg::LOG_STRING;
+        if (record.stringsUsed >= LOG_STRING_SIZE)
+        {
+            arg.offset = LOG_STRING_SIZE - 1; // the terminator of the previous string
+            return;
+        }
+        size_t room = LOG_STRING_SIZE - record.stringsUsed - 1;
+        if (length > room)
+            length = room;
+        arg.offset = record.stringsUsed;
+        std::memcpy(record.strings + record.stringsUsed, value, length);
+        record.strings[record.stringsUsed + length] = '\0';
+        record.stringsUsed += (int)length + 1;
+    }
+
+    void writerLoop()
+    {
+        unsigned long long reportedDrops = 0;
+        for (;;)
+        {
+            bool wrote = false;
+            while (dequeue())
+                wrote = true;
+
+            unsigned long long drops = dropped.load(std::memory_order_relaxed);
+            if (drops != reportedDrops)
+            {
+                std::fprintf(stdout, "[%10.4f] WARN  LOG:: %llu messages dropped (queue full)\n", now(), drops - reportedDrops);
+                reportedDrops = drops;
+                wrote = true;
+            }
+            if (wrote)
+                std::fflush(stdout);
+            else if (!running.load())
+                break;
+            else
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    bool dequeue()
+    {
+        Cell &cell = cells[dequeuePos & (LOG_QUEUE_SIZE - 1)];
+        size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (seq != dequeuePos + 1)
+            return false;
+        write(cell.record);
+        cell.sequence.store(dequeuePos + LOG_QUEUE_SIZE, std::memory_order_release);
+        dequeuePos++;
+        return true;
+    }
+
+    // expands the printf-style format with the captured arguments. Length modifiers in the format are ignored since
+    // every integer is stored widened to 64 bits.
+    void write(const LogRecord &record)
+    {
+        static const char* names[] = { "DEBUG", "INFO ", "WARN ", "ERROR" };
+        char line[1024];
+        int n = std::snprintf(line, sizeof(line), "[%10.4f] %s ", record.time, names[record.level & 3]);
+        int argIndex = 0;
+        for (const char* f = record.format; *f && n < (int)sizeof(line) - 1; f++)
+        {
+            if (*f != '%')
+            {
+                line[n++] = *f;
+                continue;
+            }
+            if (f[1] == '%')
+            {
+                line[n++] = '%';
+                f++;
+                continue;
+            }
+            // copy flags, width and precision, skip length modifiers, stop at the conversion character
+            char spec[32];
+            int s = 0;
+            spec[s++] = '%';
+            f++;
+            while (*f && std::strchr("-+ #0123456789.*", *f) && s < 24)
+                spec[s++] = *f++;
+            while (*f && std::strchr("hlLqjzt", *f))
+                f++;
+            if (!*f)
+                break;
+            char conversion = *f;
+            if (argIndex >= record.numArgs)
+                continue;
+            const LogArg &arg = record.args[argIndex++];
+            size_t room = sizeof(line) - n;
+            int written = 0;
+            if (std::strchr("diouxXc", conversion))
+            {
+                if (conversion == 'c')
+                {
+                    spec[s++] = 'c'; spec[s] = '\0';
+                    written = std::snprintf(line + n, room, spec, (int)(arg.type == LogArg::LOG_DOUBLE ? (long long)arg.d : arg.i));
+                }
+                else
+                {
+                    spec[s++] = 'l'; spec[s++] = 'l'; spec[s++] = conversion; spec[s] = '\0';
+                    long long value = arg.type == LogArg::LOG_DOUBLE ? (long long)arg.d : arg.i;
+                    written = std::snprintf(line + n, room, spec, value);
+                }
+            }
+            else if (std::strchr("eEfFgGaA", conversion))
+            {
+                spec[s++] = conversion; spec[s] = '\0';
+                double value = arg.type == LogArg::LOG_DOUBLE ? arg.d : arg.type == LogArg::LOG_UINT ? (double)arg.u : (double)arg.i;
+                written = std::snprintf(line + n, room, spec, value);
+            }
+            else if (conversion == 's')
+            {
+                spec[s++] = 's'; spec[s] = '\0';
+                written = std::snprintf(line + n, room, spec, arg.type == LogArg::LOG_STRING ? record.strings + arg.offset : "?");
+            }
+            else if (conversion == 'p')
+                written = std::snprintf(line + n, room, "%p", arg.p);
+            if (written > 0)
+                n += written < (int)room ? written : (int)room - 1;
+        }
+        if (n > (int)sizeof(line) - 2)
+            n = sizeof(line) - 2;
+        line[n++] = '\n';
+        std::fwrite(line, 1, n, record.level >= LOG_LEVEL_ERROR ? stderr : stdout);
+    }
+};
+
+// Logging macros. The level check is a constant expression, so filtered messages cost nothing at runtime.
+#define LOG_AT(level, ...) \
+    do { if ((level) >= LOG_MIN_LEVEL) Logger::instance().log((level), __VA_ARGS__); } while (0)
+
+// Logs at most once every intervalMs milliseconds from this call site (for per-frame messages).
+#define LOG_THROTTLED(level, intervalMs, ...) \
+    do { \
+        if ((level) >= LOG_MIN_LEVEL) { \
+            static std::atomic<long long> logLastTime_(0); \
+            if (Logger::instance().allow(logLastTime_, (intervalMs))) \
+                Logger::instance().log((level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...)  LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...)  LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#endif
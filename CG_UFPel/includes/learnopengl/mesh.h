@@ -6,13 +6,17 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <learnopengl/shader.h>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/gl_handle.h>
+#include <learnopengl/arena.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <utility>
+#include <type_traits>
 using namespace std;
 
 struct Vertex {
@@ -32,6 +36,30 @@ struct Texture {
     unsigned int id;
     string type;
     string path;
+    // channel of a channel packed texture this map is stored in (see channel_pack.h), -1 when it has its own texture
+    int channel;
+};
+
+// a vertex attribute inside a raw vertex buffer, in glVertexAttribPointer terms (stride 0 means tightly packed)
+struct MeshAttribute {
+    unsigned int location;
+    int size;
+    GLenum type;
+    bool normalized;
+    int stride;
+    size_t offset;
+};
+
+// geometry that is already in a GPU layout (glTF buffer views), uploaded as is instead of through Vertex
+struct MeshBuffers {
+    const void* vertexData;
+    size_t vertexSize;
+    vector<MeshAttribute> attributes;
+    const void* indexData; // NULL for non-indexed geometry
+    size_t indexSize;
+    GLenum indexType;
+    unsigned int count; // indices, or vertices without them
+    glm::vec3 boundsMin, boundsMax;
 };
 
 class Mesh {
@@ -40,100 +68,316 @@ public:
     vector<Vertex> vertices;
     vector<unsigned int> indices;
     vector<Texture> textures;
-    unsigned int VAO;
+    GLVertexArray VAO;
+    // what glDrawElements draws; IndexType is 0 for meshes drawn with glDrawArrays
+    unsigned int IndexCount;
+    GLenum IndexType;
+    // Shader_Feature bits for the texture types this mesh has; selects the shader variant it is drawn with
+    unsigned int Features;
+    // bounding sphere in model space, for estimating the mesh's size on screen
+    glm::vec3 BoundsCenter;
+    float BoundsRadius;
 
     /*  Functions  */
-    // constructor
+    // constructor; pass the vertex and index arrays with std::move when the caller doesn't need them anymore
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        this->Features = FeaturesFromTextures(this->textures);
+        nameSamplers();
+        this->IndexCount = this->indices.size();
+        this->IndexType = GL_UNSIGNED_INT;
+        computeBounds();
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
+        // now that we have all the required data, set the vertex buffers; the attribute pointers go into the vertex
+        // array made by CreateVertexArray
         setupMesh();
     }
 
+    // constructor for raw buffers: the vertex and index bytes go to GL in one copy each, vertices/indices stay empty
+    Mesh(const MeshBuffers &buffers, vector<Texture> textures)
+    {
+        this->textures = std::move(textures);
+        this->Features = FeaturesFromTextures(this->textures);
+        nameSamplers();
+        this->IndexCount = buffers.count;
+        this->IndexType = buffers.indexData ? buffers.indexType : 0;
+        BoundsCenter = (buffers.boundsMin + buffers.boundsMax) * 0.5f;
+        BoundsRadius = glm::length(buffers.boundsMax - buffers.boundsMin) * 0.5f;
+
+        layout = buffers.attributes;
+
+        VBO = GLBuffer::generate();
+        EBO = GLBuffer::generate();
+        glBindBuffer(GL_COPY_WRITE_BUFFER, VBO.get());
+        glBufferData(GL_COPY_WRITE_BUFFER, buffers.vertexSize, buffers.vertexData, GL_STATIC_DRAW);
+        if(buffers.indexData)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, EBO.get());
+            glBufferData(GL_COPY_WRITE_BUFFER, buffers.indexSize, buffers.indexData, GL_STATIC_DRAW);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // constructor for meshes written straight into GPU memory: the buffers are created with their final size and
+    // mapped, the importer writes vertexCount vertices to vertexData and indexCount indices to indexData (from any
+    // thread, never reading them back) and calls Unmap on the thread that made the mesh before it is drawn. Both
+    // pointers are NULL when the buffers couldn't be mapped. vertices/indices stay empty.
+    Mesh(unsigned int vertexCount, unsigned int indexCount, vector<Texture> textures, Vertex *&vertexData, unsigned int *&indexData)
+    {
+        this->textures = std::move(textures);
+        this->Features = FeaturesFromTextures(this->textures);
+        nameSamplers();
+        this->IndexCount = indexCount;
+        this->IndexType = GL_UNSIGNED_INT;
+        BoundsCenter = glm::vec3(0.0f);
+        BoundsRadius = 0.0f;
+        layout = VertexLayout(Features);
+
+        VBO = GLBuffer::generate();
+        EBO = GLBuffer::generate();
+        glBindBuffer(GL_COPY_WRITE_BUFFER, VBO.get());
+        vertexData = (Vertex*)mapStorage(GL_COPY_WRITE_BUFFER, vertexCount * sizeof(Vertex));
+        glBindBuffer(GL_COPY_WRITE_BUFFER, EBO.get());
+        indexData = vertexData ? (unsigned int*)mapStorage(GL_COPY_WRITE_BUFFER, indexCount * sizeof(unsigned int)) : NULL;
+        if(vertexData && !indexData)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, VBO.get());
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            vertexData = NULL;
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // an empty mesh, to be assigned a loaded one
+    Mesh() : IndexCount(0), IndexType(0), Features(0), BoundsCenter(0.0f), BoundsRadius(0.0f) {}
+
+    // finishes a mesh made by the mapping constructor once its data is written. Returns false when the driver lost
+    // the buffers' contents while they were mapped, and the mesh has to be made again from the data.
+    bool Unmap(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        BoundsCenter = (boundsMin + boundsMax) * 0.5f;
+        BoundsRadius = glm::length(boundsMax - boundsMin) * 0.5f;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, VBO.get());
+        bool intact = glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, EBO.get());
+        intact = glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE && intact;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return intact;
+    }
+
+    // makes the vertex array the mesh is drawn with. Vertex arrays aren't shared between contexts, so this happens on
+    // the render thread, before the first draw, wherever the buffers were made (see Model::CreateVertexArrays)
+    void CreateVertexArray()
+    {
+        VAO = GLVertexArray::generate();
+        glBindVertexArray(VAO.get());
+        glBindBuffer(GL_ARRAY_BUFFER, VBO.get());
+        if(IndexType)
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.get());
+        for(unsigned int i = 0; i < layout.size(); i++)
+        {
+            const MeshAttribute &a = layout[i];
+            glEnableVertexAttribArray(a.location);
+            glVertexAttribPointer(a.location, a.size, a.type, a.normalized ? GL_TRUE : GL_FALSE, a.stride, (void*)a.offset);
+        }
+        glBindVertexArray(0);
+    }
+
+    // meshes own GL objects and often megabytes of vertices: they are moved, never copied
+    Mesh(Mesh &&other) = default;
+    Mesh &operator=(Mesh &&other) = default;
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+
+    // maps the texture types found by Model::processMaterial to shader feature bits
+    static unsigned int FeaturesFromTextures(const vector<Texture> &textures)
+    {
+        unsigned int features = 0;
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            if(textures[i].type == "texture_diffuse")
+                features |= SHADER_DIFFUSE_MAP;
+            else if(textures[i].type == "texture_specular")
+                features |= SHADER_SPECULAR_MAP;
+            else if(textures[i].type == "texture_normal")
+                features |= SHADER_NORMAL_MAP;
+            else if(textures[i].type == "texture_height")
+                features |= SHADER_HEIGHT_MAP;
+        }
+        return features;
+    }
+
     // render the mesh
-    void Draw(Shader shader) 
+    void Draw(const Shader &shader) const
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
+        // switch to the cheapest shader variant that covers this mesh's textures
+        shader.use(Features);
+        // bind appropriate textures; the unit table is per-frame scratch
+        unsigned int unit       = 0;
+        unsigned int *units = FrameArena.allocate<unsigned int>(textures.size());
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-				number = std::to_string(diffuseNr++);
-			else if(name == "texture_specular")
-				number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-				number = std::to_string(normalNr++); // transfer unsigned int to stream
-             else if(name == "texture_height")
-			    number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-													 // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
+            // maps packed into the same texture share its unit
+            units[i] = unit;
+            for(unsigned int j = 0; j < i; j++)
+                if(textures[j].id == textures[i].id)
+                {
+                    units[i] = units[j];
+                    break;
+                }
+            // now set the sampler to the correct texture unit
+            glUniform1i(shader.uniformLocation(samplerNames[i]), units[i]);
+            // a packed map is read from one channel, texture(texture_specular1, uv)[texture_specular1_channel]; -1 reads
+            // the texture's colour. Set on every draw, the previous mesh's channel must not stick
+            glUniform1i(shader.uniformLocation(channelNames[i]), textures[i].channel);
             // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            if(units[i] == unit)
+            {
+                glActiveTexture(GL_TEXTURE0 + unit); // active proper texture unit before binding
+                glBindTexture(GL_TEXTURE_2D, textures[i].id);
+                unit++;
+            }
         }
         
         // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(VAO.get());
+        drawElements();
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // deletes the vertex array and buffers now instead of when the mesh is destroyed (the textures belong to the model)
+    void release()
+    {
+        VAO.reset();
+        VBO.reset();
+        EBO.reset();
+    }
+
+    // render the mesh with the model's packed textures already bound; drawIndex selects its per-draw record
+    void DrawPacked(const Shader &shader, int drawIndex) const
+    {
+        shader.use(Features | SHADER_TEXTURE_ARRAYS);
+        shader.setInt("drawIndex", drawIndex);
+
+        glBindVertexArray(VAO.get());
+        drawElements();
+        glBindVertexArray(0);
+    }
+
 private:
     /*  Render data  */
-    unsigned int VBO, EBO;
+    GLBuffer VBO, EBO;
+    // the vertex attributes inside VBO, what CreateVertexArray points the vertex array at
+    vector<MeshAttribute> layout;
+    // the sampler uniform of every texture and of its channel index, built once instead of on every draw
+    vector<string> samplerNames, channelNames;
 
     /*  Functions    */
-    // initializes all the buffer objects/arrays
+    // gives the bound buffer its storage and maps all of it for writing: immutable storage on GL 4.4, a fresh
+    // glBufferData store otherwise, mapped unsynchronized either way since nothing can be using it yet
+    static void* mapStorage(GLenum target, size_t size)
+    {
+        if(GLAD_GL_VERSION_4_4)
+            glBufferStorage(target, size, NULL, GL_MAP_WRITE_BIT);
+        else
+            glBufferData(target, size, NULL, GL_STATIC_DRAW);
+        return glMapBufferRange(target, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+
+    void drawElements() const
+    {
+        if(IndexType)
+            glDrawElements(GL_TRIANGLES, IndexCount, IndexType, 0);
+        else
+            glDrawArrays(GL_TRIANGLES, 0, IndexCount);
+    }
+
+    // names the samplers by the shaders' convention: the N in texture_diffuseN counts the textures of each type
+    void nameSamplers()
+    {
+        const char *types[] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height", "texture_alpha" };
+        unsigned int numbers[] = { 1, 1, 1, 1, 1 };
+        samplerNames.resize(textures.size());
+        channelNames.resize(textures.size());
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            samplerNames[i] = textures[i].type;
+            for(int t = 0; t < 5; t++)
+                if(textures[i].type == types[t])
+                    samplerNames[i] += std::to_string(numbers[t]++);
+            // every texture gets one: grayscale maps only learn their channel once the model packs them
+            channelNames[i] = samplerNames[i] + "_channel";
+        }
+    }
+
+    // sphere around the vertices' bounding box
+    void computeBounds()
+    {
+        glm::vec3 lo(0.0f), hi(0.0f);
+        for(unsigned int i = 0; i < vertices.size(); i++)
+        {
+            lo = i ? glm::min(lo, vertices[i].Position) : vertices[i].Position;
+            hi = i ? glm::max(hi, vertices[i].Position) : vertices[i].Position;
+        }
+        BoundsCenter = (lo + hi) * 0.5f;
+        BoundsRadius = glm::length(hi - lo) * 0.5f;
+    }
+
+    // initializes the buffer objects. They are filled through GL_COPY_WRITE_BUFFER, which unlike the element array
+    // binding isn't vertex array state, so a context without vertex arrays (the upload thread's) can make them too
     void setupMesh()
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        // create buffers
+        VBO = GLBuffer::generate();
+        EBO = GLBuffer::generate();
 
-        glBindVertexArray(VAO);
         // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, VBO.get());
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+        glBufferData(GL_COPY_WRITE_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, EBO.get());
+        glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
 
-        // set the vertex attribute pointers
+        layout = VertexLayout(Features);
+    }
+
+    // the Vertex layout's attributes
+    static vector<MeshAttribute> VertexLayout(unsigned int features)
+    {
+        vector<MeshAttribute> attributes;
         // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        MeshAttribute position = { 0, 3, GL_FLOAT, false, (int)sizeof(Vertex), 0 };
+        attributes.push_back(position);
         // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        MeshAttribute normal = { 1, 3, GL_FLOAT, false, (int)sizeof(Vertex), offsetof(Vertex, Normal) };
+        attributes.push_back(normal);
         // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        MeshAttribute texCoords = { 2, 2, GL_FLOAT, false, (int)sizeof(Vertex), offsetof(Vertex, TexCoords) };
+        attributes.push_back(texCoords);
+        // vertex tangent and bitangent, only generated for meshes with normal maps (the height map is the grayscale
+        // reflection map, it needs none)
+        if(features & SHADER_NORMAL_MAP)
+        {
+            MeshAttribute tangent = { 3, 3, GL_FLOAT, false, (int)sizeof(Vertex), offsetof(Vertex, Tangent) };
+            MeshAttribute bitangent = { 4, 3, GL_FLOAT, false, (int)sizeof(Vertex), offsetof(Vertex, Bitangent) };
+            attributes.push_back(tangent);
+            attributes.push_back(bitangent);
+        }
+        return attributes;
     }
 };
+
+// the draw path only ever moves meshes; copying one would duplicate its vertex data and share its GL objects
+static_assert(!std::is_copy_constructible<Mesh>::value && !std::is_copy_assignable<Mesh>::value, "Mesh must not be copyable");
+static_assert(std::is_nothrow_move_constructible<Mesh>::value, "vector<Mesh> must move meshes when it grows");
 #endif
@@ -0,0 +1,294 @@
+#ifndef MESH_CODEC_H
+#define MESH_CODEC_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/archive.h>
+
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESH_CODEC_SSE2 1
+#endif
+
+// Mesh codec for the on-disk cache. Indices are stored as the zigzag varint of their difference to the previous index,
+// one byte for most of them. Vertices are split into one stream per 32-bit component, each stored as the zigzag of its
+// difference to the previous vertex's word and split into four byte planes, so the mostly zero high bytes end up next
+// to each other. The result is optionally run through the archive's LZ compressor, which squeezes those planes well.
+// Decoding is integer unzigzag and prefix sums, done 16 values at a time with SSE2 when it is available.
+
+const uint32_t MESH_CODEC_MAGIC   = 0x4853454d; // "MESH"
+const uint32_t MESH_CODEC_VERSION = 1;
+const uint32_t MESH_CODEC_LZ      = 1;
+
+// 32-bit words per Vertex, one stream each
+const int MESH_CODEC_STREAMS = sizeof(Vertex) / sizeof(uint32_t);
+
+inline uint32_t MeshZigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+inline uint32_t MeshUnzigzag(uint32_t v)
+{
+    return (v >> 1) ^ (0u - (v & 1));
+}
+
+void MeshEncodeIndices(const unsigned int* indices, size_t count, std::vector<char> &out)
+{
+    uint32_t previous = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t v = MeshZigzag((int32_t)(indices[i] - previous));
+        previous = indices[i];
+        while (v >= 0x80)
+        {
+            out.push_back((char)(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back((char)v);
+    }
+}
+
+#ifdef MESH_CODEC_SSE2
+// unzigzag and running sum of four lanes; carry holds the previous value in every lane and is updated
+inline __m128i MeshPrefixSum(__m128i v, __m128i &carry)
+{
+    v = _mm_xor_si128(_mm_srli_epi32(v, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(v, _mm_set1_epi32(1))));
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+    v = _mm_add_epi32(v, carry);
+    carry = _mm_shuffle_epi32(v, 0xFF);
+    return v;
+}
+#endif
+
+// decodes count indices from [p, end); false on truncated or malformed data
+bool MeshDecodeIndices(const char* &p, const char* end, unsigned int* indices, size_t count, bool simd = true)
+{
+    const unsigned char* in = (const unsigned char*)p;
+    const unsigned char* stop = (const unsigned char*)end;
+    uint32_t previous = 0;
+    size_t i = 0;
+#ifdef MESH_CODEC_SSE2
+    __m128i carry = _mm_setzero_si128();
+    while (simd && i + 16 <= count && stop - in >= 16)
+    {
+        // sixteen single byte varints at once; blocks with longer ones take the scalar path
+        __m128i bytes = _mm_loadu_si128((const __m128i*)in);
+        if (_mm_movemask_epi8(bytes) == 0)
+        {
+            __m128i zero = _mm_setzero_si128();
+            __m128i lo = _mm_unpacklo_epi8(bytes, zero), hi = _mm_unpackhi_epi8(bytes, zero);
+            _mm_storeu_si128((__m128i*)(indices + i), MeshPrefixSum(_mm_unpacklo_epi16(lo, zero), carry));
+            _mm_storeu_si128((__m128i*)(indices + i + 4), MeshPrefixSum(_mm_unpackhi_epi16(lo, zero), carry));
+            _mm_storeu_si128((__m128i*)(indices + i + 8), MeshPrefixSum(_mm_unpacklo_epi16(hi, zero), carry));
+            _mm_storeu_si128((__m128i*)(indices + i + 12), MeshPrefixSum(_mm_unpackhi_epi16(hi, zero), carry));
+            in += 16;
+            i += 16;
+            continue;
+        }
+        for (size_t stopAt = i + 16; i < stopAt; i++)
+        {
+            uint32_t v = 0;
+            for (int shift = 0; ; shift += 7)
+            {
+                if (in >= stop || shift > 28)
+                    return false;
+                uint32_t b = *in++;
+                v |= (b & 0x7F) << shift;
+                if (b < 0x80)
+                    break;
+            }
+            indices[i] = (uint32_t)_mm_cvtsi128_si32(carry) + MeshUnzigzag(v);
+            carry = _mm_set1_epi32((int)indices[i]);
+        }
+    }
+    previous = i ? indices[i - 1] : 0;
+#endif
+    for (; i < count; i++)
+    {
+        uint32_t v = 0;
+        for (int shift = 0; ; shift += 7)
+        {
+            if (in >= stop || shift > 28)
+                return false;
+            uint32_t b = *in++;
+            v |= (b & 0x7F) << shift;
+            if (b < 0x80)
+                break;
+        }
+        previous += MeshUnzigzag(v);
+        indices[i] = previous;
+    }
+    p = (const char*)in;
+    return true;
+}
+
+// vertex streams, each as 4 byte planes of count bytes: MESH_CODEC_STREAMS * 4 * count bytes
+void MeshEncodeVertices(const Vertex* vertices, size_t count, std::vector<char> &out)
+{
+    size_t base = out.size();
+    out.resize(base + (size_t)MESH_CODEC_STREAMS * 4 * count);
+    unsigned char* planes = (unsigned char*)&out[base];
+    const unsigned char* words = (const unsigned char*)vertices;
+    for (int s = 0; s < MESH_CODEC_STREAMS; s++)
+    {
+        unsigned char* plane = planes + (size_t)s * 4 * count;
+        uint32_t previous = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t word;
+            std::memcpy(&word, words + i * sizeof(Vertex) + s * 4, 4);
+            uint32_t v = MeshZigzag((int32_t)(word - previous));
+            previous = word;
+            for (int b = 0; b < 4; b++)
+                plane[b * count + i] = (unsigned char)(v >> (8 * b));
+        }
+    }
+}
+
+bool MeshDecodeVertices(const char* &p, const char* end, Vertex* vertices, size_t count, bool simd = true)
+{
+    size_t size = (size_t)MESH_CODEC_STREAMS * 4 * count;
+    if ((size_t)(end - p) < size)
+        return false;
+    const unsigned char* planes = (const unsigned char*)p;
+    unsigned char* words = (unsigned char*)vertices;
+    // blocks of 16 vertices: every stream is decoded into a small structure of arrays, then written out interleaved
+    const size_t BLOCK = 16;
+    uint32_t block[MESH_CODEC_STREAMS][BLOCK];
+    uint32_t previous[MESH_CODEC_STREAMS] = { 0 };
+    for (size_t first = 0; first < count; first += BLOCK)
+    {
+        size_t n = count - first < BLOCK ? count - first : BLOCK;
+        for (int s = 0; s < MESH_CODEC_STREAMS; s++)
+        {
+            const unsigned char* plane = planes + (size_t)s * 4 * count + first;
+#ifdef MESH_CODEC_SSE2
+            if (simd && n == BLOCK)
+            {
+                __m128i p0 = _mm_loadu_si128((const __m128i*)plane);
+                __m128i p1 = _mm_loadu_si128((const __m128i*)(plane + count));
+                __m128i p2 = _mm_loadu_si128((const __m128i*)(plane + 2 * count));
+                __m128i p3 = _mm_loadu_si128((const __m128i*)(plane + 3 * count));
+                // byte planes back into words: 01 and 23 byte pairs, then the pairs into 32-bit lanes
+                __m128i lo01 = _mm_unpacklo_epi8(p0, p1), hi01 = _mm_unpackhi_epi8(p0, p1);
+                __m128i lo23 = _mm_unpacklo_epi8(p2, p3), hi23 = _mm_unpackhi_epi8(p2, p3);
+                __m128i carry = _mm_set1_epi32((int)previous[s]);
+                _mm_storeu_si128((__m128i*)&block[s][0], MeshPrefixSum(_mm_unpacklo_epi16(lo01, lo23), carry));
+                _mm_storeu_si128((__m128i*)&block[s][4], MeshPrefixSum(_mm_unpackhi_epi16(lo01, lo23), carry));
+                _mm_storeu_si128((__m128i*)&block[s][8], MeshPrefixSum(_mm_unpacklo_epi16(hi01, hi23), carry));
+                _mm_storeu_si128((__m128i*)&block[s][12], MeshPrefixSum(_mm_unpackhi_epi16(hi01, hi23), carry));
+                previous[s] = block[s][15];
+                continue;
+            }
+#endif
+            for (size_t i = 0; i < n; i++)
+            {
+                uint32_t v = plane[i] | (uint32_t)plane[i + count] << 8 | (uint32_t)plane[i + 2 * count] << 16 | (uint32_t)plane[i + 3 * count] << 24;
+                previous[s] += MeshUnzigzag(v);
+                block[s][i] = previous[s];
+            }
+        }
+        size_t i = 0;
+#ifdef MESH_CODEC_SSE2
+        // 4x4 transposes of four streams of four vertices; the last two streams go in pairs
+        for (; simd && MESH_CODEC_STREAMS == 14 && i + 4 <= n; i += 4)
+        {
+            unsigned char* out = words + (first + i) * sizeof(Vertex);
+            for (int s = 0; s < 12; s += 4)
+            {
+                __m128i r0 = _mm_loadu_si128((const __m128i*)&block[s][i]), r1 = _mm_loadu_si128((const __m128i*)&block[s + 1][i]);
+                __m128i r2 = _mm_loadu_si128((const __m128i*)&block[s + 2][i]), r3 = _mm_loadu_si128((const __m128i*)&block[s + 3][i]);
+                __m128i t0 = _mm_unpacklo_epi32(r0, r1), t1 = _mm_unpacklo_epi32(r2, r3);
+                __m128i t2 = _mm_unpackhi_epi32(r0, r1), t3 = _mm_unpackhi_epi32(r2, r3);
+                _mm_storeu_si128((__m128i*)(out + s * 4), _mm_unpacklo_epi64(t0, t1));
+                _mm_storeu_si128((__m128i*)(out + sizeof(Vertex) + s * 4), _mm_unpackhi_epi64(t0, t1));
+                _mm_storeu_si128((__m128i*)(out + 2 * sizeof(Vertex) + s * 4), _mm_unpacklo_epi64(t2, t3));
+                _mm_storeu_si128((__m128i*)(out + 3 * sizeof(Vertex) + s * 4), _mm_unpackhi_epi64(t2, t3));
+            }
+            __m128i r12 = _mm_loadu_si128((const __m128i*)&block[12][i]), r13 = _mm_loadu_si128((const __m128i*)&block[13][i]);
+            __m128i lo = _mm_unpacklo_epi32(r12, r13), hi = _mm_unpackhi_epi32(r12, r13);
+            _mm_storel_epi64((__m128i*)(out + 48), lo);
+            _mm_storel_epi64((__m128i*)(out + sizeof(Vertex) + 48), _mm_srli_si128(lo, 8));
+            _mm_storel_epi64((__m128i*)(out + 2 * sizeof(Vertex) + 48), hi);
+            _mm_storel_epi64((__m128i*)(out + 3 * sizeof(Vertex) + 48), _mm_srli_si128(hi, 8));
+        }
+#endif
+        for (; i < n; i++)
+        {
+            uint32_t vertex[MESH_CODEC_STREAMS];
+            for (int s = 0; s < MESH_CODEC_STREAMS; s++)
+                vertex[s] = block[s][i];
+            std::memcpy(words + (first + i) * sizeof(Vertex), vertex, sizeof(Vertex));
+        }
+    }
+    p += size;
+    return true;
+}
+
+// Encodes a mesh as { vertexCount, indexCount } followed by the vertex planes and the index varints
+void MeshEncode(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, std::vector<char> &out)
+{
+    uint32_t counts[2] = { (uint32_t)vertices.size(), (uint32_t)indices.size() };
+    out.insert(out.end(), (const char*)counts, (const char*)counts + sizeof(counts));
+    if (!vertices.empty())
+        MeshEncodeVertices(&vertices[0], vertices.size(), out);
+    if (!indices.empty())
+        MeshEncodeIndices(&indices[0], indices.size(), out);
+}
+
+bool MeshDecode(const char* &p, const char* end, std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, bool simd = true)
+{
+    uint32_t counts[2];
+    if ((size_t)(end - p) < sizeof(counts))
+        return false;
+    std::memcpy(counts, p, sizeof(counts));
+    p += sizeof(counts);
+    // every vertex takes MESH_CODEC_STREAMS * 4 bytes and every index at least one, so bogus counts fail here
+    if (counts[0] > (size_t)(end - p) / (MESH_CODEC_STREAMS * 4) || counts[1] > (size_t)(end - p))
+        return false;
+    vertices.resize(counts[0]);
+    indices.resize(counts[1]);
+    return (!counts[0] || MeshDecodeVertices(p, end, &vertices[0], counts[0], simd)) &&
+           (!counts[1] || MeshDecodeIndices(p, end, &indices[0], counts[1], simd));
+}
+
+// wraps an encoded payload as { magic, version, flags, size } plus the payload, LZ compressed when that saves at least
+// an eighth (and compress is set)
+void MeshCodecPack(const std::vector<char> &payload, bool compress, std::vector<char> &out)
+{
+    std::vector<char> compressed;
+    if (compress && !payload.empty())
+        ArchiveCompress(&payload[0], payload.size(), compressed);
+    bool useCompressed = !compressed.empty() && compressed.size() < payload.size() - payload.size() / 8;
+    uint32_t header[4] = { MESH_CODEC_MAGIC, MESH_CODEC_VERSION, useCompressed ? MESH_CODEC_LZ : 0u, (uint32_t)payload.size() };
+    const std::vector<char> &body = useCompressed ? compressed : payload;
+    out.assign((const char*)header, (const char*)header + sizeof(header));
+    out.insert(out.end(), body.begin(), body.end());
+}
+
+bool MeshCodecUnpack(const std::vector<char> &packed, std::vector<char> &payload)
+{
+    uint32_t header[4];
+    if (packed.size() < sizeof(header))
+        return false;
+    std::memcpy(header, &packed[0], sizeof(header));
+    if (header[0] != MESH_CODEC_MAGIC || header[1] != MESH_CODEC_VERSION)
+        return false;
+    const char* body = &packed[0] + sizeof(header);
+    size_t bodySize = packed.size() - sizeof(header);
+    if (!(header[2] & MESH_CODEC_LZ))
+    {
+        if (bodySize != header[3])
+            return false;
+        payload.assign(body, body + bodySize);
+        return true;
+    }
+    payload.resize(header[3]);
+    return header[3] == 0 || ArchiveDecompress(body, bodySize, &payload[0], payload.size());
+}
+#endif
@@ -0,0 +1,292 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <glad/glad.h>
+
+#include <stb_image.h>
+
+#include <learnopengl/cache.h>
+#include <learnopengl/archive.h>
+#include <learnopengl/job_system.h>
+#include <learnopengl/log.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MIPMAP_SSE 1
+#endif
+
+const uint32_t MIPMAP_MAGIC   = 0x5350494d; // "MIPS"
+const uint32_t MIPMAP_VERSION = 1;
+// largest side a cached chain may claim
+const uint32_t MIPMAP_MAX_SIZE = 32768;
+
+// number of levels in a full mip chain down to 1x1
+int MipLevelCount(int width, int height)
+{
+    int levels = 1;
+    while (width > 1 || height > 1)
+    {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        levels++;
+    }
+    return levels;
+}
+
+// A texture with its whole mip chain, every level tightly packed one after the other (level 0 first).
+struct MipChain {
+    int width, height, channels;
+    std::vector<size_t> offsets; // start of each level in data
+    std::vector<unsigned char> data;
+
+    MipChain() : width(0), height(0), channels(0) {}
+
+    int levels() const { return (int)offsets.size(); }
+    int levelWidth(int level) const { return std::max(1, width >> level); }
+    int levelHeight(int level) const { return std::max(1, height >> level); }
+    const unsigned char* level(int level) const { return &data[offsets[level]]; }
+};
+
+// sRGB transfer functions. Colour textures are averaged in linear light, otherwise the smaller mips get darker.
+float SRGBToLinear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+float LinearToSRGB(float c)
+{
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+// runs fn(begin, end) over [0, count) split across the job system, at least 16 rows per job
+template <typename Fn>
+void ParallelRows(int count, Fn fn)
+{
+    Jobs.parallelFor((size_t)count, 16, [&fn](size_t begin, size_t end) { fn((int)begin, (int)end); });
+}
+
+// Builds the full mip chain of an 8-bit image with a 2x2 box filter. Filtering runs on 4-wide float pixels (SSE when
+// available); with srgb set the colour channels are converted to linear light first and encoded back per level, alpha
+// always stays linear. Level 0 is the source image unchanged.
+void BuildMipChain(const unsigned char* pixels, int width, int height, int channels, bool srgb, MipChain &chain)
+{
+    chain.width = width;
+    chain.height = height;
+    chain.channels = channels;
+    chain.offsets.clear();
+    size_t total = 0;
+    for (int i = 0; i < MipLevelCount(width, height); i++)
+    {
+        chain.offsets.push_back(total);
+        total += (size_t)chain.levelWidth(i) * chain.levelHeight(i) * channels;
+    }
+    chain.data.resize(total);
+    std::memcpy(&chain.data[0], pixels, (size_t)width * height * channels);
+
+    // 8-bit to float table per channel kind, so decoding level 0 is a lookup
+    float toLinear[256], toFloat[256];
+    for (int i = 0; i < 256; i++)
+    {
+        toFloat[i] = i / 255.0f;
+        toLinear[i] = SRGBToLinear(i / 255.0f);
+    }
+    int colorChannels = channels == 4 ? 3 : channels == 2 ? 1 : channels;
+    bool linearize = srgb && channels >= 3;
+
+    // current level as RGBA floats (missing channels are zero and never written back)
+    std::vector<float> current((size_t)width * height * 4, 0.0f);
+    ParallelRows(height, [&](int begin, int end) {
+        for (int y = begin; y < end; y++)
+            for (int x = 0; x < width; x++)
+            {
+                const unsigned char* src = pixels + ((size_t)y * width + x) * channels;
+                float* dst = &current[((size_t)y * width + x) * 4];
+                for (int c = 0; c < channels; c++)
+                    dst[c] = (linearize && c < colorChannels ? toLinear : toFloat)[src[c]];
+            }
+    });
+
+    std::vector<float> next;
+    for (int level = 1; level < chain.levels(); level++)
+    {
+        int sw = chain.levelWidth(level - 1), sh = chain.levelHeight(level - 1);
+        int dw = chain.levelWidth(level), dh = chain.levelHeight(level);
+        next.assign((size_t)dw * dh * 4, 0.0f);
+        unsigned char* out = &chain.data[chain.offsets[level]];
+        ParallelRows(dh, [&](int begin, int end) {
+            for (int y = begin; y < end; y++)
+            {
+                // odd sizes clamp the second tap to the edge
+                const float* row0 = &current[(size_t)std::min(2 * y, sh - 1) * sw * 4];
+                const float* row1 = &current[(size_t)std::min(2 * y + 1, sh - 1) * sw * 4];
+                for (int x = 0; x < dw; x++)
+                {
+                    int x0 = std::min(2 * x, sw - 1) * 4, x1 = std::min(2 * x + 1, sw - 1) * 4;
+                    float* dst = &next[((size_t)y * dw + x) * 4];
+#ifdef MIPMAP_SSE
+                    __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)),
+                                            _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+                    _mm_storeu_ps(dst, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+                    for (int c = 0; c < 4; c++)
+                        dst[c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+#endif
+                    unsigned char* texel = out + ((size_t)y * dw + x) * channels;
+                    for (int c = 0; c < channels; c++)
+                    {
+                        float v = linearize && c < colorChannels ? LinearToSRGB(dst[c]) : dst[c];
+                        texel[c] = (unsigned char)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+                    }
+                }
+            }
+        });
+        current.swap(next);
+    }
+}
+
+// Cached chains are stored as { magic, version, width, height, channels, levels } followed by the levels.
+// Returns false when there is no (valid) entry for the key.
+bool ReadCachedMipChain(const std::string &key, MipChain &chain)
+{
+    std::vector<char> cached;
+    if (!Cache::Read(key, cached) || cached.size() < 6 * sizeof(uint32_t))
+        return false;
+    uint32_t header[6];
+    std::memcpy(header, &cached[0], sizeof(header));
+    if (header[0] != MIPMAP_MAGIC || header[1] != MIPMAP_VERSION)
+        return false;
+    // a damaged entry must not size anything: the header has to describe a full chain of exactly the stored bytes
+    uint64_t width = header[2], height = header[3], channels = header[4], total = 0;
+    bool valid = width >= 1 && width <= MIPMAP_MAX_SIZE && height >= 1 && height <= MIPMAP_MAX_SIZE && channels >= 1 && channels <= 4 &&
+                 header[5] == (uint32_t)MipLevelCount((int)width, (int)height);
+    for (uint32_t i = 0; valid && i < header[5]; i++)
+        total += std::max<uint64_t>(1, width >> i) * std::max<uint64_t>(1, height >> i) * channels;
+    if (!valid || cached.size() - sizeof(header) != total)
+    {
+        LOG_WARN("MIPMAP:: cache entry %s is invalid, rebuilding", key);
+        return false;
+    }
+    chain.width = (int)width;
+    chain.height = (int)height;
+    chain.channels = (int)channels;
+    chain.offsets.clear();
+    size_t offset = 0;
+    for (int i = 0; i < (int)header[5]; i++)
+    {
+        chain.offsets.push_back(offset);
+        offset += (size_t)chain.levelWidth(i) * chain.levelHeight(i) * chain.channels;
+    }
+    chain.data.assign(cached.begin() + sizeof(header), cached.end());
+    return true;
+}
+
+void WriteCachedMipChain(const std::string &key, const MipChain &chain)
+{
+    std::vector<char> entry(6 * sizeof(uint32_t) + chain.data.size());
+    uint32_t header[6] = { MIPMAP_MAGIC, MIPMAP_VERSION, (uint32_t)chain.width, (uint32_t)chain.height, (uint32_t)chain.channels, (uint32_t)chain.levels() };
+    std::memcpy(&entry[0], header, sizeof(header));
+    std::memcpy(&entry[sizeof(header)], &chain.data[0], chain.data.size());
+    if (!Cache::Write(key, entry))
+        LOG_WARN("MIPMAP:: could not write cache entry %s", key);
+}
+
+// Loads an image file and its mip chain. Chains are cached under a hash of the file contents and the build parameters,
+// so only the first load of a texture decodes and filters it; later loads read the finished levels from disk.
+// desiredChannels works like stbi_load's (0 keeps the file's channel count).
+bool LoadMipChainFromMemory(const char* data, size_t size, int desiredChannels, bool srgb, MipChain &chain);
+
+bool LoadMipChain(const std::string &filename, int desiredChannels, bool srgb, MipChain &chain)
+{
+    ResourceData source;
+    if (!ReadResource(filename, source))
+        return false;
+    return LoadMipChainFromMemory(source.data, source.size, desiredChannels, srgb, chain);
+}
+
+// the same for an encoded image already in memory, such as one embedded in a model file
+bool LoadMipChainFromMemory(const char* data, size_t size, int desiredChannels, bool srgb, MipChain &chain)
+{
+    uint32_t params[3] = { MIPMAP_VERSION, (uint32_t)desiredChannels, srgb ? 1u : 0u };
+    std::string key = Cache::Key(Cache::Hash(data, size, Cache::Hash(params, sizeof(params))), "mips");
+    if (ReadCachedMipChain(key, chain))
+        return true;
+
+    int width, height, channels;
+    unsigned char* pixels = stbi_load_from_memory((const unsigned char*)data, (int)size, &width, &height, &channels, desiredChannels);
+    if (!pixels)
+        return false;
+    BuildMipChain(pixels, width, height, desiredChannels ? desiredChannels : channels, srgb, chain);
+    stbi_image_free(pixels);
+    WriteCachedMipChain(key, chain);
+    return true;
+}
+
+// GL formats for an 8-bit texture with the given number of channels
+GLenum MipChainFormat(int channels)
+{
+    return channels == 1 ? GL_RED : channels == 2 ? GL_RG : channels == 3 ? GL_RGB : GL_RGBA;
+}
+
+GLenum MipChainInternalFormat(int channels)
+{
+    return channels == 1 ? GL_R8 : channels == 2 ? GL_RG8 : channels == 3 ? GL_RGB8 : GL_RGBA8;
+}
+
+// single channel textures are grayscale maps: the bound GL_TEXTURE_2D reads as (r, r, r, 1), like the RGB file did
+void SetMipChainSwizzle(const MipChain &chain)
+{
+    if (chain.channels != 1)
+        return;
+    GLint swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+}
+
+// Uploads every level of the chain into the GL_TEXTURE_2D currently bound. Uses immutable storage when the context
+// has glTexStorage2D (GL 4.2+) and falls back to one glTexImage2D per level otherwise.
+void UploadMipChain(const MipChain &chain)
+{
+    GLenum format = MipChainFormat(chain.channels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (glTexStorage2D)
+    {
+        glTexStorage2D(GL_TEXTURE_2D, chain.levels(), MipChainInternalFormat(chain.channels), chain.width, chain.height);
+        for (int i = 0; i < chain.levels(); i++)
+            glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, chain.levelWidth(i), chain.levelHeight(i), format, GL_UNSIGNED_BYTE, chain.level(i));
+    }
+    else
+    {
+        for (int i = 0; i < chain.levels(); i++)
+            glTexImage2D(GL_TEXTURE_2D, i, MipChainInternalFormat(chain.channels), chain.levelWidth(i), chain.levelHeight(i), 0, format, GL_UNSIGNED_BYTE, chain.level(i));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, chain.levels() - 1);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    SetMipChainSwizzle(chain);
+}
+
+// Uploads the levels of the chain from base on as levels 0, 1, ... of the GL_TEXTURE_2D currently bound. The storage is
+// mutable so the texture can be re-specified later with another base; previousLevels is the level count of the
+// current specification, whose levels the new one doesn't reach are freed. The pixels of level base and those after
+// it are read from pixels, packed as in chain.data: pass chain.level(base), or NULL with a pixel unpack buffer bound
+// that holds them from its start (the chain's data isn't needed then, only its size and offsets).
+void UploadMipChainFrom(const MipChain &chain, int base, int previousLevels, const unsigned char* pixels)
+{
+    GLenum format = MipChainFormat(chain.channels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int i = base; i < chain.levels(); i++)
+        glTexImage2D(GL_TEXTURE_2D, i - base, MipChainInternalFormat(chain.channels), chain.levelWidth(i), chain.levelHeight(i), 0, format, GL_UNSIGNED_BYTE,
+                     pixels + (chain.offsets[i] - chain.offsets[base]));
+    for (int i = chain.levels() - base; i < previousLevels; i++)
+        glTexImage2D(GL_TEXTURE_2D, i, MipChainInternalFormat(chain.channels), 0, 0, 0, format, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, chain.levels() - base - 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    SetMipChainSwizzle(chain);
+}
+#endif
@@ -11,7 +11,17 @@
 #include <assimp/postprocess.h>
 
 #include <learnopengl/mesh.h>
-#include <learnopengl/shader.h>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/log.h>
+#include <learnopengl/texture_packer.h>
+#include <learnopengl/mipmap.h>
+#include <learnopengl/channel_pack.h>
+#include <learnopengl/texture_residency.h>
+#include <learnopengl/archive_io.h>
+#include <learnopengl/obj_loader.h>
+#include <learnopengl/gltf_loader.h>
+#include <learnopengl/tangents.h>
+#include <learnopengl/job_system.h>
 
 #include <string>
 #include <fstream>
@@ -19,9 +29,99 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false, TextureResidency *residency = NULL, int desiredChannels = 0);
+
+// the number of indices of an aiMesh's faces; they are triangles after aiProcess_Triangulate, except for point and
+// line primitives
+size_t AiMeshIndexCount(const aiMesh *mesh)
+{
+    size_t indexCount = 0;
+    for(unsigned int f = 0; f < mesh->mNumFaces; f++)
+        indexCount += mesh->mFaces[f].mNumIndices;
+    return indexCount;
+}
+
+// converts an aiMesh's separate attribute arrays into interleaved Vertex data and its faces into an index list,
+// writing mNumVertices vertices and AiMeshIndexCount indices. The destination is only written, in order, so it can
+// be a mapped GL buffer. Missing attributes are zero (tangents only come from formats that store them, see
+// tangents.h). Touches no GL state, so meshes can be converted in parallel.
+void ConvertAiMesh(const aiMesh *mesh, Vertex *vertices, unsigned int *indices)
+{
+    unsigned int count = mesh->mNumVertices;
+    const aiVector3D *texCoords = mesh->mTextureCoords[0];
+    const aiVector3D *tangents = mesh->mTangents, *bitangents = mesh->mBitangents;
+    unsigned int i = 0;
+#if defined(MESH_CODEC_SSE2) && !defined(ASSIMP_DOUBLE_PRECISION)
+    // every attribute is moved with one 4-float load and store; each store's fourth float is overwritten by the next
+    // attribute (or by the next vertex), which is why the last vertex is left to the scalar loop
+    if(mesh->mNormals && texCoords)
+    {
+        float *dst = (float*)vertices;
+        const __m128 zero = _mm_setzero_ps();
+        for(; i + 1 < count; i++, dst += sizeof(Vertex) / sizeof(float))
+        {
+            _mm_storeu_ps(dst, _mm_loadu_ps((const float*)(mesh->mVertices + i)));
+            _mm_storeu_ps(dst + 3, _mm_loadu_ps((const float*)(mesh->mNormals + i)));
+            _mm_storeu_ps(dst + 6, _mm_loadu_ps((const float*)(texCoords + i)));
+            _mm_storeu_ps(dst + 8, tangents ? _mm_loadu_ps((const float*)(tangents + i)) : zero);
+            _mm_storeu_ps(dst + 11, bitangents ? _mm_loadu_ps((const float*)(bitangents + i)) : zero);
+        }
+    }
+#endif
+    for(; i < count; i++)
+    {
+        Vertex &vertex = vertices[i];
+        const aiVector3D zero(0.0f, 0.0f, 0.0f);
+        const aiVector3D &position = mesh->mVertices[i];
+        const aiVector3D &normal = mesh->mNormals ? mesh->mNormals[i] : zero;
+        const aiVector3D &uv = texCoords ? texCoords[i] : zero;
+        const aiVector3D &tangent = tangents ? tangents[i] : zero;
+        const aiVector3D &bitangent = bitangents ? bitangents[i] : zero;
+        vertex.Position = glm::vec3(position.x, position.y, position.z);
+        vertex.Normal = glm::vec3(normal.x, normal.y, normal.z);
+        // a vertex can contain up to 8 different texture coordinates, we always take the first set (0)
+        vertex.TexCoords = glm::vec2(uv.x, uv.y);
+        vertex.Tangent = glm::vec3(tangent.x, tangent.y, tangent.z);
+        vertex.Bitangent = glm::vec3(bitangent.x, bitangent.y, bitangent.z);
+    }
+
+    for(unsigned int f = 0; f < mesh->mNumFaces; f++)
+    {
+        const aiFace &face = mesh->mFaces[f];
+        std::memcpy(indices, face.mIndices, face.mNumIndices * sizeof(unsigned int));
+        indices += face.mNumIndices;
+    }
+}
+
+// the same into vectors sized up front, for meshes that are processed further before they are uploaded
+void ConvertAiMesh(const aiMesh *mesh, ObjMesh &out)
+{
+    out.vertices.resize(mesh->mNumVertices);
+    out.indices.resize(AiMeshIndexCount(mesh));
+    ConvertAiMesh(mesh, out.vertices.empty() ? NULL : &out.vertices[0], out.indices.empty() ? NULL : &out.indices[0]);
+}
+
+// reads OBJ files through Assimp too instead of ObjLoader (--assimp)
+bool ModelForceAssimp = false;
+
+// a node of a model's hierarchy: its transform relative to its parent, and the meshes it draws, a range of meshes
+struct ModelNode {
+    int Parent;             // index of the parent node, -1 for a root; parents come before their children
+    glm::mat4 Transform;
+    unsigned int FirstMesh;
+    unsigned int MeshCount;
+};
+
+// Assimp matrices are row-major
+glm::mat4 AiMatrix(const aiMatrix4x4 &m)
+{
+    return glm::mat4(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2, m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4);
+}
 
 class Model 
 {
@@ -29,119 +129,511 @@ public:
     /*  Model Data */
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh> meshes;
+    // the node hierarchy of the file, in depth-first order; meshes are stored in the same order
+    vector<ModelNode> nodes;
     string directory;
     bool gammaCorrection;
+    // the model's material textures packed into arrays/atlases, used by Draw once PackTextures succeeded
+    TexturePacker packer;
+    // when set, the model's textures are loaded through it and their mips follow their size on screen
+    TextureResidency *residency;
 
     /*  Functions   */
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // constructor, expects a filepath to a 3D model. The buffers and textures are made on the calling thread, which
+    // may be any with a context shared with the render thread's (the upload thread); CreateVertexArrays then has to
+    // run on the render thread before the model is drawn.
+    Model(string const &path, bool gamma = false, TextureResidency *residency = NULL) : gammaCorrection(gamma), residency(residency)
     {
         loadModel(path);
+        packGrayMaps();
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader shader)
+    // an empty model, to be assigned a loaded one
+    Model() : gammaCorrection(false), residency(NULL) {}
+
+    // models own their meshes and textures: they are moved or passed by reference, never copied. A moved-from model
+    // is empty, and destroying a model frees its GL memory.
+    Model(Model &&other) : gammaCorrection(false), residency(NULL)
+    {
+        *this = std::move(other);
+    }
+
+    Model &operator=(Model &&other)
+    {
+        if(this == &other)
+            return *this;
+        release();
+        textures_loaded = std::move(other.textures_loaded);
+        other.textures_loaded.clear();
+        meshes = std::move(other.meshes);
+        other.meshes.clear();
+        nodes = std::move(other.nodes);
+        other.nodes.clear();
+        directory = std::move(other.directory);
+        gammaCorrection = other.gammaCorrection;
+        packer = std::move(other.packer);
+        residency = other.residency;
+        return *this;
+    }
+
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+
+    ~Model()
+    {
+        release();
+    }
+
+    // makes the meshes' vertex arrays on the calling thread's context, the one that draws the model
+    void CreateVertexArrays()
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].CreateVertexArray();
+    }
+
+    // a sphere around the bounding spheres of count meshes from first, in their node's space
+    void BoundingSphere(unsigned int first, unsigned int count, glm::vec3 &center, float &radius) const
+    {
+        center = glm::vec3(0.0f);
+        radius = 0.0f;
+        if(count == 0)
+            return;
+        glm::vec3 lo = meshes[first].BoundsCenter - glm::vec3(meshes[first].BoundsRadius), hi = meshes[first].BoundsCenter + glm::vec3(meshes[first].BoundsRadius);
+        for(unsigned int i = first + 1; i < first + count; i++)
+        {
+            lo = glm::min(lo, meshes[i].BoundsCenter - glm::vec3(meshes[i].BoundsRadius));
+            hi = glm::max(hi, meshes[i].BoundsCenter + glm::vec3(meshes[i].BoundsRadius));
+        }
+        center = (lo + hi) * 0.5f;
+        for(unsigned int i = first; i < first + count; i++)
+            radius = std::max(radius, glm::length(meshes[i].BoundsCenter - center) + meshes[i].BoundsRadius);
+    }
+
+    // the distinct shader variants the meshes of this model are drawn with, for Shader::prepareVariants
+    vector<unsigned int> VariantKeys() const
     {
+        vector<unsigned int> keys;
         for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            unsigned int key = meshes[i].Features | (packer.Packed ? SHADER_TEXTURE_ARRAYS : 0);
+            if(std::find(keys.begin(), keys.end(), key) == keys.end())
+                keys.push_back(key);
+        }
+        return keys;
+    }
+
+    // packs the material textures into texture arrays so the model is drawn with a single set of texture bindings.
+    // The per-mesh textures are deleted afterwards; on failure the model keeps drawing with them.
+    bool PackTextures()
+    {
+        if(!packer.pack(meshes, directory))
+            return false;
+        if(residency)
+        {
+            // the arrays aren't the residency manager's to shrink, but they count against its budget. The per-mesh
+            // textures can give memory back, so a model whose arrays would put the budget over keeps drawing with them
+            size_t before = residency->FixedBytes, replaced = 0;
+            for(int s = 0; s < PACKED_SLOTS; s++)
+            {
+                residency->addFixed(GL_TEXTURE_2D_ARRAY, packer.slots[s].arrayTexture.get());
+                residency->addFixed(GL_TEXTURE_2D, packer.slots[s].atlasTexture.get());
+            }
+            for(unsigned int i = 0; i < textures_loaded.size(); i++)
+                replaced += residency->bytesOf(textures_loaded[i].id);
+            if(residency->FixedBytes + residency->ResidentBytes - replaced > residency->Budget)
+            {
+                LOG_INFO("MODEL:: %s: the packed textures (%.1f MB) don't fit the texture budget, keeping the per-mesh ones",
+                         directory, (residency->FixedBytes - before) / 1048576.0);
+                for(int s = 0; s < PACKED_SLOTS; s++)
+                {
+                    residency->removeFixed(packer.slots[s].arrayTexture.get());
+                    residency->removeFixed(packer.slots[s].atlasTexture.get());
+                }
+                packer.release();
+                return false;
+            }
+        }
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+        {
+            if(residency)
+                residency->release(textures_loaded[i].id);
+            else
+                glDeleteTextures(1, &textures_loaded[i].id);
+        }
+        textures_loaded.clear();
+        return true;
+    }
+
+    // deletes the model's buffers and textures now instead of when the model is destroyed
+    void release()
+    {
+        meshes.clear();
+        nodes.clear();
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+        {
+            if(residency)
+                residency->release(textures_loaded[i].id);
+            else
+                glDeleteTextures(1, &textures_loaded[i].id);
+        }
+        textures_loaded.clear();
+        for(int s = 0; residency && s < PACKED_SLOTS; s++)
+        {
+            residency->removeFixed(packer.slots[s].arrayTexture.get());
+            residency->removeFixed(packer.slots[s].atlasTexture.get());
+        }
+        packer.release();
+    }
+
+    // tells the residency manager how large every texture is on screen when the model is drawn with these matrices
+    void RequestTextures(const glm::mat4 &view, const glm::mat4 &projection, const glm::mat4 &model, int viewportHeight)
+    {
+        RequestTextures(view, projection, model, viewportHeight, 0, (unsigned int)meshes.size());
+    }
+
+    // the same for count meshes from first, drawn with their node's matrix
+    void RequestTextures(const glm::mat4 &view, const glm::mat4 &projection, const glm::mat4 &model, int viewportHeight, unsigned int first, unsigned int count)
+    {
+        if(!residency || packer.Packed)
+            return;
+        glm::mat4 modelView = view * model;
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        for(unsigned int i = first; i < first + count; i++)
+        {
+            // projected diameter of the bounding sphere; from inside it the mesh can fill the screen
+            glm::vec3 center = glm::vec3(modelView * glm::vec4(meshes[i].BoundsCenter, 1.0f));
+            float radius = meshes[i].BoundsRadius * scale;
+            float distance = -center.z;
+            float pixels = distance > radius ? radius * projection[1][1] / distance * viewportHeight : (float)viewportHeight;
+            for(unsigned int j = 0; j < meshes[i].textures.size(); j++)
+                residency->request(meshes[i].textures[j].id, pixels);
+        }
+    }
+
+    // draws the model, and thus all its meshes
+    void Draw(const Shader &shader) const
+    {
+        Draw(shader, 0, (unsigned int)meshes.size());
+    }
+
+    // draws count meshes from first, the meshes of a node
+    void Draw(const Shader &shader, unsigned int first, unsigned int count) const
+    {
+        if(packer.Packed)
+        {
+            shader.setUniformBlock("DrawMaterials", PACKED_UNIFORM_BINDING);
+            packer.bind(shader, PACKED_UNIFORM_BINDING);
+            for(unsigned int i = first; i < first + count; i++)
+                meshes[i].DrawPacked(shader, i);
+            return;
+        }
+        for(unsigned int i = first; i < first + count; i++)
             meshes[i].Draw(shader);
     }
     
 private:
+    // the grayscale maps found while loading the materials, in order; packGrayMaps loads them
+    vector<string> grayMapPaths;
+
     /*  Functions   */
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
-        // read file via ASSIMP
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        // Wavefront OBJ files go through the native multi-threaded reader; Assimp reads everything else, and the OBJ
+        // files the native reader rejects
+        string extension = path.substr(path.find_last_of('.') + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if(extension == "obj" && !ModelForceAssimp && loadObj(path))
+            return;
+        // glTF buffer views are uploaded as they are
+        if((extension == "glb" || extension == "gltf") && !ModelForceAssimp && loadGltf(path))
+            return;
+
+        // read file via ASSIMP, from the resources archive when there is one (the importer owns the IO system)
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        importer.SetIOHandler(new ArchiveIOSystem());
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            LOG_ERROR("ERROR::ASSIMP:: %s", importer.GetErrorString());
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // loads an OBJ file through ObjLoader; its meshes are already deduplicated in the Vertex layout
+    bool loadObj(string const &path)
     {
-        // process each mesh located at the current node
-        for(unsigned int i = 0; i < node->mNumMeshes; i++)
+        ObjScene scene;
+        if(!ObjLoader::Load(path, scene))
+            return false;
+        vector<string> none;
+        for(unsigned int i = 0; i < scene.meshes.size(); i++)
         {
-            // the node object only contains indices to index the actual objects in the scene. 
-            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            ObjMesh &mesh = scene.meshes[i];
+            vector<Texture> textures;
+            if(mesh.material >= 0)
+            {
+                const ObjMaterial &material = scene.materials[mesh.material];
+                textures = loadMaterialTextures(material.diffuse, material.specular, material.height, material.ambient, material.opacity);
+            }
+            meshes.push_back(Mesh(std::move(mesh.vertices), std::move(mesh.indices), textures));
         }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-        for(unsigned int i = 0; i < node->mNumChildren; i++)
+        // OBJ files have no hierarchy: a single node draws every mesh
+        ModelNode root = { -1, glm::mat4(), 0, (unsigned int)meshes.size() };
+        nodes.push_back(root);
+        return true;
+    }
+
+    // loads a glTF asset through GltfFile: every primitive's buffers go to GL in one copy, and embedded images are
+    // decoded on other threads while that happens
+    bool loadGltf(string const &path)
+    {
+        GltfFile gltf;
+        if(!gltf.open(path))
+            return false;
+        vector<GltfNode> sceneNodes = gltf.sceneNodes();
+        vector<MeshBuffers> primitives;
+        vector<int> materials;
+        vector<ModelNode> loadedNodes;
+        for(unsigned int i = 0; i < sceneNodes.size(); i++)
         {
-            processNode(node->mChildren[i], scene);
+            const GltfJson &list = sceneNodes[i].Mesh >= 0 ? gltf.document["meshes"][(size_t)sceneNodes[i].Mesh]["primitives"] : GltfJson::Null();
+            ModelNode node = { sceneNodes[i].Parent, sceneNodes[i].Transform, (unsigned int)primitives.size(), (unsigned int)list.size() };
+            loadedNodes.push_back(node);
+            for(unsigned int j = 0; j < list.size(); j++)
+            {
+                MeshBuffers buffers;
+                if(!gltf.primitive(list[j], buffers))
+                {
+                    LOG_WARN("GLTF:: %s has primitives the native loader can't draw, using Assimp", path);
+                    return false;
+                }
+                primitives.push_back(buffers);
+                materials.push_back(list[j]["material"].integer());
+            }
+        }
+        if(primitives.empty())
+            return false;
+
+        // base colour and normal textures, embedded images start decoding right away
+        GltfImageDecoder decoder;
+        vector<unsigned int> embedded(gltf.document["images"].size(), 0);
+        vector< vector<Texture> > materialTextures(gltf.document["materials"].size());
+        for(unsigned int m = 0; m < materialTextures.size(); m++)
+        {
+            const GltfJson &material = gltf.document["materials"][(size_t)m];
+            const GltfJson *infos[] = { &material["pbrMetallicRoughness"]["baseColorTexture"], &material["normalTexture"] };
+            const char *types[] = { "texture_diffuse", "texture_normal" };
+            for(int k = 0; k < 2; k++)
+            {
+                int image = gltf.textureImage(*infos[k]);
+                if(image < 0 || image >= (int)embedded.size())
+                    continue;
+                const char *data;
+                size_t size;
+                Texture texture;
+                texture.type = types[k];
+                texture.channel = -1;
+                if(gltf.embeddedImage(image, data, size))
+                {
+                    if(!embedded[image])
+                        embedded[image] = decoder.add(data, size, k == 0);
+                    texture.id = embedded[image];
+                    texture.path = path + "#image" + std::to_string(image);
+                }
+                else
+                {
+                    vector<string> names(1, gltf.document["images"][(size_t)image]["uri"].text);
+                    vector<Texture> loaded = loadMaterialTextures(names, types[k]);
+                    if(loaded.empty())
+                        continue;
+                    texture = loaded[0];
+                }
+                if(std::find_if(textures_loaded.begin(), textures_loaded.end(), [&](const Texture &t) { return t.id == texture.id; }) == textures_loaded.end())
+                    textures_loaded.push_back(texture);
+                materialTextures[m].push_back(texture);
+            }
         }
 
+        for(unsigned int i = 0; i < primitives.size(); i++)
+        {
+            vector<Texture> textures;
+            if(materials[i] >= 0 && materials[i] < (int)materialTextures.size())
+                textures = materialTextures[materials[i]];
+            meshes.push_back(Mesh(primitives[i], textures));
+        }
+        nodes = loadedNodes;
+        // the embedded textures aren't files the residency manager could reload, they only count against its budget
+        vector<unsigned int> uploaded = decoder.wait();
+        for(unsigned int i = 0; residency && i < uploaded.size(); i++)
+            residency->addFixed(GL_TEXTURE_2D, uploaded[i]);
+        return true;
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
+    // The materials' textures are loaded on this thread first, in node order. Meshes that need nothing but converting
+    // (they have normals, and tangents if their material keeps a normal map) get their GL buffers sized and
+    // mapped here, and are written straight into them: no vertex array on the way, nothing for glBufferData to copy.
+    // Then every distinct aiMesh is converted in a job of its own, the other ones into vectors where their normals and
+    // tangents are generated before they are uploaded, in node order again.
+    void processNode(aiNode *root, const aiScene *scene)
     {
-        // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        vector<unsigned int> order;
+        collectMeshes(root, -1, (unsigned int)meshes.size(), order);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        // what to make of every distinct aiMesh, and the references to it that got mapped buffers
+        struct Target {
+            Vertex *vertices;
+            unsigned int *indices;
+        };
+        vector<unsigned int> pending;
+        vector<bool> tangentSpace(scene->mNumMeshes, false), copied(scene->mNumMeshes, false);
+        vector< vector<Target> > targets(scene->mNumMeshes);
+        vector<unsigned int> references(scene->mNumMeshes, 0);
+        for(unsigned int i = 0; i < order.size(); i++)
+            if(references[order[i]]++ == 0)
+                pending.push_back(order[i]);
+
+        size_t first = meshes.size();
+        meshes.resize(first + order.size());
+        vector< vector<Texture> > textures(order.size());
+        vector<bool> mapped(order.size(), false);
+        unsigned int mappedCount = 0;
+        for(unsigned int i = 0; i < order.size(); i++)
+        {
+            aiMesh *mesh = scene->mMeshes[order[i]];
+            textures[i] = processMaterial(mesh, scene);
+            // tangents only for the meshes whose material still has a normal map once the bump maps that repeat the
+            // diffuse map are left out
+            tangentSpace[order[i]] = (Mesh::FeaturesFromTextures(textures[i]) & SHADER_NORMAL_MAP) != 0;
+            size_t indexCount = AiMeshIndexCount(mesh);
+            Target target = { NULL, NULL };
+            if(mesh->mNormals && (mesh->mTangents || !tangentSpace[order[i]]) && mesh->mNumVertices > 0 && indexCount > 0)
+                meshes[first + i] = Mesh(mesh->mNumVertices, (unsigned int)indexCount, textures[i], target.vertices, target.indices);
+            mapped[i] = target.vertices != NULL;
+            if(mapped[i])
+            {
+                targets[order[i]].push_back(target);
+                mappedCount++;
+            }
+            else
+                copied[order[i]] = true;
+        }
+
+        vector<ObjMesh> converted(scene->mNumMeshes);
+        vector<glm::vec3> boundsMin(scene->mNumMeshes), boundsMax(scene->mNumMeshes);
+        Jobs.parallelFor(pending.size(), 1, [&](size_t begin, size_t end) {
+            Arena arena;
+            for(size_t j = begin; j < end; j++)
+            {
+                arena.reset();
+                size_t m = pending[j];
+                const aiMesh *mesh = scene->mMeshes[m];
+                for(unsigned int k = 0; k < targets[m].size(); k++)
+                    ConvertAiMesh(mesh, targets[m][k].vertices, targets[m][k].indices);
+                if(!targets[m].empty())
+                {
+                    glm::vec3 lo(mesh->mVertices[0].x, mesh->mVertices[0].y, mesh->mVertices[0].z), hi = lo;
+                    for(unsigned int v = 1; v < mesh->mNumVertices; v++)
+                    {
+                        glm::vec3 p(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z);
+                        lo = glm::min(lo, p);
+                        hi = glm::max(hi, p);
+                    }
+                    boundsMin[m] = lo;
+                    boundsMax[m] = hi;
+                }
+                if(!copied[m])
+                    continue;
+                ConvertAiMesh(mesh, converted[m]);
+                if(!mesh->mNormals)
+                    GenerateNormals(converted[m].vertices, converted[m].indices, ImportArena(arena));
+                if(tangentSpace[m] && (!mesh->mTangents || !mesh->mNormals))
+                    GenerateTangents(converted[m].vertices, converted[m].indices, ImportArena(arena));
+            }
+        });
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        LOG_INFO("MODEL:: %s: %u meshes converted in %.1f ms (%d threads), %u uploads written straight into mapped buffers",
+                 directory, (unsigned int)pending.size(), ms, Jobs.threads(), mappedCount);
 
-        // Walk through each of the mesh's vertices
-        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
-        {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-            // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
-            // normals
-            vector.x = mesh->mNormals[i].x;
-            vector.y = mesh->mNormals[i].y;
-            vector.z = mesh->mNormals[i].z;
-            vertex.Normal = vector;
-            // texture coordinates
-            if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+        // a mesh referenced by several nodes is uploaded for each of them, its data is moved on the last use
+        vector<unsigned int> remaining(scene->mNumMeshes, 0);
+        for(unsigned int i = 0; i < order.size(); i++)
+            if(!mapped[i])
+                remaining[order[i]]++;
+        for(unsigned int i = 0; i < order.size(); i++)
+        {
+            Mesh &target = meshes[first + i];
+            if(mapped[i])
             {
-                glm::vec2 vec;
-                // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
-                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x; 
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
+                if(target.Unmap(boundsMin[order[i]], boundsMax[order[i]]))
+                    continue;
+                LOG_WARN("MODEL:: %s: mesh %u lost its buffers while they were mapped, uploading it again", directory, order[i]);
+                ObjMesh mesh;
+                ConvertAiMesh(scene->mMeshes[order[i]], mesh);
+                target = Mesh(std::move(mesh.vertices), std::move(mesh.indices), textures[i]);
+                continue;
             }
+            ObjMesh &mesh = converted[order[i]];
+            if(--remaining[order[i]] == 0)
+                target = Mesh(std::move(mesh.vertices), std::move(mesh.indices), textures[i]);
             else
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-            // tangent
-            vector.x = mesh->mTangents[i].x;
-            vector.y = mesh->mTangents[i].y;
-            vector.z = mesh->mTangents[i].z;
-            vertex.Tangent = vector;
-            // bitangent
-            vector.x = mesh->mBitangents[i].x;
-            vector.y = mesh->mBitangents[i].y;
-            vector.z = mesh->mBitangents[i].z;
-            vertex.Bitangent = vector;
-            vertices.push_back(vertex);
-        }
-        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
-        {
-            aiFace face = mesh->mFaces[i];
-            // retrieve all indices of the face and store them in the indices vector
-            for(unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
-        }
-        // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
+                target = Mesh(mesh.vertices, mesh.indices, textures[i]);
+        }
+    }
+
+    // the scene's mesh indices in the order the nodes reference them, and the nodes with their transforms; the meshes
+    // of the model start at first
+    void collectMeshes(aiNode *node, int parent, unsigned int first, vector<unsigned int> &order)
+    {
+        ModelNode entry = { parent, AiMatrix(node->mTransformation), first + (unsigned int)order.size(), node->mNumMeshes };
+        nodes.push_back(entry);
+        parent = (int)nodes.size() - 1;
+        // the node object only contains indices to index the actual objects in the scene.
+        // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
+        for(unsigned int i = 0; i < node->mNumMeshes; i++)
+            order.push_back(node->mMeshes[i]);
+        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+        for(unsigned int i = 0; i < node->mNumChildren; i++)
+            collectMeshes(node->mChildren[i], parent, first, order);
+    }
+
+    // the textures of a mesh's material; loads them on first use, so it runs on the GL thread
+    vector<Texture> processMaterial(aiMesh *mesh, const aiScene *scene)
+    {
+        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        return loadMaterialTextures(materialTextureNames(material, aiTextureType_DIFFUSE), materialTextureNames(material, aiTextureType_SPECULAR),
+                                    materialTextureNames(material, aiTextureType_HEIGHT), materialTextureNames(material, aiTextureType_AMBIENT),
+                                    materialTextureNames(material, aiTextureType_OPACITY));
+    }
+
+    // the file names of a material's textures of one type
+    vector<string> materialTextureNames(aiMaterial *mat, aiTextureType type)
+    {
+        vector<string> names;
+        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        {
+            aiString str;
+            mat->GetTexture(type, i, &str);
+            names.push_back(str.C_Str());
+        }
+        return names;
+    }
+
+    // loads a material's textures, given the file names of each kind (Assimp's diffuse, specular, height, ambient and
+    // opacity textures), in the order the shaders expect them
+    vector<Texture> loadMaterialTextures(const vector<string> &diffuse, const vector<string> &specular, const vector<string> &normal,
+                                         const vector<string> &height, const vector<string> &alpha)
+    {
+        vector<Texture> textures;
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
         // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
         // Same applies to other texture as the following list summarizes:
@@ -150,36 +642,54 @@ private:
         // normal: texture_normalN
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+        vector<Texture> diffuseMaps = loadMaterialTextures(diffuse, "texture_diffuse");
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        // grayscale specular, reflection and alpha maps are collected here and packed into one texture's channels
+        vector<Texture> grayMaps;
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+        vector<Texture> specularMaps = loadMaterialTextures(specular, "texture_specular", &grayMaps);
         textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-        // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+        // 3. normal maps, without the bump maps that are the diffuse map
+        std::vector<Texture> normalMaps = loadMaterialTextures(NormalMapNames(diffuse, normal), "texture_normal");
         textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+        std::vector<Texture> heightMaps = loadMaterialTextures(height, "texture_height", &grayMaps);
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-        
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // 5. alpha maps
+        std::vector<Texture> alphaMaps = loadMaterialTextures(alpha, "texture_alpha", &grayMaps);
+        textures.insert(textures.end(), alphaMaps.begin(), alphaMaps.end());
+        // 6. the grayscale maps of all the above, loaded by packGrayMaps once every material is known
+        for(unsigned int i = 0; i < grayMaps.size(); i++)
+            if(std::find(grayMapPaths.begin(), grayMapPaths.end(), grayMaps[i].path) == grayMapPaths.end())
+                grayMapPaths.push_back(grayMaps[i].path);
+        textures.insert(textures.end(), grayMaps.begin(), grayMaps.end());
+        return textures;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // checks the given material textures of one type and loads the textures if they're not loaded yet.
+    // the required info is returned as a Texture struct. When grayMaps is given, grayscale maps are not loaded but
+    // appended to it with id 0, to be channel packed by packGrayMaps.
+    vector<Texture> loadMaterialTextures(const vector<string> &names, string typeName, vector<Texture> *grayMaps = NULL)
     {
         vector<Texture> textures;
-        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        for(unsigned int i = 0; i < names.size(); i++)
         {
-            aiString str;
-            mat->GetTexture(type, i, &str);
+            const char *name = names[i].c_str();
+            if(grayMaps && IsGrayscaleMap(this->directory + '/' + name))
+            {
+                Texture texture;
+                texture.id = 0;
+                texture.type = typeName;
+                texture.path = name;
+                texture.channel = -1;
+                grayMaps->push_back(texture);
+                continue;
+            }
             // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
             bool skip = false;
             for(unsigned int j = 0; j < textures_loaded.size(); j++)
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+                if(std::strcmp(textures_loaded[j].path.data(), name) == 0)
                 {
                     textures.push_back(textures_loaded[j]);
                     skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
@@ -189,54 +699,117 @@ private:
             if(!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                texture.id = TextureFromFile(name, this->directory, typeName == "texture_diffuse", residency);
                 texture.type = typeName;
-                texture.path = str.C_Str();
+                texture.path = name;
+                texture.channel = -1;
                 textures.push_back(texture);
                 textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
             }
         }
         return textures;
     }
+
+    // packs the grayscale maps of all the model's materials into the channels of shared textures: up to four maps of
+    // the same size each, in the order they were found. A map left on its own is loaded as a single channel texture.
+    // The meshes' placeholders (id 0) then get the texture and the channel their map ended up in.
+    void packGrayMaps()
+    {
+        vector<int> widths(grayMapPaths.size(), 0), heights(grayMapPaths.size(), 0);
+        for(unsigned int i = 0; i < grayMapPaths.size(); i++)
+            if(!MaterialImageInfo(directory, grayMapPaths[i], widths[i], heights[i]))
+                LOG_WARN("MODEL:: can't read the size of %s, it isn't packed", grayMapPaths[i]);
+
+        // where every map went: its texture, that texture's path and the map's channel
+        map<string, Texture> packed;
+        vector<bool> done(grayMapPaths.size(), false);
+        for(unsigned int first = 0; first < grayMapPaths.size(); first++)
+        {
+            if(done[first])
+                continue;
+            vector<unsigned int> group(1, first);
+            for(unsigned int i = first + 1; i < grayMapPaths.size() && group.size() < 4 && widths[first] > 0; i++)
+                if(!done[i] && widths[i] == widths[first] && heights[i] == heights[first])
+                    group.push_back(i);
+
+            string path = grayMapPaths[first];
+            for(unsigned int i = 1; i < group.size(); i++)
+                path += CHANNEL_PACK_SEPARATOR + grayMapPaths[group[i]];
+            unsigned int id = 0;
+            for(unsigned int j = 0; j < textures_loaded.size() && !id; j++)
+                if(textures_loaded[j].path == path)
+                    id = textures_loaded[j].id;
+            if(!id)
+            {
+                Texture texture;
+                // one source file per channel; a lone map takes a single channel instead of the file's three or four
+                texture.id = TextureFromFile(path.c_str(), this->directory, false, residency, group.size() == 1 ? 1 : 0);
+                texture.type = "texture_packed";
+                texture.path = path;
+                texture.channel = -1;
+                textures_loaded.push_back(texture);
+                id = texture.id;
+            }
+            for(unsigned int i = 0; i < group.size(); i++)
+            {
+                Texture &entry = packed[grayMapPaths[group[i]]];
+                entry.id = id;
+                entry.path = path;
+                entry.channel = group.size() == 1 ? -1 : (int)i;
+                done[group[i]] = true;
+            }
+            if(group.size() > 1)
+                LOG_DEBUG("MODEL:: packed %s", path);
+        }
+
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            for(unsigned int j = 0; j < meshes[i].textures.size(); j++)
+            {
+                Texture &texture = meshes[i].textures[j];
+                map<string, Texture>::iterator it = packed.find(texture.path);
+                if(texture.id != 0 || it == packed.end())
+                    continue;
+                texture.id = it->second.id;
+                texture.path = it->second.path;
+                texture.channel = it->second.channel;
+            }
+        grayMapPaths.clear();
+    }
 };
+static_assert(!std::is_copy_constructible<Model>::value && !std::is_copy_assignable<Model>::value, "Model must not be copyable");
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+// loads a texture with its full mip chain. gamma marks colour (sRGB) data, whose mips are filtered in linear space.
+// The chain is built on the CPU once and read back from the cache afterwards, instead of glGenerateMipmap on every run.
+// path may also list several grayscale maps separated by '|', which are loaded as the channels of one texture.
+// desiredChannels works like stbi_load's; a single channel texture reads as gray (see SetMipChainSwizzle).
+// With a residency manager the texture is loaded by it instead (see texture_residency.h).
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma, TextureResidency *residency, int desiredChannels)
 {
-    string filename = string(path);
-    filename = directory + '/' + filename;
+    if (residency)
+    {
+        unsigned int id = residency->load(directory, path, gamma, desiredChannels);
+        if (!id)
+            LOG_ERROR("Texture failed to load at path: %s", path);
+        return id;
+    }
 
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    MipChain chain;
+    if (LoadMaterialChain(directory, path, desiredChannels, gamma, chain))
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        UploadMipChain(chain);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
     }
     else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
+        LOG_ERROR("Texture failed to load at path: %s", path);
 
     return textureID;
 }
@@ -0,0 +1,709 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/archive.h>
+#include <learnopengl/cache.h>
+#include <learnopengl/mesh_codec.h>
+#include <learnopengl/tangents.h>
+#include <learnopengl/arena.h>
+#include <learnopengl/job_system.h>
+#include <learnopengl/log.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+
+// Native Wavefront OBJ/MTL reader, the fast path next to Assimp for the format most of our models use. The file
+// (usually in place in the mapped resources archive) is split at line boundaries into one chunk per job system thread,
+// the chunks are parsed in parallel, and each mesh is then deduplicated into Vertex/index arrays in a job of its own.
+// Like the Assimp import it replaces, faces are triangulated and UVs are flipped; normals are generated for meshes
+// without them, and tangents for the meshes whose material has a normal map.
+
+// Texture file names of an MTL material per kind, named by the Assimp texture type Model maps them from
+struct ObjMaterial {
+    std::string name;
+    std::vector<std::string> diffuse;  // map_Kd
+    std::vector<std::string> specular; // map_Ks
+    std::vector<std::string> height;   // map_Bump / bump (aiTextureType_HEIGHT, used as normal maps)
+    std::vector<std::string> ambient;  // map_Ka
+    std::vector<std::string> opacity;  // map_d
+};
+
+// the bump maps of a material that are tangent space normal maps. Some .mtl files (the planet's and the rock's) name
+// the diffuse map as their bump map, which is no normal map, so those are left out
+std::vector<std::string> NormalMapNames(const std::vector<std::string> &diffuse, const std::vector<std::string> &bump)
+{
+    std::vector<std::string> names;
+    for (size_t i = 0; i < bump.size(); i++)
+        if (std::find(diffuse.begin(), diffuse.end(), bump[i]) == diffuse.end())
+            names.push_back(bump[i]);
+    return names;
+}
+
+struct ObjMesh {
+    std::string name;
+    std::string materialName;
+    int material; // index into ObjScene::materials, -1 without one
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+};
+
+struct ObjScene {
+    std::vector<ObjMesh> meshes;
+    std::vector<ObjMaterial> materials;
+    std::vector<std::string> libraries; // mtllib file names, relative to the OBJ
+};
+
+// bump when the parsing or the cached layout changes
+const uint32_t OBJ_CACHE_VERSION = 2;
+
+// powers of ten exactly representable as doubles
+const double OBJ_POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16,
+                             1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+// Decimal float without strtod's locale and error handling: the digits are gathered into one integer mantissa (at most
+// 19 significant digits) and scaled once by a power of ten, so there is no per digit floating point work.
+float ObjParseFloat(const char* &p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+        p++;
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    for (; p < end && (unsigned)(*p - '0') < 10; p++)
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        }
+        else
+            exponent++;
+    if (p < end && *p == '.')
+        for (p++; p < end && (unsigned)(*p - '0') < 10; p++)
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool negativeExponent = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+'))
+            p++;
+        int e = 0;
+        for (; p < end && (unsigned)(*p - '0') < 10; p++)
+            e = std::min(e * 10 + (*p - '0'), 1000);
+        exponent += negativeExponent ? -e : e;
+    }
+    double value = (double)mantissa;
+    if (exponent < 0)
+        value = exponent >= -22 ? value / OBJ_POW10[-exponent] : value * std::pow(10.0, exponent);
+    else if (exponent > 0)
+        value = exponent <= 22 ? value * OBJ_POW10[exponent] : value * std::pow(10.0, exponent);
+    return (float)(negative ? -value : value);
+}
+
+int ObjParseInt(const char* &p, const char* end)
+{
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+        p++;
+    int value = 0;
+    for (; p < end && (unsigned)(*p - '0') < 10; p++)
+        value = value * 10 + (*p - '0');
+    return negative ? -value : value;
+}
+
+// rest of the line without surrounding blanks
+std::string ObjRestOfLine(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    const char* e = p;
+    while (e < end && *e != '\n' && *e != '\r')
+        e++;
+    while (e > p && (e[-1] == ' ' || e[-1] == '\t'))
+        e--;
+    return std::string(p, e);
+}
+
+class ObjLoader
+{
+public:
+    // Loads an OBJ file and the MTL libraries it references. Returns false, with scene left empty, for files that
+    // aren't plain polygon OBJs the fast path handles (Model then falls back to Assimp). The meshes are cached under
+    // the hash of the file with mesh_codec.h, so later loads only decode them; the MTL files are always read.
+    static bool Load(const std::string &path, ObjScene &scene, bool useCache = true)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        ResourceData file;
+        if (!ReadResource(path, file))
+            return false;
+        std::string directory = path.substr(0, path.find_last_of('/'));
+
+        std::string key = Cache::Key(Cache::Hash(file.data, file.size, Cache::Hash(&OBJ_CACHE_VERSION, sizeof(OBJ_CACHE_VERSION))), "mesh");
+        bool cached = useCache && ReadCache(key, scene);
+        int threads = 1;
+        if (!cached)
+        {
+            if (!parse(path, file, scene, threads))
+            {
+                scene = ObjScene();
+                return false;
+            }
+            if (useCache)
+                WriteCache(key, scene);
+        }
+
+        // materials, matched to the meshes by name
+        std::map<std::string, int> materialIndex;
+        for (size_t k = 0; k < scene.libraries.size(); k++)
+            loadMaterials(directory + '/' + scene.libraries[k], scene.materials, materialIndex);
+        for (size_t m = 0; m < scene.meshes.size(); m++)
+        {
+            std::map<std::string, int>::iterator it = materialIndex.find(scene.meshes[m].materialName);
+            scene.meshes[m].material = it == materialIndex.end() ? -1 : it->second;
+        }
+        // tangents depend on the materials, which aren't part of the cache entry
+        generateTangents(scene);
+
+        size_t vertices = 0;
+        for (size_t m = 0; m < scene.meshes.size(); m++)
+            vertices += scene.meshes[m].vertices.size();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (cached)
+            LOG_INFO("OBJ:: %s: %u meshes, %u vertices in %.1f ms (mesh cache)", path, (unsigned int)scene.meshes.size(), (unsigned int)vertices, ms);
+        else
+            LOG_INFO("OBJ:: %s: %u meshes, %u vertices in %.1f ms (%d threads)", path, (unsigned int)scene.meshes.size(), (unsigned int)vertices, ms, threads);
+        return true;
+    }
+
+    // Cache entry payload: the MTL libraries, then every mesh's name, material name and MeshEncode data
+    static void WriteCache(const std::string &key, const ObjScene &scene, bool compress = true)
+    {
+        std::vector<char> payload, packed;
+        EncodeScene(scene, payload);
+        MeshCodecPack(payload, compress, packed);
+        if (!Cache::Write(key, packed))
+            LOG_WARN("OBJ:: could not write mesh cache entry %s", key);
+    }
+
+    static bool ReadCache(const std::string &key, ObjScene &scene)
+    {
+        std::vector<char> packed, payload;
+        if (!Cache::Read(key, packed))
+            return false;
+        if (!MeshCodecUnpack(packed, payload) || !DecodeScene(payload, scene))
+        {
+            LOG_WARN("OBJ:: mesh cache entry %s is invalid, parsing the file", key);
+            scene = ObjScene();
+            return false;
+        }
+        return true;
+    }
+
+    static void EncodeScene(const ObjScene &scene, std::vector<char> &out)
+    {
+        writeCount(out, scene.libraries.size());
+        for (size_t i = 0; i < scene.libraries.size(); i++)
+            writeString(out, scene.libraries[i]);
+        writeCount(out, scene.meshes.size());
+        for (size_t i = 0; i < scene.meshes.size(); i++)
+        {
+            writeString(out, scene.meshes[i].name);
+            writeString(out, scene.meshes[i].materialName);
+            MeshEncode(scene.meshes[i].vertices, scene.meshes[i].indices, out);
+        }
+    }
+
+    static bool DecodeScene(const std::vector<char> &payload, ObjScene &scene, bool simd = true)
+    {
+        const char* p = payload.empty() ? NULL : &payload[0];
+        const char* end = p + payload.size();
+        uint32_t count;
+        if (!readCount(p, end, count))
+            return false;
+        scene.libraries.resize(count);
+        for (size_t i = 0; i < scene.libraries.size(); i++)
+            if (!readString(p, end, scene.libraries[i]))
+                return false;
+        if (!readCount(p, end, count))
+            return false;
+        scene.meshes.resize(count);
+        for (size_t i = 0; i < scene.meshes.size(); i++)
+            if (!readString(p, end, scene.meshes[i].name) || !readString(p, end, scene.meshes[i].materialName) ||
+                !MeshDecode(p, end, scene.meshes[i].vertices, scene.meshes[i].indices, simd))
+                return false;
+        return p == end && !scene.meshes.empty();
+    }
+
+private:
+    // parses the text into scene's meshes and library names; threads is set to the number of chunks
+    static bool parse(const std::string &path, const ResourceData &file, ObjScene &scene, int &threads)
+    {
+        // 1. split at line boundaries and parse every chunk in a job of its own
+        threads = std::max(1, std::min(Jobs.threads(), (int)(file.size / (64 * 1024)) + 1));
+        std::vector<Chunk> chunks(threads);
+        size_t begin = 0;
+        for (int i = 0; i < threads; i++)
+        {
+            size_t end = i + 1 == threads ? file.size : std::max(begin, file.size * (i + 1) / threads);
+            while (end < file.size && file.data[end - 1] != '\n')
+                end++;
+            chunks[i].begin = file.data + begin;
+            chunks[i].end = file.data + end;
+            begin = end;
+        }
+        Jobs.parallelFor(chunks.size(), 1, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                parseChunk(&chunks[i]);
+        });
+
+        // 2. global attribute arrays; relative (negative) indices become absolute using the counts of earlier chunks
+        Arena arena;
+        ArenaVector<glm::vec3> positions(ImportArena(arena)), normals(ImportArena(arena));
+        ArenaVector<glm::vec2> texCoords(ImportArena(arena));
+        size_t counts[3] = { 0, 0, 0 };
+        for (int i = 0; i < threads; i++)
+        {
+            counts[0] += chunks[i].positions.size();
+            counts[1] += chunks[i].texCoords.size();
+            counts[2] += chunks[i].normals.size();
+        }
+        positions.reserve(counts[0]);
+        texCoords.reserve(counts[1]);
+        normals.reserve(counts[2]);
+        for (int i = 0; i < threads; i++)
+        {
+            Chunk &c = chunks[i];
+            if (c.failed)
+                return false;
+            int base[3] = { (int)positions.size(), (int)texCoords.size(), (int)normals.size() };
+            for (size_t k = 0; k < c.corners.size(); k++)
+            {
+                Corner &corner = c.corners[k];
+                for (int a = 0; a < 3; a++)
+                    if (corner.relative & (1 << a))
+                        corner.index[a] += base[a];
+            }
+            positions.insert(positions.end(), c.positions.begin(), c.positions.end());
+            texCoords.insert(texCoords.end(), c.texCoords.begin(), c.texCoords.end());
+            normals.insert(normals.end(), c.normals.begin(), c.normals.end());
+        }
+
+        // 3. material libraries, resolved by Load
+        for (int i = 0; i < threads; i++)
+            scene.libraries.insert(scene.libraries.end(), chunks[i].libraries.begin(), chunks[i].libraries.end());
+
+        // 4. one mesh per object and material, in order of first use; runs carry the state over chunk boundaries
+        std::string object, material;
+        std::map<std::pair<std::string, std::string>, int> meshOf;
+        std::vector<std::vector<Range> > meshRanges;
+        for (int i = 0; i < threads; i++)
+            for (size_t r = 0; r < chunks[i].runs.size(); r++)
+            {
+                const Run &run = chunks[i].runs[r];
+                if (run.setsObject)
+                    object = run.object;
+                if (run.setsMaterial)
+                    material = run.material;
+                size_t end = r + 1 < chunks[i].runs.size() ? chunks[i].runs[r + 1].firstCorner : chunks[i].corners.size();
+                if (end == run.firstCorner)
+                    continue;
+                std::pair<std::string, std::string> key(object, material);
+                std::map<std::pair<std::string, std::string>, int>::iterator it = meshOf.find(key);
+                if (it == meshOf.end())
+                {
+                    it = meshOf.insert(std::make_pair(key, (int)scene.meshes.size())).first;
+                    ObjMesh mesh;
+                    mesh.name = object;
+                    mesh.materialName = material;
+                    mesh.material = -1;
+                    scene.meshes.push_back(mesh);
+                    meshRanges.push_back(std::vector<Range>());
+                }
+                Range range = { &chunks[i], run.firstCorner, end };
+                meshRanges[it->second].push_back(range);
+            }
+
+        // 5. deduplicate every mesh's corners into vertices, meshes in parallel
+        std::atomic<bool> valid(true);
+        Jobs.parallelFor(scene.meshes.size(), 1, [&](size_t first, size_t last) {
+            Arena meshArena;
+            for (size_t m = first; m < last && valid; m++)
+            {
+                meshArena.reset();
+                if (!buildMesh(meshRanges[m], positions, texCoords, normals, scene.meshes[m], ImportArena(meshArena)))
+                    valid = false;
+            }
+        });
+        if (!valid || scene.meshes.empty())
+        {
+            LOG_WARN("OBJ:: %s has invalid indices or no faces", path);
+            return false;
+        }
+        return true;
+    }
+
+
+    // face corner: position/uv/normal indices (0 based, -1 when absent); relative bits mark chunk local indices
+    struct Corner {
+        int index[3];
+        int relative;
+    };
+
+    // faces from firstCorner on belong to the object/material set by this statement
+    struct Run {
+        size_t firstCorner;
+        bool setsObject, setsMaterial;
+        std::string object, material;
+    };
+
+    // a chunk's arrays grow in its own arena, which the parsing thread alone allocates from
+    struct Chunk {
+        const char* begin;
+        const char* end;
+        Arena arena;
+        ArenaVector<glm::vec3> positions, normals;
+        ArenaVector<glm::vec2> texCoords;
+        ArenaVector<Corner> corners; // three per triangle
+        std::vector<Run> runs;
+        std::vector<std::string> libraries;
+        bool failed;
+
+        Chunk() : begin(NULL), end(NULL), arena(1024 * 1024), positions(ImportArena(arena)), normals(ImportArena(arena)),
+                  texCoords(ImportArena(arena)), corners(ImportArena(arena)), failed(false) {}
+    };
+
+    struct Range {
+        const Chunk* chunk;
+        size_t begin, end;
+    };
+
+    struct CornerHash {
+        size_t operator()(const uint64_t &key) const
+        {
+            return (size_t)(key ^ (key >> 29) ^ (key >> 47)) * 0x9E3779B1u;
+        }
+    };
+
+    static void parseChunk(Chunk* c)
+    {
+        // the first run inherits whatever the previous chunk ended with
+        Run first = { 0, false, false, "", "" };
+        c->runs.push_back(first);
+        std::vector<Corner> polygon;
+        for (const char* p = c->begin; p < c->end; )
+        {
+            while (p < c->end && (*p == ' ' || *p == '\t'))
+                p++;
+            const char* line = p;
+            while (p < c->end && *p != '\n')
+                p++;
+            const char* lineEnd = p++;
+            if (line == lineEnd)
+                continue;
+            const char* q = line + 1;
+            if (line[0] == 'v' && q < lineEnd && (*q == ' ' || *q == '\t'))
+            {
+                glm::vec3 v;
+                v.x = ObjParseFloat(q, lineEnd);
+                v.y = ObjParseFloat(q, lineEnd);
+                v.z = ObjParseFloat(q, lineEnd);
+                c->positions.push_back(v);
+            }
+            else if (line[0] == 'v' && q < lineEnd && *q == 't')
+            {
+                q++;
+                glm::vec2 t;
+                t.x = ObjParseFloat(q, lineEnd);
+                t.y = 1.0f - ObjParseFloat(q, lineEnd); // aiProcess_FlipUVs
+                c->texCoords.push_back(t);
+            }
+            else if (line[0] == 'v' && q < lineEnd && *q == 'n')
+            {
+                q++;
+                glm::vec3 n;
+                n.x = ObjParseFloat(q, lineEnd);
+                n.y = ObjParseFloat(q, lineEnd);
+                n.z = ObjParseFloat(q, lineEnd);
+                c->normals.push_back(n);
+            }
+            else if (line[0] == 'f' && q < lineEnd && (*q == ' ' || *q == '\t'))
+            {
+                polygon.clear();
+                for (;;)
+                {
+                    while (q < lineEnd && (*q == ' ' || *q == '\t' || *q == '\r'))
+                        q++;
+                    if (q >= lineEnd)
+                        break;
+                    Corner corner = { { -1, -1, -1 }, 0 };
+                    int counts[3] = { (int)c->positions.size(), (int)c->texCoords.size(), (int)c->normals.size() };
+                    for (int a = 0; a < 3 && q < lineEnd; a++)
+                    {
+                        if ((unsigned)(*q - '0') < 10 || *q == '-')
+                        {
+                            int value = ObjParseInt(q, lineEnd);
+                            if (value == 0)
+                            {
+                                c->failed = true;
+                                return;
+                            }
+                            if (value < 0)
+                            {
+                                corner.index[a] = counts[a] + value;
+                                corner.relative |= 1 << a;
+                            }
+                            else
+                                corner.index[a] = value - 1;
+                        }
+                        if (q < lineEnd && *q == '/')
+                            q++;
+                        else
+                            break;
+                    }
+                    if (corner.index[0] == -1 && !(corner.relative & 1))
+                    {
+                        c->failed = true;
+                        return;
+                    }
+                    polygon.push_back(corner);
+                    while (q < lineEnd && *q != ' ' && *q != '\t' && *q != '\r')
+                        q++;
+                }
+                // fan triangulation (aiProcess_Triangulate)
+                for (size_t k = 2; k < polygon.size(); k++)
+                {
+                    c->corners.push_back(polygon[0]);
+                    c->corners.push_back(polygon[k - 1]);
+                    c->corners.push_back(polygon[k]);
+                }
+            }
+            else if (lineEnd - line > 7 && std::strncmp(line, "usemtl", 6) == 0)
+            {
+                Run run = { c->corners.size(), false, true, "", ObjRestOfLine(line + 6, lineEnd) };
+                c->runs.push_back(run);
+            }
+            else if ((line[0] == 'o' || line[0] == 'g') && q < lineEnd && (*q == ' ' || *q == '\t'))
+            {
+                Run run = { c->corners.size(), true, false, ObjRestOfLine(q, lineEnd), "" };
+                c->runs.push_back(run);
+            }
+            else if (lineEnd - line > 7 && std::strncmp(line, "mtllib", 6) == 0)
+                c->libraries.push_back(ObjRestOfLine(line + 6, lineEnd));
+            // comments, smoothing groups, lines and points are ignored
+        }
+    }
+
+    static bool buildMesh(const std::vector<Range> &ranges, const ArenaVector<glm::vec3> &positions, const ArenaVector<glm::vec2> &texCoords,
+                          const ArenaVector<glm::vec3> &normals, ObjMesh &mesh, Arena* arena)
+    {
+        size_t cornerCount = 0;
+        for (size_t r = 0; r < ranges.size(); r++)
+            cornerCount += ranges[r].end - ranges[r].begin;
+        typedef std::unordered_map<uint64_t, unsigned int, CornerHash, std::equal_to<uint64_t>, ArenaAllocator<std::pair<const uint64_t, unsigned int> > > VertexMap;
+        VertexMap vertexOf(cornerCount, CornerHash(), std::equal_to<uint64_t>(), VertexMap::allocator_type(arena));
+        mesh.indices.reserve(cornerCount);
+        bool hasNormals = true;
+        // the key holds 21 bits of each attribute (texture and normal indices offset by one for "none"); when a file has
+        // more of any of them keys can collide, so every corner gets its own vertex instead of sharing a wrong one
+        bool exactKeys = positions.size() <= 0x1FFFFF && texCoords.size() < 0x1FFFFF && normals.size() < 0x1FFFFF;
+        for (size_t r = 0; r < ranges.size(); r++)
+            for (size_t k = ranges[r].begin; k < ranges[r].end; k++)
+            {
+                const Corner &corner = ranges[r].chunk->corners[k];
+                int p = corner.index[0], t = corner.index[1], n = corner.index[2];
+                if (p < 0 || p >= (int)positions.size() || t >= (int)texCoords.size() || n >= (int)normals.size() ||
+                    (t < 0 && (corner.relative & 2)) || (n < 0 && (corner.relative & 4)))
+                    return false;
+                uint64_t key = ((uint64_t)(p & 0x1FFFFF) << 42) | ((uint64_t)((t + 1) & 0x1FFFFF) << 21) | (uint64_t)((n + 1) & 0x1FFFFF);
+                std::pair<VertexMap::iterator, bool> inserted =
+                    vertexOf.insert(std::make_pair(key, (unsigned int)mesh.vertices.size()));
+                if (inserted.second || !exactKeys)
+                {
+                    Vertex vertex;
+                    vertex.Position = positions[p];
+                    vertex.TexCoords = t >= 0 ? texCoords[t] : glm::vec2(0.0f);
+                    vertex.Normal = n >= 0 ? normals[n] : glm::vec3(0.0f);
+                    vertex.Tangent = vertex.Bitangent = glm::vec3(0.0f);
+                    hasNormals = hasNormals && n >= 0;
+                    if (!inserted.second)
+                        inserted.first->second = (unsigned int)mesh.vertices.size();
+                    mesh.vertices.push_back(vertex);
+                }
+                mesh.indices.push_back(inserted.first->second);
+            }
+        if (!hasNormals)
+            GenerateNormals(mesh.vertices, mesh.indices, arena);
+        return true;
+    }
+
+    // tangents for the meshes with normal maps, meshes in parallel
+    static void generateTangents(ObjScene &scene)
+    {
+        std::vector<ObjMesh*> pending;
+        for (size_t m = 0; m < scene.meshes.size(); m++)
+        {
+            int material = scene.meshes[m].material;
+            if (material >= 0 && !NormalMapNames(scene.materials[material].diffuse, scene.materials[material].height).empty())
+                pending.push_back(&scene.meshes[m]);
+        }
+        Jobs.parallelFor(pending.size(), 1, [&](size_t begin, size_t end) {
+            Arena arena;
+            for (size_t m = begin; m < end; m++)
+            {
+                arena.reset();
+                GenerateTangents(pending[m]->vertices, pending[m]->indices, ImportArena(arena));
+            }
+        });
+    }
+
+    static void writeCount(std::vector<char> &out, size_t count)
+    {
+        uint32_t value = (uint32_t)count;
+        out.insert(out.end(), (const char*)&value, (const char*)&value + sizeof(value));
+    }
+
+    static void writeString(std::vector<char> &out, const std::string &text)
+    {
+        writeCount(out, text.size());
+        out.insert(out.end(), text.begin(), text.end());
+    }
+
+    static bool readCount(const char* &p, const char* end, uint32_t &count)
+    {
+        if ((size_t)(end - p) < sizeof(count))
+            return false;
+        std::memcpy(&count, p, sizeof(count));
+        p += sizeof(count);
+        return count <= (size_t)(end - p);
+    }
+
+    static bool readString(const char* &p, const char* end, std::string &text)
+    {
+        uint32_t size;
+        if (!readCount(p, end, size))
+            return false;
+        text.assign(p, size);
+        p += size;
+        return true;
+    }
+
+    static void loadMaterials(const std::string &path, std::vector<ObjMaterial> &materials, std::map<std::string, int> &index)
+    {
+        ResourceData file;
+        if (!ReadResource(path, file))
+        {
+            LOG_WARN("OBJ:: can't read material library %s", path);
+            return;
+        }
+        ObjMaterial* current = NULL;
+        const char* end = file.data + file.size;
+        for (const char* p = file.data; p < end; )
+        {
+            while (p < end && (*p == ' ' || *p == '\t'))
+                p++;
+            const char* line = p;
+            while (p < end && *p != '\n')
+                p++;
+            const char* lineEnd = p++;
+            std::string keyword;
+            const char* q = line;
+            while (q < lineEnd && *q != ' ' && *q != '\t' && *q != '\r')
+                q++;
+            keyword.assign(line, q);
+            if (keyword == "newmtl")
+            {
+                std::string name = ObjRestOfLine(q, lineEnd);
+                std::map<std::string, int>::iterator it = index.find(name);
+                if (it == index.end())
+                {
+                    it = index.insert(std::make_pair(name, (int)materials.size())).first;
+                    materials.push_back(ObjMaterial());
+                    materials.back().name = name;
+                }
+                current = &materials[it->second];
+                continue;
+            }
+            std::vector<std::string>* maps = !current ? NULL :
+                keyword == "map_Kd" ? &current->diffuse : keyword == "map_Ks" ? &current->specular :
+                keyword == "map_Bump" || keyword == "map_bump" || keyword == "bump" ? &current->height :
+                keyword == "map_Ka" ? &current->ambient : keyword == "map_d" ? &current->opacity : NULL;
+            if (!maps)
+                continue;
+            // options (-bm 1.0, ...) come first, the file name is last
+            std::string rest = ObjRestOfLine(q, lineEnd);
+            size_t blank = rest.find_last_of(" \t");
+            maps->push_back(blank == std::string::npos ? rest : rest.substr(blank + 1));
+        }
+    }
+};
+
+// Logs the mesh cache's compression ratio and decode speed for one model (--bench-mesh-cache). Speeds are in bytes of
+// decoded Vertex/index data per second; the LZ figure includes decompressing the entry.
+void BenchmarkMeshCache(const std::string &path)
+{
+    ObjScene scene;
+    if (!ObjLoader::Load(path, scene, false))
+    {
+        LOG_WARN("MESH_CACHE:: can't load %s", path);
+        return;
+    }
+    std::vector<char> raw;
+    for (size_t m = 0; m < scene.meshes.size(); m++)
+    {
+        const ObjMesh &mesh = scene.meshes[m];
+        if (!mesh.vertices.empty())
+            raw.insert(raw.end(), (const char*)&mesh.vertices[0], (const char*)&mesh.vertices[0] + mesh.vertices.size() * sizeof(Vertex));
+        if (!mesh.indices.empty())
+            raw.insert(raw.end(), (const char*)&mesh.indices[0], (const char*)&mesh.indices[0] + mesh.indices.size() * sizeof(unsigned int));
+    }
+    std::vector<char> payload, packed, rawCompressed;
+    ObjLoader::EncodeScene(scene, payload);
+    MeshCodecPack(payload, true, packed);
+    ArchiveCompress(&raw[0], raw.size(), rawCompressed);
+
+    // decode throughput, repeated for at least 200 ms each; the buffers are reused so allocation isn't measured
+    double speeds[3];
+    ObjScene decoded;
+    std::vector<char> unpacked;
+    for (int mode = 0; mode < 3; mode++)
+    {
+        int runs = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        double seconds = 0.0;
+        do
+        {
+            bool ok = mode == 2 ? MeshCodecUnpack(packed, unpacked) && ObjLoader::DecodeScene(unpacked, decoded)
+                                : ObjLoader::DecodeScene(payload, decoded, mode == 0);
+            if (!ok)
+            {
+                LOG_ERROR("MESH_CACHE:: %s doesn't decode", path);
+                return;
+            }
+            runs++;
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (seconds < 0.2);
+        speeds[mode] = raw.size() * (double)runs / seconds / 1e9;
+    }
+    LOG_INFO("MESH_CACHE:: %s: %.2f MB raw, %.2f MB filtered, %.2f MB with LZ (%.2fx; LZ on the raw data alone %.2fx)", path,
+             raw.size() / 1048576.0, payload.size() / 1048576.0, packed.size() / 1048576.0, (double)raw.size() / packed.size(),
+             (double)raw.size() / rawCompressed.size());
+    LOG_INFO("MESH_CACHE:: %s: decode %.2f GB/s SIMD, %.2f GB/s scalar, %.2f GB/s including LZ", path, speeds[0], speeds[1], speeds[2]);
+}
+#endif
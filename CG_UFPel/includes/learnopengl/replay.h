@@ -0,0 +1,247 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <random>
+#include <cstdint>
+
+#include <learnopengl/log.h>
+
+// Defines the input events captured between two frame boundaries besides the polled key state
+enum Replay_Event {
+    REPLAY_CURSOR = 0,
+    REPLAY_SCROLL = 1
+};
+
+// Keys read by the application through Replay::getKey. Their state is stored as one bit each per frame.
+const int REPLAY_KEYS[] = {
+    GLFW_KEY_ESCAPE, GLFW_KEY_KP_8, GLFW_KEY_KP_2, GLFW_KEY_KP_4, GLFW_KEY_KP_6,
+    GLFW_KEY_M, GLFW_KEY_C, GLFW_KEY_T, GLFW_KEY_B, GLFW_KEY_R, GLFW_KEY_P, GLFW_KEY_E, GLFW_KEY_A,
+    GLFW_KEY_1, GLFW_KEY_2, GLFW_KEY_3, GLFW_KEY_4, GLFW_KEY_5, GLFW_KEY_6, GLFW_KEY_7, GLFW_KEY_8, GLFW_KEY_9
+};
+const int REPLAY_NUM_KEYS = sizeof(REPLAY_KEYS) / sizeof(REPLAY_KEYS[0]);
+
+const uint32_t REPLAY_MAGIC   = 0x50524743; // "CGRP"
+const uint32_t REPLAY_VERSION = 1;
+
+// Records input and frame timestamps to a compact binary log and plays them back, so a session can be rerun exactly.
+//
+// The clock only advances at frame boundaries (pollEvents), so every time query inside a frame returns the same value
+// in all modes except REPLAY_OFF. Log layout: header { magic, version, seed, fixedStep } followed by one record per frame
+// { float delta, uint32 keyMask, uint16 eventCount, eventCount x { uint8 type, double x, double y } }.
+class Replay
+{
+public:
+    enum Mode { REPLAY_OFF, REPLAY_RECORD, REPLAY_PLAY };
+    typedef void (*EventCallback)(GLFWwindow* window, double x, double y);
+
+    Mode mode;
+    unsigned int Frame;
+
+    Replay() : mode(REPLAY_OFF), Frame(0), fixedStep(0.0f), lastDelta(1.0f / 60.0f), time(0.0), keyMask(0), dispatching(false), cursorCallback(NULL), scrollCallback(NULL), wallStart(0.0)
+    {
+        rng.seed(1);
+    }
+
+    // starts recording to path. A fixedStep > 0 replaces the wall clock with a fixed timestep while recording.
+    bool startRecording(const std::string &path, float step = 0.0f, uint32_t seed = 5489u)
+    {
+        file.open(path.c_str(), std::ios::binary | std::ios::out | std::ios::trunc);
+        if (!file)
+        {
+            LOG_ERROR("ERROR::REPLAY:: could not open %s for recording", path);
+            return false;
+        }
+        write(REPLAY_MAGIC);
+        write(REPLAY_VERSION);
+        write(seed);
+        write(step);
+        mode = REPLAY_RECORD;
+        fixedStep = step;
+        rng.seed(seed);
+        // both modes start the clock at zero so the float timestamps main.cpp keeps round the same way
+        time = 0.0;
+        lastWall = glfwGetTime();
+        wallStart = lastWall;
+        return true;
+    }
+
+    // starts playing path back. A fixedStep > 0 overrides the recorded timestamps with a fixed timestep.
+    bool startPlayback(const std::string &path, float step = 0.0f)
+    {
+        file.open(path.c_str(), std::ios::binary | std::ios::in);
+        uint32_t magic = 0, version = 0, seed = 0;
+        float recordedStep = 0.0f;
+        if (!file || !read(magic) || !read(version) || !read(seed) || !read(recordedStep) || magic != REPLAY_MAGIC || version != REPLAY_VERSION)
+        {
+            LOG_ERROR("ERROR::REPLAY:: %s is not a valid replay log", path);
+            return false;
+        }
+        mode = REPLAY_PLAY;
+        fixedStep = step;
+        rng.seed(seed);
+        time = 0.0;
+        wallStart = glfwGetTime();
+        return true;
+    }
+
+    // registers the handlers that recorded cursor/scroll events are fed back into during playback
+    void setCallbacks(EventCallback cursor, EventCallback scroll)
+    {
+        cursorCallback = cursor;
+        scrollCallback = scroll;
+    }
+
+    // replaces glfwGetTime
+    double getTime() const
+    {
+        return mode == REPLAY_OFF ? glfwGetTime() : time;
+    }
+
+    // replaces glfwGetKey for the keys listed in REPLAY_KEYS
+    int getKey(GLFWwindow* window, int key) const
+    {
+        if (mode != REPLAY_PLAY)
+            return glfwGetKey(window, key);
+        int bit = keyBit(key);
+        return (bit >= 0 && (keyMask & (1u << bit))) ? GLFW_PRESS : GLFW_RELEASE;
+    }
+
+    // replaces rand(); seeded from the log so playback draws the same sequence
+    unsigned int random()
+    {
+        return (unsigned int)rng();
+    }
+
+    // called at the top of the GLFW cursor/scroll callbacks. Returns false when the live event must be ignored because a
+    // log is being played back; while recording the event is stored for the current frame.
+    bool acceptEvent(Replay_Event type, double x, double y)
+    {
+        if (mode == REPLAY_PLAY)
+            return dispatching;
+        if (mode == REPLAY_RECORD)
+        {
+            Event e;
+            e.type = (unsigned char)type;
+            e.x = x;
+            e.y = y;
+            events.push_back(e);
+        }
+        return true;
+    }
+
+    // replaces glfwPollEvents and marks a frame boundary
+    void pollEvents(GLFWwindow* window)
+    {
+        glfwPollEvents();
+        Frame++;
+        if (mode == REPLAY_RECORD)
+            recordFrame(window);
+        else if (mode == REPLAY_PLAY)
+            playFrame(window);
+    }
+
+    // flushes the log and reports how long the session took in wall-clock time
+    void close()
+    {
+        if (mode == REPLAY_OFF)
+            return;
+        LOG_INFO("%s %u frames in %.3f s (wall)", mode == REPLAY_RECORD ? "REPLAY::RECORDED" : "REPLAY::PLAYED", Frame, glfwGetTime() - wallStart);
+        file.close();
+        mode = REPLAY_OFF;
+    }
+
+private:
+    // positions are kept in double precision so the callbacks see exactly the values GLFW reported
+    struct Event {
+        unsigned char type;
+        double x, y;
+    };
+
+    std::fstream file;
+    float fixedStep;
+    float lastDelta;
+    double time;
+    double lastWall;
+    uint32_t keyMask;
+    std::vector<Event> events;
+    bool dispatching;
+    EventCallback cursorCallback;
+    EventCallback scrollCallback;
+    std::mt19937 rng;
+    double wallStart;
+
+    static int keyBit(int key)
+    {
+        for (int i = 0; i < REPLAY_NUM_KEYS; i++)
+            if (REPLAY_KEYS[i] == key)
+                return i;
+        return -1;
+    }
+
+    template <typename T> void write(const T &value) { file.write((const char*)&value, sizeof(T)); }
+    template <typename T> bool read(T &value) { return (bool)file.read((char*)&value, sizeof(T)); }
+
+    void recordFrame(GLFWwindow* window)
+    {
+        // the delta is stored as a float, so the recorded clock is advanced by the same rounded value playback will use
+        float delta = fixedStep;
+        if (fixedStep <= 0.0f)
+        {
+            double now = glfwGetTime();
+            delta = (float)(now - lastWall);
+            lastWall = now;
+        }
+        time += delta;
+
+        uint32_t mask = 0;
+        for (int i = 0; i < REPLAY_NUM_KEYS; i++)
+            if (glfwGetKey(window, REPLAY_KEYS[i]) == GLFW_PRESS)
+                mask |= 1u << i;
+
+        write(delta);
+        write(mask);
+        write((uint16_t)events.size());
+        for (size_t i = 0; i < events.size(); i++)
+        {
+            write(events[i].type);
+            write(events[i].x);
+            write(events[i].y);
+        }
+        events.clear();
+    }
+
+    void playFrame(GLFWwindow* window)
+    {
+        float delta;
+        uint16_t count;
+        if (!read(delta) || !read(keyMask) || !read(count))
+        {
+            // log exhausted: end the session like pressing escape would. The clock keeps running so an animation
+            // that is still in progress can finish its loop.
+            keyMask = 0;
+            time += fixedStep > 0.0f ? fixedStep : lastDelta;
+            glfwSetWindowShouldClose(window, true);
+            return;
+        }
+        lastDelta = delta;
+        time += fixedStep > 0.0f ? fixedStep : delta;
+
+        dispatching = true;
+        for (uint16_t i = 0; i < count; i++)
+        {
+            Event e;
+            if (!read(e.type) || !read(e.x) || !read(e.y))
+                break;
+            EventCallback callback = e.type == REPLAY_CURSOR ? cursorCallback : scrollCallback;
+            if (callback)
+                callback(window, e.x, e.y);
+        }
+        dispatching = false;
+    }
+};
+#endif
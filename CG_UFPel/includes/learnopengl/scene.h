@@ -0,0 +1,643 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_access.hpp>
+
+#include <learnopengl/camera.h>
+#include <learnopengl/model.h>
+#include <learnopengl/job_system.h>
+#include <learnopengl/log.h>
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Entity/component storage for the scene. An entity is only a handle; its data lives in one array per component
+// (transforms, the model it draws, bounds, cameras), packed with no holes, so a system that updates one kind of
+// component walks contiguous memory whatever else the entities have. Removing a component moves the last one into
+// its place, and a sparse table maps entity indices to slots. Handles carry a generation, so a handle kept after its
+// entity was destroyed doesn't find the entity that reuses the index. Transforms form a hierarchy, so a model is an
+// entity per node of its file under the entity that places the model.
+
+struct Entity {
+    uint32_t Index;
+    uint32_t Generation;
+};
+
+inline bool operator==(const Entity &a, const Entity &b) { return a.Index == b.Index && a.Generation == b.Generation; }
+inline bool operator!=(const Entity &a, const Entity &b) { return !(a == b); }
+
+const Entity NoEntity = { 0xffffffffu, 0 };
+
+// the slot of an entity without the component
+const uint32_t NoSlot = 0xffffffffu;
+
+// the slots of the entities that have a component
+class SparseSet
+{
+public:
+    bool has(Entity e) const
+    {
+        return e.Index < sparse.size() && sparse[e.Index] != NoSlot && entities[sparse[e.Index]] == e;
+    }
+
+    uint32_t slot(Entity e) const
+    {
+        return has(e) ? sparse[e.Index] : NoSlot;
+    }
+
+    size_t size() const
+    {
+        return entities.size();
+    }
+
+    Entity entity(size_t slot) const
+    {
+        return entities[slot];
+    }
+
+    // the entity in the slot after e's, wrapping around; the first one when e has no component here
+    Entity next(Entity e) const
+    {
+        if (entities.empty())
+            return NoEntity;
+        uint32_t s = slot(e);
+        return entities[s == NoSlot ? 0 : (s + 1) % entities.size()];
+    }
+
+protected:
+    std::vector<uint32_t> sparse;
+    std::vector<Entity> entities;
+
+    uint32_t insert(Entity e)
+    {
+        if (e.Index >= sparse.size())
+            sparse.resize(e.Index + 1, NoSlot);
+        sparse[e.Index] = (uint32_t)entities.size();
+        entities.push_back(e);
+        return sparse[e.Index];
+    }
+
+    // moves the last entity into e's slot and returns that slot, where the caller moves the last component too
+    uint32_t erase(Entity e)
+    {
+        uint32_t s = slot(e);
+        if (s == NoSlot)
+            return NoSlot;
+        Entity last = entities.back();
+        entities[s] = last;
+        sparse[last.Index] = s;
+        entities.pop_back();
+        sparse[e.Index] = NoSlot;
+        return s;
+    }
+};
+
+template <class T>
+class ComponentPool : public SparseSet
+{
+public:
+    T &add(Entity e, const T &value = T())
+    {
+        uint32_t s = slot(e);
+        if (s != NoSlot)
+            return data[s] = value;
+        insert(e);
+        data.push_back(value);
+        return data.back();
+    }
+
+    void remove(Entity e)
+    {
+        uint32_t s = erase(e);
+        if (s == NoSlot)
+            return;
+        data[s] = data.back();
+        data.pop_back();
+    }
+
+    // e must have the component
+    T &get(Entity e)
+    {
+        return data[sparse[e.Index]];
+    }
+
+    T *find(Entity e)
+    {
+        uint32_t s = slot(e);
+        return s == NoSlot ? NULL : &data[s];
+    }
+
+    T &at(size_t slot)
+    {
+        return data[slot];
+    }
+
+private:
+    std::vector<T> data;
+};
+
+// Position, rotation and scale, each in an array of its own, the parent, and the world matrix the transform system
+// makes of them: the parent's world matrix * translate * rotate * scale. The arrays are kept in depth-first order, so
+// a parent comes before its children and every subtree is a run of consecutive slots. Changing a transform marks it
+// dirty, and the update recomputes the subtrees under the dirty transforms and nothing else: what doesn't move costs
+// nothing. A child added right after its parent's subtree (a model's nodes after the model) keeps the order; other
+// changes to the hierarchy sort the arrays again on the next update.
+class TransformPool : public SparseSet
+{
+public:
+    TransformPool() : reorder(false) {}
+
+    void add(Entity e, const glm::vec3 &position, const glm::quat &rotation = glm::quat(), const glm::vec3 &scale = glm::vec3(1.0f), Entity parent = NoEntity)
+    {
+        uint32_t s = slot(e);
+        if (s != NoSlot)
+        {
+            positions[s] = position;
+            rotations[s] = rotation;
+            scales[s] = scale;
+            markDirty(s);
+            if (parents[s] != parent)
+                setParent(e, parent);
+            return;
+        }
+        uint32_t p = slot(parent);
+        s = insert(e);
+        positions.push_back(position);
+        rotations.push_back(rotation);
+        scales.push_back(scale);
+        worlds.push_back(glm::mat4());
+        parents.push_back(p == NoSlot ? NoEntity : parent);
+        parentSlots.push_back(p);
+        subtreeSizes.push_back(1);
+        dirty.push_back(0);
+        markDirty(s);
+        // the parent's subtree, and with it its ancestors', ended at the new slot: they grow by one
+        if (reorder || (p != NoSlot && p + subtreeSizes[p] != s))
+            reorder = true;
+        else
+            for (uint32_t a = p; a != NoSlot; a = parentSlots[a])
+                subtreeSizes[a]++;
+    }
+
+    // the children of a removed transform become roots
+    void remove(Entity e)
+    {
+        uint32_t s = erase(e);
+        if (s == NoSlot)
+            return;
+        positions[s] = positions.back();
+        rotations[s] = rotations.back();
+        scales[s] = scales.back();
+        worlds[s] = worlds.back();
+        parents[s] = parents.back();
+        dirty[s] = dirty.back();
+        positions.pop_back();
+        rotations.pop_back();
+        scales.pop_back();
+        worlds.pop_back();
+        parents.pop_back();
+        parentSlots.pop_back();
+        subtreeSizes.pop_back();
+        dirty.pop_back();
+        reorder = true;
+    }
+
+    // false when parent is e or one of its descendants
+    bool setParent(Entity e, Entity parent)
+    {
+        uint32_t s = slot(e);
+        if (s == NoSlot)
+            return false;
+        for (uint32_t a = slot(parent); a != NoSlot; a = slot(parents[a]))
+            if (entities[a] == e)
+            {
+                LOG_WARN("SCENE:: entity %u can't be a child of its own descendant %u", e.Index, parent.Index);
+                return false;
+            }
+        parents[s] = has(parent) ? parent : NoEntity;
+        markDirty(s);
+        reorder = true;
+        return true;
+    }
+
+    // e must have a transform
+    const glm::vec3 &position(Entity e) const { return positions[sparse[e.Index]]; }
+    const glm::quat &rotation(Entity e) const { return rotations[sparse[e.Index]]; }
+    const glm::vec3 &scale(Entity e) const { return scales[sparse[e.Index]]; }
+    Entity parent(Entity e) const { return parents[sparse[e.Index]]; }
+    // as of the last update
+    const glm::mat4 &world(Entity e) const { return worlds[sparse[e.Index]]; }
+    const glm::mat4 &worldAt(size_t slot) const { return worlds[slot]; }
+
+    void setPosition(Entity e, const glm::vec3 &position) { positions[sparse[e.Index]] = position; markDirty(sparse[e.Index]); }
+    void setRotation(Entity e, const glm::quat &rotation) { rotations[sparse[e.Index]] = rotation; markDirty(sparse[e.Index]); }
+    void setScale(Entity e, const glm::vec3 &scale) { scales[sparse[e.Index]] = scale; markDirty(sparse[e.Index]); }
+    // the world matrices of e and its descendants are made again on the next update
+    void touch(Entity e) { markDirty(sparse[e.Index]); }
+
+    // e's descendants, parents before their children (sorting the transforms first if anything was removed or moved
+    // in the hierarchy since the last sort)
+    void descendants(Entity e, std::vector<Entity> &out)
+    {
+        if (reorder)
+            sort();
+        uint32_t s = slot(e);
+        if (s == NoSlot)
+            return;
+        out.insert(out.end(), entities.begin() + s + 1, entities.begin() + s + subtreeSizes[s]);
+    }
+
+    // the transform system: makes the world matrices of the dirty subtrees again, each subtree in a job of its own.
+    // Returns false, having done nothing, when no transform changed since the last update.
+    bool update()
+    {
+        if (reorder)
+            sort();
+        updated.clear();
+        if (dirtySlots.empty())
+            return false;
+        // a dirty transform inside a dirty subtree is updated with it
+        std::sort(dirtySlots.begin(), dirtySlots.end());
+        for (size_t i = 0; i < dirtySlots.size(); i++)
+        {
+            uint32_t s = dirtySlots[i];
+            dirty[s] = 0;
+            if (updated.empty() || s >= updated.back().second)
+                updated.push_back(std::make_pair(s, s + subtreeSizes[s]));
+        }
+        dirtySlots.clear();
+        Jobs.parallelFor(updated.size(), 1, [this](size_t first, size_t last) {
+            for (size_t r = first; r < last; r++)
+                for (uint32_t i = updated[r].first; i < updated[r].second; i++)
+                {
+                    glm::mat3 rotation = glm::mat3_cast(rotations[i]);
+                    glm::mat4 local(glm::vec4(rotation[0] * scales[i].x, 0.0f), glm::vec4(rotation[1] * scales[i].y, 0.0f),
+                                    glm::vec4(rotation[2] * scales[i].z, 0.0f), glm::vec4(positions[i], 1.0f));
+                    worlds[i] = parentSlots[i] == NoSlot ? local : worlds[parentSlots[i]] * local;
+                }
+        });
+        return true;
+    }
+
+    // the slots [first, second) whose world matrices the last update made
+    const std::vector<std::pair<uint32_t, uint32_t> > &updatedRanges() const
+    {
+        return updated;
+    }
+
+private:
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> worlds;
+    std::vector<Entity> parents;
+    // valid while the order is
+    std::vector<uint32_t> parentSlots;
+    std::vector<uint32_t> subtreeSizes;
+    std::vector<unsigned char> dirty;
+    std::vector<uint32_t> dirtySlots;
+    std::vector<std::pair<uint32_t, uint32_t> > updated;
+    bool reorder;
+
+    void markDirty(uint32_t s)
+    {
+        if (dirty[s])
+            return;
+        dirty[s] = 1;
+        dirtySlots.push_back(s);
+    }
+
+    template <class T>
+    static void Permute(std::vector<T> &values, const std::vector<uint32_t> &order)
+    {
+        std::vector<T> sorted(order.size());
+        for (size_t i = 0; i < order.size(); i++)
+            sorted[i] = values[order[i]];
+        values.swap(sorted);
+    }
+
+    // puts the arrays back in depth-first order, the roots in the order they are in now
+    void sort()
+    {
+        size_t n = entities.size();
+        std::vector<uint32_t> parentOf(n);
+        std::vector<uint32_t> firstChild(n + 1, 0), children(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            parentOf[i] = slot(parents[i]);
+            // the parent was removed
+            if (parentOf[i] == NoSlot && parents[i] != NoEntity)
+            {
+                parents[i] = NoEntity;
+                dirty[i] = 1;
+            }
+            if (parentOf[i] != NoSlot)
+                firstChild[parentOf[i] + 1]++;
+        }
+        for (size_t i = 0; i < n; i++)
+            firstChild[i + 1] += firstChild[i];
+        std::vector<uint32_t> next(firstChild.begin(), firstChild.end() - 1);
+        for (size_t i = 0; i < n; i++)
+            if (parentOf[i] != NoSlot)
+                children[next[parentOf[i]]++] = (uint32_t)i;
+
+        std::vector<uint32_t> order, stack;
+        order.reserve(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            if (parentOf[i] != NoSlot)
+                continue;
+            stack.push_back((uint32_t)i);
+            while (!stack.empty())
+            {
+                uint32_t u = stack.back();
+                stack.pop_back();
+                order.push_back(u);
+                for (uint32_t k = firstChild[u + 1]; k-- > firstChild[u];)
+                    stack.push_back(children[k]);
+            }
+        }
+
+        std::vector<uint32_t> newSlot(n);
+        for (size_t i = 0; i < n; i++)
+            newSlot[order[i]] = (uint32_t)i;
+        Permute(positions, order);
+        Permute(rotations, order);
+        Permute(scales, order);
+        Permute(worlds, order);
+        Permute(parents, order);
+        Permute(entities, order);
+        Permute(dirty, order);
+        dirtySlots.clear();
+        for (size_t i = 0; i < n; i++)
+        {
+            sparse[entities[i].Index] = (uint32_t)i;
+            uint32_t p = parentOf[order[i]];
+            parentSlots[i] = p == NoSlot ? NoSlot : newSlot[p];
+            subtreeSizes[i] = 1;
+            if (dirty[i])
+                dirtySlots.push_back((uint32_t)i);
+        }
+        for (size_t i = n; i-- > 0;)
+            if (parentSlots[i] != NoSlot)
+                subtreeSizes[parentSlots[i]] += subtreeSizes[i];
+        reorder = false;
+    }
+};
+
+// splits a matrix without shear or perspective into translation, rotation and scale; a mirroring goes to the x scale
+inline void DecomposeTransform(const glm::mat4 &m, glm::vec3 &position, glm::quat &rotation, glm::vec3 &scale)
+{
+    position = glm::vec3(m[3]);
+    glm::mat3 axes(m);
+    scale = glm::vec3(glm::length(axes[0]), glm::length(axes[1]), glm::length(axes[2]));
+    if (glm::determinant(axes) < 0.0f)
+        scale.x = -scale.x;
+    for (int i = 0; i < 3; i++)
+        if (scale[i] != 0.0f)
+            axes[i] /= scale[i];
+    rotation = glm::normalize(glm::quat_cast(axes));
+}
+
+// what an entity draws: count meshes of a model from first, the meshes of one of its nodes
+struct RenderMesh {
+    Model *Asset;
+    unsigned int FirstMesh;
+    unsigned int MeshCount;
+
+    RenderMesh(Model *asset = NULL, unsigned int first = 0, unsigned int count = 0) : Asset(asset), FirstMesh(first), MeshCount(count) {}
+};
+
+// a bounding sphere in the model's space and, after the scene's update, in the world
+struct BoundingSphere {
+    glm::vec3 LocalCenter;
+    float LocalRadius;
+    glm::vec3 Center;
+    float Radius;
+
+    BoundingSphere(const glm::vec3 &center = glm::vec3(0.0f), float radius = 0.0f) : LocalCenter(center), LocalRadius(radius), Center(center), Radius(radius) {}
+};
+
+// the six planes of a view-projection matrix, for testing bounding spheres against the view
+struct Frustum {
+    glm::vec4 Planes[6];
+
+    explicit Frustum(const glm::mat4 &viewProjection)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            Planes[2 * i] = glm::row(viewProjection, 3) + glm::row(viewProjection, i);
+            Planes[2 * i + 1] = glm::row(viewProjection, 3) - glm::row(viewProjection, i);
+        }
+        for (int i = 0; i < 6; i++)
+            Planes[i] /= glm::length(glm::vec3(Planes[i]));
+    }
+
+    bool intersects(const glm::vec3 &center, float radius) const
+    {
+        for (int i = 0; i < 6; i++)
+            if (glm::dot(glm::vec3(Planes[i]), center) + Planes[i].w < -radius)
+                return false;
+        return true;
+    }
+};
+
+class Scene
+{
+public:
+    TransformPool Transforms;
+    ComponentPool<RenderMesh> Renders;
+    ComponentPool<BoundingSphere> Bounds;
+    ComponentPool<Camera> Cameras;
+
+    Entity create()
+    {
+        Entity e;
+        if (!freeIndices.empty())
+        {
+            e.Index = freeIndices.back();
+            freeIndices.pop_back();
+        }
+        else
+        {
+            e.Index = (uint32_t)generations.size();
+            generations.push_back(0);
+        }
+        e.Generation = generations[e.Index];
+        return e;
+    }
+
+    // removes the entity's components; its handles stop being valid. Its children become roots.
+    void destroy(Entity e)
+    {
+        if (!alive(e))
+            return;
+        Transforms.remove(e);
+        Renders.remove(e);
+        Bounds.remove(e);
+        Cameras.remove(e);
+        generations[e.Index]++;
+        freeIndices.push_back(e.Index);
+    }
+
+    bool alive(Entity e) const
+    {
+        return e.Index < generations.size() && generations[e.Index] == e.Generation;
+    }
+
+    size_t count() const
+    {
+        return generations.size() - freeIndices.size();
+    }
+
+    // destroys the entities below e in the hierarchy
+    void destroyDescendants(Entity e)
+    {
+        std::vector<Entity> below;
+        Transforms.descendants(e, below);
+        for (size_t i = 0; i < below.size(); i++)
+            destroy(below[i]);
+    }
+
+    // gives the entity a bounding sphere in its own space; the world one follows on the next update
+    void setBounds(Entity e, const glm::vec3 &center, float radius)
+    {
+        Bounds.add(e, BoundingSphere(center, radius));
+        if (Transforms.has(e))
+            Transforms.touch(e);
+    }
+
+    // makes an entity for every node of the model under parent, with the node's transform, and the meshes and bounds
+    // of the node when it has meshes
+    void instantiate(Model *model, Entity parent)
+    {
+        std::vector<Entity> nodes(model->nodes.size());
+        for (size_t i = 0; i < model->nodes.size(); i++)
+        {
+            const ModelNode &node = model->nodes[i];
+            nodes[i] = create();
+            glm::vec3 position, scale;
+            glm::quat rotation;
+            DecomposeTransform(node.Transform, position, rotation, scale);
+            Transforms.add(nodes[i], position, rotation, scale, node.Parent < 0 ? parent : nodes[node.Parent]);
+            if (node.MeshCount == 0)
+                continue;
+            Renders.add(nodes[i], RenderMesh(model, node.FirstMesh, node.MeshCount));
+            glm::vec3 center;
+            float radius;
+            model->BoundingSphere(node.FirstMesh, node.MeshCount, center, radius);
+            setBounds(nodes[i], center, radius);
+        }
+    }
+
+    // runs the systems that derive data: world matrices, then the world bounds of what moved
+    void update()
+    {
+        if (!Transforms.update())
+            return;
+        const std::vector<std::pair<uint32_t, uint32_t> > &ranges = Transforms.updatedRanges();
+        Jobs.parallelFor(ranges.size(), 1, [this, &ranges](size_t first, size_t last) {
+            for (size_t r = first; r < last; r++)
+                for (uint32_t i = ranges[r].first; i < ranges[r].second; i++)
+                {
+                    BoundingSphere *b = Bounds.find(Transforms.entity(i));
+                    if (!b)
+                        continue;
+                    const glm::mat4 &world = Transforms.worldAt(i);
+                    b->Center = glm::vec3(world * glm::vec4(b->LocalCenter, 1.0f));
+                    b->Radius = b->LocalRadius * glm::max(glm::length(glm::vec3(world[0])), glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+                }
+        });
+    }
+
+private:
+    std::vector<uint32_t> generations;
+    std::vector<uint32_t> freeIndices;
+};
+
+// Logs what the scene's systems cost with count entities (--bench-scene): groups of a root and nine children with
+// bounds, updated with every root moving, with one in a hundred moving and with nothing moving, at least 200 ms each.
+// Then every other group is destroyed and made again, and the handles of the others must still find their data.
+void BenchmarkScene(size_t count)
+{
+    const size_t groupSize = 10;
+    Scene scene;
+    std::vector<Entity> roots, children;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    for (size_t i = 0; i < count; i += groupSize)
+    {
+        positions.push_back(glm::vec3((float)(i % 1000), (float)(i / 1000 % 1000), (float)(i / 1000000)));
+        rotations.push_back(glm::angleAxis((float)i, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+    roots.resize(positions.size());
+    children.resize(positions.size() * (groupSize - 1), NoEntity);
+    // a root and then its children, which keeps the transforms in order
+    auto makeGroup = [&](size_t g) {
+        roots[g] = scene.create();
+        scene.Transforms.add(roots[g], positions[g], rotations[g]);
+        for (size_t k = 1; k < groupSize && g * groupSize + k < count; k++)
+        {
+            Entity child = scene.create();
+            scene.Transforms.add(child, glm::vec3((float)k, 0.0f, 0.0f), glm::quat(), glm::vec3(0.05f), roots[g]);
+            scene.setBounds(child, glm::vec3(0.0f), 1.0f);
+            children[g * (groupSize - 1) + k - 1] = child;
+        }
+    };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t g = 0; g < roots.size(); g++)
+        makeGroup(g);
+    scene.update();
+    double created = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // the milliseconds of a frame in which every step-th root moves (none for 0)
+    auto frame = [&](size_t step) -> double {
+        int runs = 0;
+        double seconds = 0.0;
+        std::chrono::steady_clock::time_point first = std::chrono::steady_clock::now();
+        do
+        {
+            for (size_t g = 0; step > 0 && g < roots.size(); g += step)
+                scene.Transforms.touch(roots[g]);
+            scene.update();
+            runs++;
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - first).count();
+        } while (seconds < 0.2);
+        return seconds * 1000.0 / runs;
+    };
+    double all = frame(1), some = frame(100), none = frame(0);
+
+    // collected before destroying any, a destroy reorders the transforms and descendants() would sort them every time
+    std::vector<Entity> destroyed;
+    for (size_t g = 0; g < roots.size(); g += 2)
+    {
+        destroyed.push_back(roots[g]);
+        scene.Transforms.descendants(roots[g], destroyed);
+    }
+    for (size_t i = 0; i < destroyed.size(); i++)
+        scene.destroy(destroyed[i]);
+    for (size_t g = 0; g < roots.size(); g += 2)
+        makeGroup(g);
+    scene.update();
+    size_t wrong = 0;
+    for (size_t i = 0; i < destroyed.size(); i++)
+        wrong += scene.alive(destroyed[i]);
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        if (children[i] == NoEntity)
+            continue;
+        size_t g = i / (groupSize - 1);
+        glm::vec3 expected = positions[g] + rotations[g] * glm::vec3((float)(i % (groupSize - 1) + 1), 0.0f, 0.0f);
+        if (glm::length(glm::vec3(scene.Transforms.world(children[i])[3]) - expected) > 1e-3f || glm::length(scene.Bounds.get(children[i]).Center - expected) > 1e-3f)
+            wrong++;
+    }
+    LOG_INFO("SCENE:: %zu entities in %zu hierarchies: created in %.1f ms; update with all moving %.2f ms, 1%% moving %.3f ms, none moving %.4f ms (%d threads); %zu wrong after churn",
+             scene.count(), roots.size(), created, all, some, none, Jobs.threads(), wrong);
+}
+#endif
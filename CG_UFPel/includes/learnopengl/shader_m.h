@@ -4,143 +4,551 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <learnopengl/log.h>
+#include <learnopengl/cache.h>
+#include <learnopengl/archive.h>
+#include <learnopengl/gl_handle.h>
+
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+// Optional features a shader variant can be compiled with. Each set bit is injected as a #define right after the
+// #version line, so a variant only contains the code paths its material actually needs.
+enum Shader_Feature {
+    SHADER_DIFFUSE_MAP  = 1 << 0,
+    SHADER_SPECULAR_MAP = 1 << 1,
+    SHADER_NORMAL_MAP   = 1 << 2,
+    SHADER_HEIGHT_MAP   = 1 << 3,
+    // textures come from the model's packed arrays/atlases instead of per-mesh bindings (see texture_packer.h)
+    SHADER_TEXTURE_ARRAYS = 1 << 4,
+    // image based lighting from the environment maps (see ibl.h)
+    SHADER_IBL = 1 << 5
+};
+const char* const SHADER_FEATURE_DEFINES[] = { "HAS_DIFFUSE_MAP", "HAS_SPECULAR_MAP", "HAS_NORMAL_MAP", "HAS_HEIGHT_MAP", "HAS_TEXTURE_ARRAYS", "HAS_IBL" };
+const int SHADER_NUM_FEATURES = 6;
+// variant key of the program built from the sources exactly as written
+const unsigned int SHADER_BASE = 0xFFFFFFFFu;
+
+// Last value set for a uniform, kept so it can be applied to variants that were bound after it was set
+struct ShaderUniform {
+    GLenum type;
+    unsigned int version;
+    union {
+        int i;
+        float f[16];
+    };
+};
+
+struct ShaderVariant {
+    GLProgram program;
+    unsigned int appliedVersion;
+    std::map<std::string, int> locations;
+};
+
+// A Shader's sources, compiled variants and uniform values, behind a pointer so const methods can build variants
+struct ShaderState {
+    std::string vertexCode;
+    std::string fragmentCode;
+    std::map<unsigned int, ShaderVariant> variants;
+    // feature bits the sources actually test; the others would only produce duplicate programs
+    unsigned int usedFeatures;
+    // feature bits added to every variant request (scene-wide features such as lighting)
+    unsigned int globalFeatures;
+    ShaderVariant* current;
+    unsigned int version;
+    std::map<std::string, ShaderUniform> uniforms;
+    std::map<std::string, unsigned int> blockBindings;
+
+    ShaderState() : usedFeatures(0), globalFeatures(0), current(NULL), version(0) {}
+};
 
 class Shader
 {
 public:
     unsigned int ID;
+    // whether the program came from the binary cache, and how long building it took (cold vs. warm setup time)
+    bool FromCache;
+    double SetupMs;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath)
+    Shader(const char* vertexPath, const char* fragmentPath) : state(new ShaderState())
     {
-        // 1. retrieve the vertex/fragment source code from filePath
+        // 1. retrieve the vertex/fragment source code from filePath (from the resources archive when there is one)
         std::string vertexCode;
         std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
+        ResourceData vShaderFile, fShaderFile;
+        if (ReadResource(vertexPath, vShaderFile) && ReadResource(fragmentPath, fShaderFile))
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
+            vertexCode.assign(vShaderFile.data, vShaderFile.size);
+            fragmentCode.assign(fShaderFile.data, fShaderFile.size);
         }
-        catch (std::ifstream::failure e)
+        else
+            LOG_ERROR("ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ");
+        state->vertexCode = vertexCode;
+        state->fragmentCode = fragmentCode;
+        for (int i = 0; i < SHADER_NUM_FEATURES; i++)
+            if (vertexCode.find(SHADER_FEATURE_DEFINES[i]) != std::string::npos || fragmentCode.find(SHADER_FEATURE_DEFINES[i]) != std::string::npos)
+                state->usedFeatures |= 1u << i;
+        // 2. build the program, from the binary cache when possible
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        ID = build(vertexCode, fragmentCode, FromCache);
+        SetupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        LOG_INFO("SHADER:: program %u ready in %.3f ms (%s)", ID, SetupMs, FromCache ? "warm: program binary cache" : "cold: compiled from source");
+        addVariant(SHADER_BASE, ID);
+    }
+    // an empty shader, to be loaded with reload
+    // ------------------------------------------------------------------------
+    Shader() : ID(0), FromCache(false), SetupMs(0.0), state(new ShaderState()) {}
+    // re-reads the sources and rebuilds the program. The other variants are rebuilt on
+    // first use and get the uniform values set so far. When the new sources don't link, the old programs stay (a
+    // shader loaded for the first time keeps the broken program, like the constructor does).
+    // ------------------------------------------------------------------------
+    bool reload(const char* vertexPath, const char* fragmentPath)
+    {
+        Shader built;
+        return prepare(vertexPath, fragmentPath, built) && swapIn(built);
+    }
+    // the first half of reload, for a thread with a context shared with this one's (the upload thread): reads the
+    // sources and builds the program into built, a new shader that swapIn takes over. False when they can't be read.
+    // ------------------------------------------------------------------------
+    static bool prepare(const char* vertexPath, const char* fragmentPath, Shader &built)
+    {
+        ResourceData vShaderFile, fShaderFile;
+        if (!ReadResource(vertexPath, vShaderFile) || !ReadResource(fragmentPath, fShaderFile))
+            return false;
+        ShaderState &s = *built.state;
+        s.vertexCode.assign(vShaderFile.data, vShaderFile.size);
+        s.fragmentCode.assign(fShaderFile.data, fShaderFile.size);
+        for (int i = 0; i < SHADER_NUM_FEATURES; i++)
+            if (s.vertexCode.find(SHADER_FEATURE_DEFINES[i]) != std::string::npos || s.fragmentCode.find(SHADER_FEATURE_DEFINES[i]) != std::string::npos)
+                s.usedFeatures |= 1u << i;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        built.ID = build(s.vertexCode, s.fragmentCode, built.FromCache);
+        built.SetupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+    // the second half, on the render thread: replaces the programs and sources with the ones prepare built, keeping
+    // the uniform values and features set so far. False when the program didn't link.
+    // ------------------------------------------------------------------------
+    bool swapIn(Shader &built)
+    {
+        unsigned int program = built.ID;
+        built.ID = 0;
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success && !state->variants.empty())
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            glDeleteProgram(program);
+            return false;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        int success;
-        char infoLog[512];
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-
+        state->variants.clear();
+        state->current = NULL;
+        state->vertexCode.swap(built.state->vertexCode);
+        state->fragmentCode.swap(built.state->fragmentCode);
+        state->usedFeatures = built.state->usedFeatures;
+        ID = program;
+        FromCache = built.FromCache;
+        SetupMs = built.SetupMs;
+        LOG_INFO("SHADER:: program %u ready in %.3f ms (%s)", ID, SetupMs, FromCache ? "warm: program binary cache" : "cold: compiled from source");
+        addVariant(SHADER_BASE, ID);
+        return success != 0;
     }
+    // deletes every variant's program now instead of when the shader is destroyed
+    // ------------------------------------------------------------------------
+    void release()
+    {
+        state->variants.clear();
+        state->current = NULL;
+        ID = 0;
+    }
+    // shaders own their programs: they are moved or passed by reference, never copied
+    // ------------------------------------------------------------------------
+    Shader(Shader &&other) = default;
+    Shader &operator=(Shader &&other) = default;
+    Shader(const Shader &) = delete;
+    Shader &operator=(const Shader &) = delete;
     // activate the shader
     // ------------------------------------------------------------------------
     void use() const
     { 
-        glUseProgram(ID); 
+        bind(variant(SHADER_BASE));
+    }
+    // activate the variant compiled with the given Shader_Feature bits, building it on first use
+    // ------------------------------------------------------------------------
+    void use(unsigned int features) const
+    {
+        bind(variant(features));
+    }
+    // turns features on for every variant selected from now on, on top of the per-material ones
+    // ------------------------------------------------------------------------
+    void enableFeatures(unsigned int features) const
+    {
+        state->globalFeatures |= features;
+    }
+    // builds all the given variants up front. Every shader is submitted before any status is queried so drivers with
+    // threaded compilation work on them in parallel, and drawing never stalls on a first-use compile.
+    // ------------------------------------------------------------------------
+    void prepareVariants(const std::vector<unsigned int> &keys) const
+    {
+        std::vector<unsigned int> pendingKeys;
+        std::vector<PendingProgram> pending;
+        std::vector<std::string> cacheKeys;
+        for (unsigned int i = 0; i < keys.size(); i++)
+        {
+            unsigned int features = keys[i] == SHADER_BASE ? SHADER_BASE : (keys[i] | state->globalFeatures) & state->usedFeatures;
+            if (state->variants.count(features) || std::find(pendingKeys.begin(), pendingKeys.end(), features) != pendingKeys.end())
+                continue;
+            std::string vertexCode = injectDefines(state->vertexCode, features);
+            std::string fragmentCode = injectDefines(state->fragmentCode, features);
+            std::string key = cacheKey(vertexCode, fragmentCode);
+            unsigned int program = 0;
+            if (binaryCacheSupported() && (program = loadBinary(key)) != 0)
+            {
+                addVariant(features, program);
+                continue;
+            }
+            pendingKeys.push_back(features);
+            pending.push_back(startCompile(vertexCode, fragmentCode));
+            cacheKeys.push_back(key);
+        }
+        for (unsigned int i = 0; i < pending.size(); i++)
+            glLinkProgram(pending[i].program);
+        for (unsigned int i = 0; i < pending.size(); i++)
+        {
+            unsigned int program = finishCompile(pending[i]);
+            if (binaryCacheSupported())
+                saveBinary(program, cacheKeys[i]);
+            addVariant(pendingKeys[i], program);
+        }
+        if (!keys.empty())
+            LOG_INFO("SHADER:: %u variants requested, %u compiled", (unsigned int)keys.size(), (unsigned int)pending.size());
+    }
+    // location of a uniform in the bound variant (cached per variant)
+    // ------------------------------------------------------------------------
+    int uniformLocation(const std::string &name) const
+    {
+        ShaderVariant* v = state->current ? state->current : &state->variants[SHADER_BASE];
+        std::map<std::string, int>::iterator it = v->locations.find(name);
+        if (it != v->locations.end())
+            return it->second;
+        int location = glGetUniformLocation(v->program.get(), name.c_str());
+        v->locations[name] = location;
+        return location;
+    }
+    // binds a uniform block to a binding point in every variant, including the ones built later
+    // ------------------------------------------------------------------------
+    void setUniformBlock(const std::string &name, unsigned int binding) const
+    {
+        std::map<std::string, unsigned int>::iterator it = state->blockBindings.find(name);
+        if (it != state->blockBindings.end() && it->second == binding)
+            return;
+        state->blockBindings[name] = binding;
+        for (std::map<unsigned int, ShaderVariant>::iterator v = state->variants.begin(); v != state->variants.end(); ++v)
+            applyBlock(v->second.program.get(), name, binding);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        setInt(name, (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        ShaderUniform u;
+        u.type = GL_INT;
+        u.i = value;
+        set(name, u);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        set(name, GL_FLOAT, &value, 1);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        set(name, GL_FLOAT_VEC2, &value[0], 2);
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        setVec2(name, glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        set(name, GL_FLOAT_VEC3, &value[0], 3);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        setVec3(name, glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        set(name, GL_FLOAT_VEC4, &value[0], 4);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) const
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        setVec4(name, glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(name, GL_FLOAT_MAT2, &mat[0][0], 4);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(name, GL_FLOAT_MAT3, &mat[0][0], 9);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(name, GL_FLOAT_MAT4, &mat[0][0], 16);
     }
 
 private:
+    std::unique_ptr<ShaderState> state;
+
+    struct PendingProgram {
+        unsigned int vertex, fragment, program;
+    };
+
+    // returns the program of a variant, building it on first use
+    // ------------------------------------------------------------------------
+    ShaderVariant* variant(unsigned int features) const
+    {
+        if (features != SHADER_BASE)
+            features = (features | state->globalFeatures) & state->usedFeatures;
+        std::map<unsigned int, ShaderVariant>::iterator it = state->variants.find(features);
+        if (it != state->variants.end())
+            return &it->second;
+        bool cached;
+        unsigned int program = build(injectDefines(state->vertexCode, features), injectDefines(state->fragmentCode, features), cached);
+        LOG_DEBUG("SHADER:: variant 0x%x built on first use (%s)", features, cached ? "cached binary" : "compiled");
+        return addVariant(features, program);
+    }
+
+    ShaderVariant* addVariant(unsigned int features, unsigned int program) const
+    {
+        ShaderVariant &v = state->variants[features];
+        v.program.reset(program);
+        v.appliedVersion = 0;
+        for (std::map<std::string, unsigned int>::iterator it = state->blockBindings.begin(); it != state->blockBindings.end(); ++it)
+            applyBlock(program, it->first, it->second);
+        return &v;
+    }
+
+    // binds a variant and brings its uniforms up to date with the values set while other variants were bound
+    // ------------------------------------------------------------------------
+    void bind(ShaderVariant* v) const
+    {
+        glUseProgram(v->program.get());
+        state->current = v;
+        if (v->appliedVersion == state->version)
+            return;
+        for (std::map<std::string, ShaderUniform>::iterator it = state->uniforms.begin(); it != state->uniforms.end(); ++it)
+            if (it->second.version > v->appliedVersion)
+                apply(uniformLocation(it->first), it->second);
+        v->appliedVersion = state->version;
+    }
+
+    void set(const std::string &name, GLenum type, const float* values, int count) const
+    {
+        ShaderUniform u;
+        u.type = type;
+        std::memcpy(u.f, values, count * sizeof(float));
+        set(name, u);
+    }
+
+    // records the value and sets it on the bound variant
+    void set(const std::string &name, ShaderUniform u) const
+    {
+        u.version = ++state->version;
+        state->uniforms[name] = u;
+        apply(uniformLocation(name), u);
+        if (state->current)
+            state->current->appliedVersion = state->version;
+    }
+
+    static void applyBlock(unsigned int program, const std::string &name, unsigned int binding)
+    {
+        unsigned int index = glGetUniformBlockIndex(program, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, binding);
+    }
+
+    static void apply(int location, const ShaderUniform &u)
+    {
+        if (location < 0)
+            return;
+        switch (u.type)
+        {
+        case GL_INT:        glUniform1i(location, u.i); break;
+        case GL_FLOAT:      glUniform1fv(location, 1, u.f); break;
+        case GL_FLOAT_VEC2: glUniform2fv(location, 1, u.f); break;
+        case GL_FLOAT_VEC3: glUniform3fv(location, 1, u.f); break;
+        case GL_FLOAT_VEC4: glUniform4fv(location, 1, u.f); break;
+        case GL_FLOAT_MAT2: glUniformMatrix2fv(location, 1, GL_FALSE, u.f); break;
+        case GL_FLOAT_MAT3: glUniformMatrix3fv(location, 1, GL_FALSE, u.f); break;
+        case GL_FLOAT_MAT4: glUniformMatrix4fv(location, 1, GL_FALSE, u.f); break;
+        }
+    }
+
+    // inserts one #define per feature bit after the #version line (which must stay the first statement)
+    // ------------------------------------------------------------------------
+    static std::string injectDefines(const std::string &code, unsigned int features)
+    {
+        if (features == SHADER_BASE)
+            return code;
+        std::string defines;
+        for (int i = 0; i < SHADER_NUM_FEATURES; i++)
+            if (features & (1u << i))
+                defines += std::string("#define ") + SHADER_FEATURE_DEFINES[i] + "\n";
+        size_t version = code.find("#version");
+        if (version == std::string::npos)
+            return defines + code;
+        size_t eol = code.find('\n', version);
+        if (eol == std::string::npos)
+            return code + "\n" + defines;
+        return code.substr(0, eol + 1) + defines + code.substr(eol + 1);
+    }
+
+    // builds a program from source, or loads the program binary cached for these sources and this driver.
+    // A binary the driver rejects (e.g. after a driver update with an unchanged version string) falls back to compiling.
+    // ------------------------------------------------------------------------
+    static unsigned int build(const std::string &vertexCode, const std::string &fragmentCode, bool &fromCache)
+    {
+        std::string key = cacheKey(vertexCode, fragmentCode);
+        unsigned int program = binaryCacheSupported() ? loadBinary(key) : 0;
+        fromCache = program != 0;
+        if (!fromCache)
+        {
+            PendingProgram pending = startCompile(vertexCode, fragmentCode);
+            glLinkProgram(pending.program);
+            program = finishCompile(pending);
+            if (binaryCacheSupported())
+                saveBinary(program, key);
+        }
+        return program;
+    }
+
+    // submits the compile of both stages; nothing here waits on the driver
+    // ------------------------------------------------------------------------
+    static PendingProgram startCompile(const std::string &vertexCode, const std::string &fragmentCode)
+    {
+        const char* vShaderCode = vertexCode.c_str();
+        const char * fShaderCode = fragmentCode.c_str();
+        PendingProgram p;
+        // vertex shader
+        p.vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(p.vertex, 1, &vShaderCode, NULL);
+        glCompileShader(p.vertex);
+        // fragment Shader
+        p.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(p.fragment, 1, &fShaderCode, NULL);
+        glCompileShader(p.fragment);
+        // shader Program
+        p.program = glCreateProgram();
+        if (binaryCacheSupported())
+            glProgramParameteri(p.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glAttachShader(p.program, p.vertex);
+        glAttachShader(p.program, p.fragment);
+        return p;
+    }
+
+    // checks the results of a submitted compile; the program must have been linked by the caller
+    // ------------------------------------------------------------------------
+    static unsigned int finishCompile(const PendingProgram &p)
+    {
+        checkCompileErrors(p.vertex, "VERTEX");
+        checkCompileErrors(p.fragment, "FRAGMENT");
+        checkCompileErrors(p.program, "PROGRAM");
+        // delete the shaders as they're linked into our program now and no longer necessery
+        glDeleteShader(p.vertex);
+        glDeleteShader(p.fragment);
+        return p.program;
+    }
+
+    // program binaries need GL 4.1 (or ARB_get_program_binary) and at least one binary format from the driver
+    // ------------------------------------------------------------------------
+    static bool binaryCacheSupported()
+    {
+        static int formats = -1;
+        if (formats < 0)
+        {
+            formats = 0;
+            if (glGetProgramBinary != NULL && glProgramBinary != NULL && glProgramParameteri != NULL)
+                glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        }
+        return formats > 0;
+    }
+
+    // binaries are only valid for the driver that produced them, so the driver strings are part of the key
+    // ------------------------------------------------------------------------
+    static std::string cacheKey(const std::string &vertexCode, const std::string &fragmentCode)
+    {
+        uint64_t hash = Cache::Hash(vertexCode);
+        hash = Cache::Hash(fragmentCode, hash);
+        const GLenum driver[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+        for (int i = 0; i < 3; i++)
+        {
+            const char* text = (const char*)glGetString(driver[i]);
+            hash = Cache::Hash(std::string(text ? text : ""), hash);
+        }
+        return Cache::Key(hash, "glprog");
+    }
+
+    // cache entry layout: GLenum binaryFormat followed by the program binary
+    // ------------------------------------------------------------------------
+    // returns 0 when there is no usable entry
+    static unsigned int loadBinary(const std::string &key)
+    {
+        std::vector<char> data;
+        if (!Cache::Read(key, data) || data.size() <= sizeof(GLenum))
+            return 0;
+        GLenum format = *(const GLenum*)&data[0];
+        unsigned int program = glCreateProgram();
+        glProgramBinary(program, format, &data[sizeof(GLenum)], (GLsizei)(data.size() - sizeof(GLenum)));
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            LOG_WARN("SHADER:: cached program binary %s rejected by the driver, recompiling", key);
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    static void saveBinary(unsigned int program, const std::string &key)
+    {
+        GLint length = 0, success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (!success || length <= 0)
+            return;
+        std::vector<char> data(sizeof(GLenum) + length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, NULL, &format, &data[sizeof(GLenum)]);
+        *(GLenum*)&data[0] = format;
+        if (!Cache::Write(key, data))
+            LOG_WARN("SHADER:: could not write program binary cache %s", key);
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    static void checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -150,7 +558,7 @@ private:
             if (!success)
             {
                 glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+                LOG_ERROR("ERROR::SHADER_COMPILATION_ERROR of type: %s\n%s\n -- --------------------------------------------------- -- ", type, infoLog);
             }
         }
         else
@@ -159,9 +567,10 @@ private:
             if (!success)
             {
                 glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+                LOG_ERROR("ERROR::PROGRAM_LINKING_ERROR of type: %s\n%s\n -- --------------------------------------------------- -- ", type, infoLog);
             }
         }
     }
 };
-#endif
\ No newline at end of file
+static_assert(!std::is_copy_constructible<Shader>::value && !std::is_copy_assignable<Shader>::value, "Shader must not be copyable");
+#endif
@@ -0,0 +1,307 @@
+#ifndef SKYBOX_H
+#define SKYBOX_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/cache.h>
+#include <learnopengl/mipmap.h>
+#include <learnopengl/job_system.h>
+#include <learnopengl/log.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+// EXT_texture_compression_s3tc isn't part of core GL, so glad doesn't define its enums
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+const uint32_t SKYBOX_MAGIC   = 0x59424b53; // "SKBY"
+const uint32_t SKYBOX_VERSION = 1;
+
+// A cubemap sky drawn after the scene. The six faces are decoded on one thread each and, when the driver supports S3TC,
+// compressed to BC1 (DXT1) on those threads as well. The compressed faces go into the cache (8x smaller than the
+// decoded pixels), so later starts skip both the JPEG decode and the compression and upload the blocks directly.
+class Skybox
+{
+public:
+    unsigned int Cubemap;
+    unsigned int VAO;
+    bool Ready;
+    bool FromCache;
+    double SetupMs;
+
+    Skybox() : Cubemap(0), VAO(0), Ready(false), FromCache(false), SetupMs(0.0), VBO(0) {}
+
+    // faces in GL order: +X, -X, +Y, -Y, +Z, -Z (right, left, top, bottom, front, back)
+    bool load(const std::vector<std::string> &faces, const char* vertexPath, const char* fragmentPath)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (faces.size() != 6)
+            return false;
+        std::vector<ResourceData> sources(6);
+        uint64_t hash = Cache::Hash(&SKYBOX_VERSION, sizeof(SKYBOX_VERSION));
+        for (int i = 0; i < 6; i++)
+        {
+            if (!ReadResource(faces[i], sources[i]))
+            {
+                LOG_ERROR("SKYBOX:: can't read %s", faces[i]);
+                return false;
+            }
+            hash = Cache::Hash(sources[i].data, sources[i].size, hash);
+        }
+        bool compress = s3tcSupported();
+        std::string key = Cache::Key(hash, "skybox");
+
+        // cache entry: { magic, version, size, internal format } followed by the six faces' BC1 blocks
+        std::vector<char> blob;
+        int size = 0;
+        FromCache = compress && Cache::Read(key, blob) && blob.size() > 4 * sizeof(uint32_t) &&
+                    ((const uint32_t*)&blob[0])[0] == SKYBOX_MAGIC && ((const uint32_t*)&blob[0])[1] == SKYBOX_VERSION;
+        if (FromCache)
+            size = ((const uint32_t*)&blob[0])[2];
+        FromCache = FromCache && blob.size() == 4 * sizeof(uint32_t) + 6 * bc1Size(size);
+
+        std::vector<std::vector<unsigned char> > pixels(6);
+        if (!FromCache)
+        {
+            // decode (and compress) every face in a job of its own
+            std::vector<int> widths(6, 0), heights(6, 0);
+            Jobs.parallelFor(6, 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                {
+                    int channels;
+                    unsigned char* data = stbi_load_from_memory((const unsigned char*)sources[i].data, (int)sources[i].size, &widths[i], &heights[i], &channels, 3);
+                    if (!data)
+                        continue;
+                    if (compress && widths[i] % 4 == 0 && heights[i] % 4 == 0)
+                        compressBC1(data, widths[i], heights[i], pixels[i]);
+                    else
+                        pixels[i].assign(data, data + (size_t)widths[i] * heights[i] * 3);
+                    stbi_image_free(data);
+                }
+            });
+            size = widths[0];
+            for (int i = 0; i < 6; i++)
+                if (pixels[i].empty() || widths[i] != size || heights[i] != size)
+                {
+                    LOG_ERROR("SKYBOX:: %s is missing or not a square face of the same size as the others", faces[i]);
+                    return false;
+                }
+            compress = compress && pixels[0].size() == bc1Size(size);
+            if (compress)
+            {
+                const uint32_t header[4] = { SKYBOX_MAGIC, SKYBOX_VERSION, (uint32_t)size, GL_COMPRESSED_RGB_S3TC_DXT1_EXT };
+                blob.resize(sizeof(header) + 6 * bc1Size(size));
+                std::memcpy(&blob[0], header, sizeof(header));
+                for (int i = 0; i < 6; i++)
+                    std::memcpy(&blob[sizeof(header) + i * bc1Size(size)], &pixels[i][0], bc1Size(size));
+                if (!Cache::Write(key, blob))
+                    LOG_WARN("SKYBOX:: could not cache the compressed faces");
+            }
+        }
+
+        // immutable storage for all six faces, then one sub-image upload per face
+        glGenTextures(1, &Cubemap);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, Cubemap);
+        GLenum internalFormat = compress ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGB8;
+        if (glTexStorage2D)
+            glTexStorage2D(GL_TEXTURE_CUBE_MAP, 1, internalFormat, size, size);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (int i = 0; i < 6; i++)
+        {
+            GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
+            const void* data = FromCache ? (const void*)&blob[4 * sizeof(uint32_t) + i * bc1Size(size)] : (const void*)&pixels[i][0];
+            if (compress && glTexStorage2D)
+                glCompressedTexSubImage2D(target, 0, 0, 0, size, size, internalFormat, (GLsizei)bc1Size(size), data);
+            else if (compress)
+                glCompressedTexImage2D(target, 0, internalFormat, size, size, 0, (GLsizei)bc1Size(size), data);
+            else if (glTexStorage2D)
+                glTexSubImage2D(target, 0, 0, 0, size, size, GL_RGB, GL_UNSIGNED_BYTE, data);
+            else
+                glTexImage2D(target, 0, internalFormat, size, size, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+        shader.reset(new Shader(vertexPath, fragmentPath));
+        shader->use();
+        shader->setInt("skybox", 0);
+        setupCube();
+        Ready = true;
+        SetupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        LOG_INFO("SKYBOX:: %dx%d faces ready in %.1f ms (%s, %s)", size, size, SetupMs, FromCache ? "warm: cache" : "cold: decoded",
+                 compress ? "BC1" : "RGB8");
+        return true;
+    }
+
+    // Draws the sky behind everything already in the depth buffer. The vertex shader puts the cube on the far plane
+    // (z = w), so with GL_LEQUAL only the pixels no geometry covered pass, and early-Z skips shading the rest.
+    void Draw(const glm::mat4 &view, const glm::mat4 &projection) const
+    {
+        if (!Ready)
+            return;
+        glDepthFunc(GL_LEQUAL);
+        shader->use();
+        // remove the translation so the sky stays around the camera
+        shader->setMat4("view", glm::mat4(glm::mat3(view)));
+        shader->setMat4("projection", projection);
+        glBindVertexArray(VAO);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, Cubemap);
+        glDrawArrays(GL_TRIANGLES, 0, 36);
+        glBindVertexArray(0);
+        glDepthFunc(GL_LESS);
+    }
+
+    void release()
+    {
+        glDeleteTextures(1, &Cubemap);
+        glDeleteBuffers(1, &VBO);
+        glDeleteVertexArrays(1, &VAO);
+        Cubemap = VBO = VAO = 0;
+        shader.reset();
+        Ready = false;
+    }
+
+private:
+    unsigned int VBO;
+    std::unique_ptr<Shader> shader;
+
+    static size_t bc1Size(int size)
+    {
+        return (size_t)(size / 4) * (size / 4) * 8;
+    }
+
+    static bool s3tcSupported()
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (name && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+                return true;
+        }
+        return false;
+    }
+
+    static uint16_t to565(const glm::vec3 &c)
+    {
+        int r = (int)(glm::clamp(c.r, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+        int g = (int)(glm::clamp(c.g, 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+        int b = (int)(glm::clamp(c.b, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    static glm::vec3 from565(uint16_t c)
+    {
+        return glm::vec3(((c >> 11) & 31) * 255.0f / 31.0f, ((c >> 5) & 63) * 255.0f / 63.0f, (c & 31) * 255.0f / 31.0f);
+    }
+
+    // BC1 encoder: the endpoints are the extremes of the block's colours along their principal axis (a few power
+    // iterations on the covariance), every texel then takes the nearest of the four palette entries
+    static void compressBC1(const unsigned char* rgb, int width, int height, std::vector<unsigned char> &blocks)
+    {
+        blocks.resize((size_t)(width / 4) * (height / 4) * 8);
+        unsigned char* out = &blocks[0];
+        for (int by = 0; by < height; by += 4)
+            for (int bx = 0; bx < width; bx += 4, out += 8)
+            {
+                glm::vec3 texels[16], mean(0.0f);
+                for (int i = 0; i < 16; i++)
+                {
+                    const unsigned char* p = rgb + ((size_t)(by + i / 4) * width + bx + i % 4) * 3;
+                    texels[i] = glm::vec3(p[0], p[1], p[2]);
+                    mean += texels[i] / 16.0f;
+                }
+                glm::mat3 covariance(0.0f);
+                for (int i = 0; i < 16; i++)
+                {
+                    glm::vec3 d = texels[i] - mean;
+                    covariance += glm::outerProduct(d, d);
+                }
+                glm::vec3 axis(1.0f, 1.0f, 1.0f);
+                for (int k = 0; k < 4; k++)
+                {
+                    axis = covariance * axis;
+                    float length = glm::length(axis);
+                    axis = length > 1e-6f ? axis / length : glm::vec3(0.57735f);
+                }
+                float lo = 1e9f, hi = -1e9f;
+                for (int i = 0; i < 16; i++)
+                {
+                    float t = glm::dot(texels[i] - mean, axis);
+                    lo = std::min(lo, t);
+                    hi = std::max(hi, t);
+                }
+                uint16_t c0 = to565(mean + axis * hi), c1 = to565(mean + axis * lo);
+                if (c0 < c1)
+                    std::swap(c0, c1);
+                uint32_t indices = 0;
+                if (c0 != c1)
+                {
+                    // four colour mode (c0 > c1): c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1
+                    glm::vec3 palette[4] = { from565(c0), from565(c1), glm::vec3(0.0f), glm::vec3(0.0f) };
+                    palette[2] = (2.0f * palette[0] + palette[1]) / 3.0f;
+                    palette[3] = (palette[0] + 2.0f * palette[1]) / 3.0f;
+                    for (int i = 0; i < 16; i++)
+                    {
+                        int best = 0;
+                        float bestDistance = 1e9f;
+                        for (int p = 0; p < 4; p++)
+                        {
+                            glm::vec3 d = texels[i] - palette[p];
+                            float distance = glm::dot(d, d);
+                            if (distance < bestDistance)
+                            {
+                                bestDistance = distance;
+                                best = p;
+                            }
+                        }
+                        indices |= (uint32_t)best << (2 * i);
+                    }
+                }
+                out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+                out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+                for (int i = 0; i < 4; i++)
+                    out[4 + i] = (indices >> (8 * i)) & 0xFF;
+            }
+    }
+
+    void setupCube()
+    {
+        static const float vertices[] = {
+            -1.0f,  1.0f, -1.0f,  -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   1.0f,  1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,
+            -1.0f, -1.0f,  1.0f,  -1.0f, -1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,  -1.0f,  1.0f,  1.0f,  -1.0f, -1.0f,  1.0f,
+             1.0f, -1.0f, -1.0f,   1.0f, -1.0f,  1.0f,   1.0f,  1.0f,  1.0f,   1.0f,  1.0f,  1.0f,   1.0f,  1.0f, -1.0f,   1.0f, -1.0f, -1.0f,
+            -1.0f, -1.0f,  1.0f,  -1.0f,  1.0f,  1.0f,   1.0f,  1.0f,  1.0f,   1.0f,  1.0f,  1.0f,   1.0f, -1.0f,  1.0f,  -1.0f, -1.0f,  1.0f,
+            -1.0f,  1.0f, -1.0f,   1.0f,  1.0f, -1.0f,   1.0f,  1.0f,  1.0f,   1.0f,  1.0f,  1.0f,  -1.0f,  1.0f,  1.0f,  -1.0f,  1.0f, -1.0f,
+            -1.0f, -1.0f, -1.0f,  -1.0f, -1.0f,  1.0f,   1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,  -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f
+        };
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glBindVertexArray(0);
+    }
+};
+#endif
@@ -0,0 +1,148 @@
+#ifndef TANGENTS_H
+#define TANGENTS_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/arena.h>
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <unordered_map>
+#include <functional>
+
+// Tangent space generation for indexed triangle meshes, following MikkTSpace's conventions so normal maps baked by the
+// usual tools come out right: every triangle corner contributes its triangle's texture space direction projected onto
+// the vertex normal and weighted by the corner's angle, corners whose UVs are mirrored go to a separate copy of the
+// vertex, and the bitangent is sign * cross(normal, tangent). Meshes are independent, so callers run one per thread;
+// the temporaries go to the thread's arena when it passes one.
+
+// smooth normals for a mesh without them: face normals weighted by the corner angles, shared by every vertex at the
+// same position so UV seams don't show in the lighting
+void GenerateNormals(std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, Arena* arena = NULL)
+{
+    struct PositionHash {
+        size_t operator()(const glm::vec3 &p) const
+        {
+            uint32_t bits[3];
+            std::memcpy(bits, &p, sizeof(bits));
+            return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+        }
+    };
+    typedef std::pair<const glm::vec3, unsigned int> Entry;
+    std::unordered_map<glm::vec3, unsigned int, PositionHash, std::equal_to<glm::vec3>, ArenaAllocator<Entry> > welded(
+        vertices.size(), PositionHash(), std::equal_to<glm::vec3>(), ArenaAllocator<Entry>(arena));
+    ArenaVector<unsigned int> position(vertices.size(), 0, arena);
+    for (size_t i = 0; i < vertices.size(); i++)
+        position[i] = welded.insert(std::make_pair(vertices[i].Position, (unsigned int)welded.size())).first->second;
+
+    ArenaVector<glm::vec3> normals(welded.size(), glm::vec3(0.0f), arena);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const glm::vec3 p[3] = { vertices[indices[i]].Position, vertices[indices[i + 1]].Position, vertices[indices[i + 2]].Position };
+        glm::vec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+        float length = glm::length(n);
+        if (length <= 0.0f)
+            continue;
+        n /= length;
+        for (int k = 0; k < 3; k++)
+        {
+            glm::vec3 a = p[(k + 1) % 3] - p[k], b = p[(k + 2) % 3] - p[k];
+            float la = glm::length(a), lb = glm::length(b);
+            if (la > 0.0f && lb > 0.0f)
+                normals[position[indices[i + k]]] += n * std::acos(glm::clamp(glm::dot(a, b) / (la * lb), -1.0f, 1.0f));
+        }
+    }
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        glm::vec3 n = normals[position[i]];
+        vertices[i].Normal = glm::length(n) > 0.0f ? glm::normalize(n) : glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+}
+
+// per vertex tangents and bitangents; vertices shared by mirrored and unmirrored triangles are duplicated, so vertices
+// may be appended and indices rewritten
+void GenerateTangents(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, Arena* arena = NULL)
+{
+    size_t triangles = indices.size() / 3;
+    // the texture space direction of every triangle, and whether its UVs keep their orientation (2 for triangles
+    // without UV area, which take the orientation of the vertices they use)
+    ArenaVector<glm::vec3> directions(triangles, glm::vec3(0.0f), arena);
+    ArenaVector<unsigned char> preserving(triangles, 2, arena);
+    ArenaVector<unsigned char> seen(vertices.size(), 0, arena);
+    for (size_t t = 0; t < triangles; t++)
+    {
+        const Vertex &a = vertices[indices[3 * t]], &b = vertices[indices[3 * t + 1]], &c = vertices[indices[3 * t + 2]];
+        glm::vec3 d1 = b.Position - a.Position, d2 = c.Position - a.Position;
+        glm::vec2 t21 = b.TexCoords - a.TexCoords, t31 = c.TexCoords - a.TexCoords;
+        float area = t21.x * t31.y - t21.y * t31.x;
+        if (std::fabs(area) <= 1e-12f)
+            continue;
+        preserving[t] = area > 0.0f ? 1 : 0;
+        glm::vec3 s = d1 * t31.y - d2 * t21.y;
+        float length = glm::length(s);
+        if (length > 0.0f)
+            directions[t] = s * ((area > 0.0f ? 1.0f : -1.0f) / length);
+        for (int k = 0; k < 3; k++)
+            seen[indices[3 * t + k]] |= preserving[t] ? 1 : 2;
+    }
+
+    // the mirrored corners of vertices used both ways move to a copy
+    ArenaVector<unsigned int> mirrored(vertices.size(), 0, arena);
+    size_t original = vertices.size(), copies = 0;
+    for (size_t i = 0; i < original; i++)
+        copies += seen[i] == 3;
+    vertices.reserve(original + copies);
+    ArenaVector<float> signs(original, 1.0f, arena);
+    signs.reserve(original + copies);
+    for (size_t i = 0; i < original; i++)
+    {
+        if (seen[i] == 2)
+            signs[i] = -1.0f;
+        if (seen[i] == 3)
+        {
+            mirrored[i] = (unsigned int)vertices.size();
+            vertices.push_back(vertices[i]);
+            signs.push_back(-1.0f);
+        }
+    }
+    for (size_t t = 0; t < triangles; t++)
+        if (preserving[t] == 0)
+            for (int k = 0; k < 3; k++)
+                if (seen[indices[3 * t + k]] == 3)
+                    indices[3 * t + k] = mirrored[indices[3 * t + k]];
+
+    ArenaVector<glm::vec3> sums(vertices.size(), glm::vec3(0.0f), arena);
+    for (size_t t = 0; t < triangles; t++)
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = indices[3 * t + k];
+            // the corner's angle and the direction are both taken in the plane of the vertex normal
+            const glm::vec3 &n = vertices[v].Normal;
+            glm::vec3 s = directions[t] - n * glm::dot(n, directions[t]);
+            glm::vec3 a = vertices[indices[3 * t + (k + 1) % 3]].Position - vertices[v].Position;
+            glm::vec3 b = vertices[indices[3 * t + (k + 2) % 3]].Position - vertices[v].Position;
+            a -= n * glm::dot(n, a);
+            b -= n * glm::dot(n, b);
+            float ls = glm::length(s), la = glm::length(a), lb = glm::length(b);
+            if (ls > 0.0f && la > 0.0f && lb > 0.0f)
+                sums[v] += s * (std::acos(glm::clamp(glm::dot(a, b) / (la * lb), -1.0f, 1.0f)) / ls);
+        }
+
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        Vertex &vertex = vertices[i];
+        glm::vec3 t = sums[i] - vertex.Normal * glm::dot(vertex.Normal, sums[i]);
+        if (glm::length(t) <= 1e-20f)
+        {
+            // no usable texture direction around the vertex: any tangent perpendicular to the normal
+            glm::vec3 axis = std::fabs(vertex.Normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            t = axis - vertex.Normal * glm::dot(vertex.Normal, axis);
+        }
+        vertex.Tangent = glm::normalize(t);
+        vertex.Bitangent = signs[i] * glm::cross(vertex.Normal, vertex.Tangent);
+    }
+}
+#endif
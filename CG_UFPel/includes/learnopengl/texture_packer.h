@@ -0,0 +1,322 @@
+#ifndef TEXTURE_PACKER_H
+#define TEXTURE_PACKER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/gl_handle.h>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/log.h>
+#include <learnopengl/mipmap.h>
+#include <learnopengl/channel_pack.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+using namespace std;
+
+// Limits of the packed path. They must match the DrawMaterials block in cg_ufpel.fs; 128 records of 96 bytes stay
+// under the 16 KB uniform block size every GL 3.3 driver guarantees.
+const int MAX_PACKED_DRAWS  = 128;
+const int PACKED_SLOTS      = 4;
+const int PACKED_ATLAS_SIZE = 4096;
+const int PACKED_ATLAS_PAD  = 4;
+const char* const PACKED_SLOT_TYPES[PACKED_SLOTS] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+// their samplers in cg_ufpel.fs, made once so binding a packer every draw builds no strings
+const string PACKED_ARRAY_UNIFORMS[PACKED_SLOTS] = { "texture_diffuse_array", "texture_specular_array", "texture_normal_array", "texture_height_array" };
+const string PACKED_ATLAS_UNIFORMS[PACKED_SLOTS] = { "texture_diffuse_atlas", "texture_specular_atlas", "texture_normal_atlas", "texture_height_atlas" };
+// first texture unit used by the packed textures; slot s uses units 2s (array) and 2s + 1 (atlas)
+const int PACKED_FIRST_UNIT = 0;
+// uniform buffer binding point of the DrawMaterials block
+const unsigned int PACKED_UNIFORM_BINDING = 1;
+
+// Per-draw record in the DrawMaterials uniform block (std140: ivec4 + ivec4 + vec4[4]).
+// layers[s] >= 0 is a layer of slot s's array, -1 means the texture is in slot s's atlas at atlasRects[s]
+// (xy = offset, zw = scale in atlas UV space), -2 means the mesh has no texture of that type. channels[s] is the
+// channel of a channel packed map (Texture::channel), -1 otherwise.
+struct PackedDrawMaterial {
+    int layers[PACKED_SLOTS];
+    int channels[PACKED_SLOTS];
+    glm::vec4 atlasRects[PACKED_SLOTS];
+};
+
+// One texture type of a model: an array holding every texture of the most common size, and an atlas for the rest
+struct PackedSlot {
+    GLTexture arrayTexture;
+    GLTexture atlasTexture;
+    map<string, int> layerOf;
+    map<string, glm::vec4> rectOf;
+};
+
+// Packs a model's material textures into GL_TEXTURE_2D_ARRAYs (plus atlases for odd sizes), so the whole model is drawn
+// with one set of texture bindings and a per-draw index into a small uniform buffer instead of per-mesh binds.
+// Textures are normalized to RGBA8 so grouping only depends on size; diffuse maps are mip filtered as sRGB.
+class TexturePacker
+{
+public:
+    PackedSlot slots[PACKED_SLOTS];
+    GLBuffer UBO;
+    bool Packed;
+
+    TexturePacker() : Packed(false) {}
+
+    // moves the packed textures, leaving the other packer empty
+    TexturePacker(TexturePacker &&other) : Packed(false)
+    {
+        *this = std::move(other);
+    }
+
+    TexturePacker &operator=(TexturePacker &&other)
+    {
+        if (this == &other)
+            return *this;
+        for (int s = 0; s < PACKED_SLOTS; s++)
+            slots[s] = std::move(other.slots[s]);
+        UBO = std::move(other.UBO);
+        Packed = other.Packed;
+        other.release();
+        return *this;
+    }
+
+    // decodes the textures the meshes reference (from directory) and builds the arrays, atlases and per-draw buffer.
+    // Returns false, leaving nothing allocated, when the meshes can't be packed.
+    bool pack(const vector<Mesh> &meshes, const string &directory)
+    {
+        if (meshes.empty() || meshes.size() > (size_t)MAX_PACKED_DRAWS)
+            return false;
+
+        for (int s = 0; s < PACKED_SLOTS; s++)
+        {
+            if (!packSlot(s, meshes, directory))
+            {
+                release();
+                return false;
+            }
+        }
+
+        // per-draw records, one per mesh in draw order
+        vector<PackedDrawMaterial> records(meshes.size());
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            for (int s = 0; s < PACKED_SLOTS; s++)
+            {
+                records[i].layers[s] = -2;
+                records[i].channels[s] = -1;
+                records[i].atlasRects[s] = glm::vec4(0.0f);
+                const Texture* texture = firstOfType(meshes[i], PACKED_SLOT_TYPES[s]);
+                if (!texture)
+                    continue;
+                records[i].channels[s] = texture->channel;
+                map<string, int>::iterator layer = slots[s].layerOf.find(texture->path);
+                if (layer != slots[s].layerOf.end())
+                    records[i].layers[s] = layer->second;
+                else
+                {
+                    records[i].layers[s] = -1;
+                    records[i].atlasRects[s] = slots[s].rectOf[texture->path];
+                }
+            }
+        }
+        UBO = GLBuffer::generate();
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO.get());
+        glBufferData(GL_UNIFORM_BUFFER, MAX_PACKED_DRAWS * sizeof(PackedDrawMaterial), NULL, GL_STATIC_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, records.size() * sizeof(PackedDrawMaterial), &records[0]);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        Packed = true;
+        return true;
+    }
+
+    // binds the whole model's texture set and per-draw buffer once; meshes then only select their record
+    void bind(const Shader &shader, unsigned int uniformBinding) const
+    {
+        for (int s = 0; s < PACKED_SLOTS; s++)
+        {
+            // no mesh has a texture of this type, so no variant drawn with this packer samples it
+            if (!slots[s].arrayTexture && !slots[s].atlasTexture)
+                continue;
+            glActiveTexture(GL_TEXTURE0 + PACKED_FIRST_UNIT + 2 * s);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, slots[s].arrayTexture.get());
+            shader.setInt(PACKED_ARRAY_UNIFORMS[s], PACKED_FIRST_UNIT + 2 * s);
+            glActiveTexture(GL_TEXTURE0 + PACKED_FIRST_UNIT + 2 * s + 1);
+            glBindTexture(GL_TEXTURE_2D, slots[s].atlasTexture.get());
+            shader.setInt(PACKED_ATLAS_UNIFORMS[s], PACKED_FIRST_UNIT + 2 * s + 1);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, uniformBinding, UBO.get());
+    }
+
+    // deletes the arrays, atlases and per-draw buffer now instead of when the packer is destroyed
+    void release()
+    {
+        for (int s = 0; s < PACKED_SLOTS; s++)
+            slots[s] = PackedSlot();
+        UBO.reset();
+        Packed = false;
+    }
+
+private:
+    struct Source {
+        string path;
+        int width, height;
+    };
+
+    static const Texture* firstOfType(const Mesh &mesh, const char* type)
+    {
+        for (unsigned int i = 0; i < mesh.textures.size(); i++)
+            if (mesh.textures[i].type == type)
+                return &mesh.textures[i];
+        return NULL;
+    }
+
+    static bool tallerFirst(const Source &a, const Source &b)
+    {
+        return a.height > b.height;
+    }
+
+    bool packSlot(int s, const vector<Mesh> &meshes, const string &directory)
+    {
+        // collect the distinct textures of this type and their sizes (header only, no decode yet)
+        vector<Source> sources;
+        map<pair<int, int>, int> sizeCount;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            const Texture* texture = firstOfType(meshes[i], PACKED_SLOT_TYPES[s]);
+            if (!texture)
+                continue;
+            bool seen = false;
+            for (unsigned int j = 0; j < sources.size(); j++)
+                seen = seen || sources[j].path == texture->path;
+            if (seen)
+                continue;
+            Source source;
+            source.path = texture->path;
+            if (!MaterialImageInfo(directory, source.path, source.width, source.height))
+            {
+                LOG_WARN("TEXTURE_PACKER:: can't read %s, model stays unpacked", source.path);
+                return false;
+            }
+            sources.push_back(source);
+            sizeCount[make_pair(source.width, source.height)]++;
+        }
+
+        // the most common size goes into the array, everything else into the atlas
+        pair<int, int> arraySize(1, 1);
+        int best = 0;
+        for (map<pair<int, int>, int>::iterator it = sizeCount.begin(); it != sizeCount.end(); ++it)
+            if (it->second > best)
+            {
+                best = it->second;
+                arraySize = it->first;
+            }
+        vector<Source> layers, odd;
+        for (unsigned int i = 0; i < sources.size(); i++)
+            (make_pair(sources[i].width, sources[i].height) == arraySize ? layers : odd).push_back(sources[i]);
+
+        // shelf-pack the odd sizes, tallest first
+        sort(odd.begin(), odd.end(), tallerFirst);
+        vector<glm::ivec2> offsets(odd.size());
+        int x = 0, y = 0, shelf = 0;
+        for (unsigned int i = 0; i < odd.size(); i++)
+        {
+            int w = odd[i].width + 2 * PACKED_ATLAS_PAD, h = odd[i].height + 2 * PACKED_ATLAS_PAD;
+            if (x + w > PACKED_ATLAS_SIZE)
+            {
+                x = 0;
+                y += shelf;
+                shelf = 0;
+            }
+            if (w > PACKED_ATLAS_SIZE || y + h > PACKED_ATLAS_SIZE)
+            {
+                LOG_WARN("TEXTURE_PACKER:: %s textures don't fit a %d atlas, model stays unpacked", PACKED_SLOT_TYPES[s], PACKED_ATLAS_SIZE);
+                return false;
+            }
+            offsets[i] = glm::ivec2(x + PACKED_ATLAS_PAD, y + PACKED_ATLAS_PAD);
+            x += w;
+            shelf = max(shelf, h);
+        }
+        int atlasHeight = max(1, y + shelf);
+
+        bool srgb = s == 0; // only the diffuse slot holds colour
+
+        // array: the textures of the common size, each with its prebuilt (and disk cached) mip chain. A slot's array
+        // and atlas are only created when they hold something; the shader never samples an empty one.
+        if (!layers.empty())
+        {
+            slots[s].arrayTexture = GLTexture::generate();
+            glBindTexture(GL_TEXTURE_2D_ARRAY, slots[s].arrayTexture.get());
+            int levels = MipLevelCount(arraySize.first, arraySize.second);
+            if (glTexStorage3D)
+                glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, arraySize.first, arraySize.second, (int)layers.size());
+            else
+            {
+                for (int level = 0; level < levels; level++)
+                    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, max(1, arraySize.first >> level), max(1, arraySize.second >> level), (int)layers.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            bool uploaded = uploadLayers(s, layers, directory, srgb, levels);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            if (!uploaded)
+                return false;
+            setSampling(GL_TEXTURE_2D_ARRAY);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        }
+
+        // atlas: composed on the CPU so its mip chain is filtered the same way as everything else
+        if (!odd.empty())
+        {
+            vector<unsigned char> atlas((size_t)PACKED_ATLAS_SIZE * atlasHeight * 4, 0);
+            for (unsigned int i = 0; i < odd.size(); i++)
+            {
+                MipChain chain;
+                if (!LoadMaterialChain(directory, odd[i].path, 4, srgb, chain))
+                    return false;
+                int w = chain.width, h = chain.height;
+                for (int row = 0; row < h; row++)
+                    memcpy(&atlas[((size_t)(offsets[i].y + row) * PACKED_ATLAS_SIZE + offsets[i].x) * 4], chain.level(0) + (size_t)row * w * 4, (size_t)w * 4);
+                slots[s].rectOf[odd[i].path] = glm::vec4((float)offsets[i].x / PACKED_ATLAS_SIZE, (float)offsets[i].y / atlasHeight,
+                                                         (float)w / PACKED_ATLAS_SIZE, (float)h / atlasHeight);
+            }
+            MipChain atlasChain;
+            BuildMipChain(&atlas[0], PACKED_ATLAS_SIZE, atlasHeight, 4, srgb, atlasChain);
+            slots[s].atlasTexture = GLTexture::generate();
+            glBindTexture(GL_TEXTURE_2D, slots[s].atlasTexture.get());
+            UploadMipChain(atlasChain);
+            setSampling(GL_TEXTURE_2D);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+
+        if (!sources.empty())
+            LOG_INFO("TEXTURE_PACKER:: %s: %u layers of %dx%d, %u in atlas", PACKED_SLOT_TYPES[s], (unsigned int)layers.size(), arraySize.first, arraySize.second, (unsigned int)odd.size());
+        return true;
+    }
+
+    // decodes the layers' chains into the bound array, with GL_UNPACK_ALIGNMENT already 1
+    bool uploadLayers(int s, const vector<Source> &layers, const string &directory, bool srgb, int levels)
+    {
+        for (unsigned int i = 0; i < layers.size(); i++)
+        {
+            MipChain chain;
+            if (!LoadMaterialChain(directory, layers[i].path, 4, srgb, chain) || chain.levels() != levels)
+                return false;
+            for (int level = 0; level < chain.levels(); level++)
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, i, chain.levelWidth(level), chain.levelHeight(level), 1, GL_RGBA, GL_UNSIGNED_BYTE, chain.level(level));
+            slots[s].layerOf[layers[i].path] = i;
+        }
+        return true;
+    }
+
+    static void setSampling(GLenum target)
+    {
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+};
+#endif
@@ -0,0 +1,423 @@
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/mipmap.h>
+#include <learnopengl/channel_pack.h>
+#include <learnopengl/upload_thread.h>
+#include <learnopengl/log.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <cmath>
+#include <algorithm>
+
+const size_t TEXTURE_BUDGET_DEFAULT = (size_t)512 << 20;
+// re-specifications per update(); the rest waits for the next frames so streaming never stalls a frame for long
+const int TEXTURE_STREAMS_PER_FRAME = 2;
+
+// Keeps the textures it loads within a memory budget. Every frame the renderer reports which textures it drew and how
+// large they were on screen (request); update() then streams the mips they need back in and, while the total is over
+// budget, drops the top mips of the textures that are unused, more detailed than needed or least recently used, the
+// largest first. A texture's id never changes: it is re-specified with its resident top mip as level 0, which needs
+// mutable storage. Dropping mips copies the remaining levels on the GPU; mips coming back are read from the mip chain
+// cache (mipmap.h).
+// Textures owned by someone else (arrays, skybox, environment maps) only count against the budget (addFixed).
+// With an upload thread the levels coming back are read and sent to the GPU on it, and update() only re-specifies the
+// textures whose levels have arrived. Models reimported there load and count their textures on it too, so the manager
+// is locked; update() leaves a texture loaded by another thread alone until the fence put after its upload signals.
+class TextureResidency
+{
+public:
+    size_t Budget;
+    std::atomic<size_t> ResidentBytes;
+    std::atomic<size_t> FixedBytes;
+    unsigned int Frame;
+    // streams on this thread when set, on the render thread inside update() otherwise
+    UploadThread *Uploads;
+
+    TextureResidency(size_t budget = TEXTURE_BUDGET_DEFAULT) : Budget(budget), ResidentBytes(0), FixedBytes(0), Frame(1), Uploads(NULL) {}
+
+    TextureResidency(const TextureResidency &) = delete;
+    TextureResidency &operator=(const TextureResidency &) = delete;
+
+    // loads a material texture (see LoadMaterialChain; desiredChannels 0 keeps the file's) at full resolution and takes
+    // over its residency
+    unsigned int load(const std::string &directory, const std::string &path, bool srgb, int desiredChannels = 0)
+    {
+        MipChain chain;
+        if (!LoadMaterialChain(directory, path, desiredChannels, srgb, chain))
+            return 0;
+        Entry e;
+        glGenTextures(1, &e.id);
+        e.directory = directory;
+        e.path = path;
+        e.srgb = srgb;
+        e.desiredChannels = desiredChannels;
+        e.width = chain.width;
+        e.height = chain.height;
+        e.channels = chain.channels;
+        e.levels = chain.levels();
+        e.residentBase = e.targetBase = 0;
+        e.wantedBase = e.levels - 1;
+        e.lastUsed = 0;
+        e.streamingBase = -1;
+        e.uploaded = NULL;
+
+        glBindTexture(GL_TEXTURE_2D, e.id);
+        UploadMipChainFrom(chain, 0, 0, chain.level(0));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        // loads may come from the upload thread's context, whose commands the render thread's can't see before they
+        // are done
+        if (Uploads)
+        {
+            e.uploaded = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+        }
+
+        std::lock_guard<std::recursive_mutex> guard(lock);
+        ResidentBytes += e.bytes(0);
+        index[e.id] = entries.size();
+        entries.push_back(e);
+        return e.id;
+    }
+
+    // counts a texture managed elsewhere against the budget, at its current size
+    void addFixed(GLenum target, unsigned int id)
+    {
+        GLenum query = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+        size_t faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+        std::lock_guard<std::recursive_mutex> guard(lock);
+        glBindTexture(target, id);
+        for (int level = 0; ; level++)
+        {
+            GLint width = 0, height = 0, depth = 0, compressed = 0, size = 0;
+            glGetTexLevelParameteriv(query, level, GL_TEXTURE_WIDTH, &width);
+            if (width == 0)
+                break;
+            glGetTexLevelParameteriv(query, level, GL_TEXTURE_HEIGHT, &height);
+            glGetTexLevelParameteriv(query, level, GL_TEXTURE_DEPTH, &depth);
+            glGetTexLevelParameteriv(query, level, GL_TEXTURE_COMPRESSED, &compressed);
+            if (compressed)
+                glGetTexLevelParameteriv(query, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            else
+            {
+                static const GLenum components[] = { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE, GL_TEXTURE_DEPTH_SIZE };
+                GLint bits = 0;
+                for (int c = 0; c < 5; c++)
+                {
+                    GLint b = 0;
+                    glGetTexLevelParameteriv(query, level, components[c], &b);
+                    bits += b;
+                }
+                size = width * height * std::max(1, depth) * (bits / 8);
+            }
+            FixedBytes += faces * size;
+            fixed[id] += faces * size;
+        }
+        glBindTexture(target, 0);
+    }
+
+    // stops counting a texture added with addFixed (its owner deletes it)
+    void removeFixed(unsigned int id)
+    {
+        std::lock_guard<std::recursive_mutex> guard(lock);
+        std::map<unsigned int, size_t>::iterator it = fixed.find(id);
+        if (it == fixed.end())
+            return;
+        FixedBytes -= it->second;
+        fixed.erase(it);
+    }
+
+    // GPU bytes of a texture loaded or added here, 0 for others
+    size_t bytesOf(unsigned int id) const
+    {
+        std::lock_guard<std::recursive_mutex> guard(lock);
+        std::map<unsigned int, size_t>::const_iterator it = index.find(id);
+        if (it != index.end())
+            return entries[it->second].bytes(entries[it->second].residentBase);
+        it = fixed.find(id);
+        return it != fixed.end() ? it->second : 0;
+    }
+
+    // stops managing or counting a texture and deletes it
+    void release(unsigned int id)
+    {
+        std::lock_guard<std::recursive_mutex> guard(lock);
+        std::map<unsigned int, size_t>::iterator it = index.find(id);
+        if (it == index.end())
+        {
+            removeFixed(id);
+            glDeleteTextures(1, &id);
+            return;
+        }
+        size_t i = it->second;
+        ResidentBytes -= entries[i].bytes(entries[i].residentBase);
+        if (entries[i].uploaded)
+            glDeleteSync(entries[i].uploaded);
+        glDeleteTextures(1, &entries[i].id);
+        index.erase(it);
+        if (i + 1 != entries.size())
+        {
+            entries[i] = entries.back();
+            index[entries[i].id] = i;
+        }
+        entries.pop_back();
+    }
+
+    // the texture was drawn this frame covering about screenPixels pixels (the on-screen size of what it is mapped on)
+    void request(unsigned int id, float screenPixels)
+    {
+        std::lock_guard<std::recursive_mutex> guard(lock);
+        std::map<unsigned int, size_t>::iterator it = index.find(id);
+        if (it == index.end())
+            return;
+        Entry &e = entries[it->second];
+        e.lastUsed = Frame;
+        e.wantedBase = std::min(e.wantedBase, RequiredLevel(std::max(e.width, e.height), screenPixels, e.levels));
+    }
+
+    // first mip level that still has at least one texel per screen pixel
+    static int RequiredLevel(int textureSize, float screenPixels, int levels)
+    {
+        if (screenPixels <= 1.0f)
+            return levels - 1;
+        int level = (int)std::floor(std::log2((float)textureSize / screenPixels));
+        return std::max(0, std::min(level, levels - 1));
+    }
+
+    // called once per frame after drawing: decides the resident mips of every texture and streams the changes
+    void update()
+    {
+        std::lock_guard<std::recursive_mutex> guard(lock);
+        // textures drawn this frame get at least the detail they asked for, nothing shrinks while there is room; a
+        // texture being streamed, or still being uploaded by another thread, counts at the size it is getting
+        size_t total = FixedBytes;
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            Entry &e = entries[i];
+            if (e.uploaded && glClientWaitSync(e.uploaded, 0, 0) != GL_TIMEOUT_EXPIRED)
+            {
+                glDeleteSync(e.uploaded);
+                e.uploaded = NULL;
+            }
+            if (e.uploaded)
+                e.targetBase = e.residentBase;
+            else if (e.streamingBase >= 0)
+                e.targetBase = e.streamingBase;
+            else
+                e.targetBase = e.lastUsed == Frame ? std::min(e.wantedBase, e.residentBase) : e.residentBase;
+            total += e.bytes(e.targetBase);
+        }
+        // over budget: drop one top mip at a time from the most expendable texture
+        while (total > Budget)
+        {
+            Entry* victim = NULL;
+            for (size_t i = 0; i < entries.size(); i++)
+                if (entries[i].streamingBase < 0 && !entries[i].uploaded && entries[i].targetBase < entries[i].levels - 1 &&
+                    (!victim || moreExpendable(entries[i], *victim)))
+                    victim = &entries[i];
+            if (!victim)
+                break;
+            total -= victim->bytes(victim->targetBase) - victim->bytes(victim->targetBase + 1);
+            victim->targetBase++;
+        }
+
+        // evictions first so memory is freed before anything grows
+        int streams = 0;
+        for (int pass = 0; pass < 2; pass++)
+            for (size_t i = 0; i < entries.size() && streams < TEXTURE_STREAMS_PER_FRAME; i++)
+            {
+                Entry &e = entries[i];
+                if (e.streamingBase < 0 && (pass == 0 ? e.targetBase > e.residentBase : e.targetBase < e.residentBase))
+                {
+                    if (pass == 0)
+                        shrink(e);
+                    else if (Uploads)
+                        stream(e);
+                    else
+                        respecify(e);
+                    streams++;
+                }
+            }
+
+        for (size_t i = 0; i < entries.size(); i++)
+            entries[i].wantedBase = entries[i].levels - 1;
+        Frame++;
+    }
+
+private:
+    struct Entry {
+        unsigned int id;
+        std::string directory, path;
+        bool srgb;
+        int desiredChannels; // as passed to load, for reading the chain again
+        int width, height, channels, levels;
+        int residentBase; // level of the chain currently uploaded as level 0
+        int targetBase;
+        int wantedBase;   // smallest level requested this frame
+        unsigned int lastUsed; // frame of the last request, 0 when never drawn
+        int streamingBase;     // base level the upload thread is reading, -1 when it isn't streaming the texture
+        GLsync uploaded;       // fence after the load's upload until it has signalled, NULL then
+
+        // GPU size from a given base level on (3 channel textures are stored padded to 4 bytes per texel)
+        size_t bytes(int base) const
+        {
+            size_t texel = channels == 3 ? 4 : channels, total = 0;
+            for (int i = base; i < levels; i++)
+                total += (size_t)std::max(1, width >> i) * std::max(1, height >> i) * texel;
+            return total;
+        }
+
+        // the texture's full chain with its level sizes and offsets, but no pixels
+        MipChain shape() const
+        {
+            MipChain chain;
+            chain.width = width;
+            chain.height = height;
+            chain.channels = channels;
+            size_t offset = 0;
+            for (int i = 0; i < levels; i++)
+            {
+                chain.offsets.push_back(offset);
+                offset += (size_t)chain.levelWidth(i) * chain.levelHeight(i) * channels;
+            }
+            return chain;
+        }
+    };
+
+    // recursive: a stream submitted from update() runs its completion inside submit when the upload thread isn't running
+    mutable std::recursive_mutex lock;
+    std::vector<Entry> entries;
+    std::map<unsigned int, size_t> index;
+    // bytes counted for each texture added with addFixed
+    std::map<unsigned int, size_t> fixed;
+
+    // unused textures and textures with more detail than their on-screen size needs go first, then the least recently
+    // used, then the largest
+    bool moreExpendable(const Entry &a, const Entry &b) const
+    {
+        bool surplusA = a.lastUsed != Frame || a.targetBase < a.wantedBase;
+        bool surplusB = b.lastUsed != Frame || b.targetBase < b.wantedBase;
+        if (surplusA != surplusB)
+            return surplusA;
+        if (a.lastUsed != b.lastUsed)
+            return a.lastUsed < b.lastUsed;
+        return a.bytes(a.targetBase) > b.bytes(b.targetBase);
+    }
+
+    // drops the top mips: the levels the texture keeps are already on the GPU, so they are copied into a pixel buffer
+    // and the texture is re-specified from it, without reading or decoding the chain again
+    void shrink(Entry &e)
+    {
+        MipChain shape = e.shape();
+        int base = e.targetBase;
+        size_t size = (size_t)shape.levelWidth(e.levels - 1) * shape.levelHeight(e.levels - 1) * e.channels + shape.offsets.back() - shape.offsets[base];
+        unsigned int buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_COPY);
+        glBindTexture(GL_TEXTURE_2D, e.id);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        for (int i = base; i < e.levels; i++)
+            glGetTexImage(GL_TEXTURE_2D, i - e.residentBase, MipChainFormat(e.channels), GL_UNSIGNED_BYTE, (void*)(shape.offsets[i] - shape.offsets[base]));
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        UploadMipChainFrom(shape, base, e.levels - e.residentBase, NULL);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glDeleteBuffers(1, &buffer);
+        resident(e, base);
+    }
+
+    // brings top mips back from the cached chain, on the render thread
+    void respecify(Entry &e)
+    {
+        MipChain chain;
+        if (!LoadMaterialChain(e.directory, e.path, e.desiredChannels, e.srgb, chain) || chain.levels() != e.levels)
+        {
+            LOG_WARN("TEXTURE_RESIDENCY:: can't stream %s, keeping its current mips", e.path);
+            e.targetBase = e.residentBase;
+            return;
+        }
+        glBindTexture(GL_TEXTURE_2D, e.id);
+        UploadMipChainFrom(chain, e.targetBase, e.levels - e.residentBase, chain.level(e.targetBase));
+        glBindTexture(GL_TEXTURE_2D, 0);
+        resident(e, e.targetBase);
+    }
+
+    // respecify on the upload thread: the levels are read there and copied into a pixel buffer, and once they are on
+    // the GPU the render thread re-specifies the texture from it, a copy that doesn't go through the CPU. The texture
+    // keeps its id, so the meshes using it don't need to know; it keeps its current mips until then.
+    void stream(Entry &e)
+    {
+        e.streamingBase = e.targetBase;
+        unsigned int id = e.id;
+        std::string directory = e.directory, path = e.path;
+        bool srgb = e.srgb;
+        int desiredChannels = e.desiredChannels, levels = e.levels, base = e.targetBase;
+        Uploads->submit([this, id, directory, path, srgb, desiredChannels, levels, base]() -> UploadThread::Completion {
+            MipChain chain;
+            unsigned int buffer = 0;
+            if (LoadMaterialChain(directory, path, desiredChannels, srgb, chain) && chain.levels() == levels)
+            {
+                glGenBuffers(1, &buffer);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, chain.data.size() - chain.offsets[base], chain.level(base), GL_STREAM_DRAW);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                // the render thread only needs the level sizes
+                std::vector<unsigned char>().swap(chain.data);
+            }
+            return [this, id, chain, buffer, base]() { streamed(id, chain, buffer, base); };
+        });
+    }
+
+    // the levels of a stream are in the pixel buffer (0 when they couldn't be read)
+    void streamed(unsigned int id, const MipChain &chain, unsigned int buffer, int base)
+    {
+        std::lock_guard<std::recursive_mutex> guard(lock);
+        std::map<unsigned int, size_t>::iterator it = index.find(id);
+        // the texture was released meanwhile, and its id maybe reused
+        if (it == index.end() || entries[it->second].streamingBase != base)
+        {
+            glDeleteBuffers(1, &buffer);
+            return;
+        }
+        Entry &e = entries[it->second];
+        e.streamingBase = -1;
+        if (!buffer)
+        {
+            LOG_WARN("TEXTURE_RESIDENCY:: can't stream %s, keeping its current mips", e.path);
+            e.targetBase = e.residentBase;
+            return;
+        }
+        glBindTexture(GL_TEXTURE_2D, e.id);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        UploadMipChainFrom(chain, base, e.levels - e.residentBase, NULL);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        // GL frees the buffer once the texture has been copied from it
+        glDeleteBuffers(1, &buffer);
+        resident(e, base);
+    }
+
+    // the texture's levels from base on are uploaded
+    void resident(Entry &e, int base)
+    {
+        LOG_DEBUG("TEXTURE_RESIDENCY:: %s now %dx%d (%s)", e.path, std::max(1, e.width >> base), std::max(1, e.height >> base),
+                  base > e.residentBase ? "evicted" : "streamed in");
+        ResidentBytes += e.bytes(base);
+        ResidentBytes -= e.bytes(e.residentBase);
+        e.residentBase = base;
+    }
+};
+#endif
@@ -0,0 +1,164 @@
+#ifndef UPLOAD_THREAD_H
+#define UPLOAD_THREAD_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/log.h>
+
+#include <deque>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Uploads GL data on a thread of its own, so reading, decoding and copying assets into GPU memory doesn't cost the
+// render thread a frame. The thread has a context shared with the window's (on a hidden window), runs the submitted
+// jobs in order and puts a fence after each one; poll() hands a job's result to the render thread once its fence has
+// signalled, that is once everything the job sent to the GPU is there. Buffers and textures are shared between the
+// contexts, vertex arrays and framebuffers are not: jobs only make the former, and the renderer binds them again
+// after taking them over, which is what makes another context's changes visible to its own. Texture streaming
+// (texture_residency.h) and asset reimports (asset_database.h: meshes, textures, packed arrays, shaders) run on it.
+class UploadThread
+{
+public:
+    // what the render thread does with a job's objects once they are uploaded
+    typedef std::function<void()> Completion;
+    // runs on the upload context and returns its completion (empty when there is nothing to hand over)
+    typedef std::function<Completion()> Job;
+
+    UploadThread() : window(NULL), running(false) {}
+
+    ~UploadThread()
+    {
+        stop();
+    }
+
+    UploadThread(const UploadThread &) = delete;
+    UploadThread &operator=(const UploadThread &) = delete;
+
+    // makes the upload context, shared with the one of the given window, and starts the thread. Call it on the main
+    // thread after the window's context is set up; the window hints in effect give the context the same version.
+    // Without it (false) jobs run on the render thread inside submit, as they did before.
+    bool start(GLFWwindow *shared)
+    {
+        if (running)
+            return true;
+        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+        window = glfwCreateWindow(1, 1, "uploads", NULL, shared);
+        glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+        if (!window)
+        {
+            LOG_WARN("UPLOADS:: could not create a shared context, uploading on the render thread");
+            return false;
+        }
+        running = true;
+        worker = std::thread([this]() { run(); });
+        return true;
+    }
+
+    bool threaded() const
+    {
+        return running;
+    }
+
+    void submit(const Job &job)
+    {
+        if (!running)
+        {
+            Completion done = job();
+            if (done)
+                done();
+            return;
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        jobs.push_back(job);
+        wake.notify_one();
+    }
+
+    // runs the completions of the jobs whose uploads have reached the GPU, in submission order; call it once a frame
+    // on the render thread
+    void poll()
+    {
+        std::vector<Completion> ready;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            while (!finished.empty() && glClientWaitSync(finished.front().fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+            {
+                glDeleteSync(finished.front().fence);
+                ready.push_back(finished.front().done);
+                finished.pop_front();
+            }
+        }
+        // outside the lock: completions may submit more work
+        for (size_t i = 0; i < ready.size(); i++)
+            if (ready[i])
+                ready[i]();
+    }
+
+    // finishes the queued jobs, runs every completion and destroys the upload context; on the main thread, before
+    // the window's context goes away
+    void stop()
+    {
+        if (!running)
+            return;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            running = false;
+            wake.notify_one();
+        }
+        worker.join();
+        for (size_t i = 0; i < finished.size(); i++)
+        {
+            glClientWaitSync(finished[i].fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(finished[i].fence);
+            if (finished[i].done)
+                finished[i].done();
+        }
+        finished.clear();
+        glfwDestroyWindow(window);
+        window = NULL;
+    }
+
+private:
+    struct Finished {
+        GLsync fence;
+        Completion done;
+    };
+
+    GLFWwindow *window;
+    bool running;
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<Job> jobs;
+    std::deque<Finished> finished;
+
+    void run()
+    {
+        glfwMakeContextCurrent(window);
+        for (;;)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [this]() { return !jobs.empty() || !running; });
+                // the queue is drained before the thread stops
+                if (jobs.empty())
+                    break;
+                job = jobs.front();
+                jobs.pop_front();
+            }
+            Finished result;
+            result.done = job();
+            result.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            // without a flush the fence may never reach the GPU, and the render thread would wait on it forever
+            glFlush();
+            std::lock_guard<std::mutex> guard(lock);
+            finished.push_back(result);
+        }
+        glfwMakeContextCurrent(NULL);
+    }
+};
+#endif
@@ -2,10 +2,193 @@
 out vec4 FragColor;
 
 in vec2 TexCoords;
+in vec3 WorldPos;
+in vec3 Normal;
+in vec3 CamPos;
+#ifdef HAS_NORMAL_MAP
+in vec3 Tangent;
+in vec3 Bitangent;
+#endif
 
+// materials without a specular map reflect like the Ks 0.5 of the bundled .mtl files
+const vec3 DEFAULT_SPECULAR = vec3(0.5);
+
+#ifdef HAS_IBL
+// image based lighting (see ibl.h). The nanosuit has no PBR maps, so every surface is a rough dielectric.
+uniform samplerCube irradianceMap;
+uniform samplerCube prefilterMap;
+uniform sampler2D brdfLUT;
+uniform float prefilterMaxLod;
+const float IBL_ROUGHNESS = 0.5;
+const vec3 IBL_F0 = vec3(0.04);
+
+// lights the (sRGB) base colour with the environment and returns it tone mapped and gamma encoded again. The specular
+// map scales the glossy reflection, the reflection map adds a mirror one on top.
+vec3 environmentLighting(vec3 baseColor, vec3 N, vec3 specularColor, float reflectivity)
+{
+    vec3 albedo = pow(baseColor, vec3(2.2));
+    vec3 V = normalize(CamPos - WorldPos);
+    vec3 R = reflect(-V, N);
+    float NdotV = max(dot(N, V), 0.0);
+
+    vec3 F = IBL_F0 + (max(vec3(1.0 - IBL_ROUGHNESS), IBL_F0) - IBL_F0) * pow(1.0 - NdotV, 5.0);
+    vec3 diffuse = (1.0 - F) * texture(irradianceMap, N).rgb * albedo;
+    vec2 brdf = texture(brdfLUT, vec2(NdotV, IBL_ROUGHNESS)).rg;
+    vec3 specular = textureLod(prefilterMap, R, IBL_ROUGHNESS * prefilterMaxLod).rgb * (F * brdf.x + brdf.y) * specularColor / DEFAULT_SPECULAR;
+    vec3 mirror = textureLod(prefilterMap, R, 0.0).rgb * reflectivity;
+
+    vec3 color = diffuse + specular + mirror;
+    color = color / (color + vec3(1.0));
+    return pow(color, vec3(1.0 / 2.2));
+}
+#else
+// without IBL: a white directional light from above and in front of the scene, plus a dim ambient light. The specular
+// map scales its highlight, the reflection map adds the sharp glint a mirror would show of it.
+const vec3 LIGHT_DIRECTION = normalize(vec3(0.3, 0.6, 0.75)); // towards the light
+const float LIGHT_AMBIENT = 0.3;
+const float SHININESS = 32.0;
+const float MIRROR_SHININESS = 512.0;
+
+vec3 directLighting(vec3 baseColor, vec3 N, vec3 specularColor, float reflectivity)
+{
+    vec3 V = normalize(CamPos - WorldPos);
+    vec3 H = normalize(LIGHT_DIRECTION + V);
+    float diffuse = max(dot(N, LIGHT_DIRECTION), 0.0);
+    float NdotH = diffuse > 0.0 ? max(dot(N, H), 0.0) : 0.0;
+    vec3 specular = specularColor * pow(NdotH, SHININESS) + vec3(reflectivity * pow(NdotH, MIRROR_SHININESS));
+    return baseColor * (LIGHT_AMBIENT + (1.0 - LIGHT_AMBIENT) * diffuse) + specular;
+}
+#endif
+
+#ifdef HAS_TEXTURE_ARRAYS
+// per-draw records of the packed path (see texture_packer.h, MAX_PACKED_DRAWS). One component per texture type,
+// in the order diffuse, specular, normal, height. layers: >= 0 array layer, -1 in atlas at atlasRects, -2 no texture;
+// channels: the channel a channel packed map is in, -1 for the texel's colour
+struct DrawMaterial {
+    ivec4 layers;
+    ivec4 channels;
+    vec4 atlasRects[4];
+};
+layout (std140) uniform DrawMaterials {
+    DrawMaterial materials[128];
+};
+uniform int drawIndex;
+
+// a texel of the draw's texture of one type: from its layer of the type's array, or from its rectangle of the atlas
+vec4 packedTexel(int type, sampler2DArray array, sampler2D atlas)
+{
+    int layer = materials[drawIndex].layers[type];
+    if (layer >= 0)
+        return texture(array, vec3(TexCoords, layer));
+    // atlas entries repeat inside their rectangle; the gradients of the unwrapped coordinates keep mip selection
+    // continuous across the wrap
+    vec4 rect = materials[drawIndex].atlasRects[type];
+    return textureGrad(atlas, rect.xy + fract(TexCoords) * rect.zw, dFdx(TexCoords) * rect.zw, dFdy(TexCoords) * rect.zw);
+}
+#endif
+
+// grayscale maps may share a texture, one map per channel (see channel_pack.h): such a map reads as gray from its
+// channel, other maps read their colour
+vec3 mapTexel(vec4 texel, int channel)
+{
+    return channel >= 0 ? vec3(texel[channel]) : texel.rgb;
+}
+
+#ifdef HAS_DIFFUSE_MAP
+#ifdef HAS_TEXTURE_ARRAYS
+uniform sampler2DArray texture_diffuse_array;
+uniform sampler2D texture_diffuse_atlas;
+#define DIFFUSE_TEXEL packedTexel(0, texture_diffuse_array, texture_diffuse_atlas)
+#else
 uniform sampler2D texture_diffuse1;
+#define DIFFUSE_TEXEL texture(texture_diffuse1, TexCoords)
+#endif
+#endif
+
+#ifdef HAS_SPECULAR_MAP
+#ifdef HAS_TEXTURE_ARRAYS
+uniform sampler2DArray texture_specular_array;
+uniform sampler2D texture_specular_atlas;
+#define SPECULAR_TEXEL mapTexel(packedTexel(1, texture_specular_array, texture_specular_atlas), materials[drawIndex].channels[1])
+#else
+uniform sampler2D texture_specular1;
+uniform int texture_specular1_channel;
+#define SPECULAR_TEXEL mapTexel(texture(texture_specular1, TexCoords), texture_specular1_channel)
+#endif
+#endif
+
+// tangent space normal maps (map_Bump of the .mtl files)
+#ifdef HAS_NORMAL_MAP
+#ifdef HAS_TEXTURE_ARRAYS
+uniform sampler2DArray texture_normal_array;
+uniform sampler2D texture_normal_atlas;
+#define NORMAL_TEXEL packedTexel(2, texture_normal_array, texture_normal_atlas)
+#else
+uniform sampler2D texture_normal1;
+#define NORMAL_TEXEL texture(texture_normal1, TexCoords)
+#endif
+#endif
+
+// the models' texture_height maps are their reflection maps (map_Ka of the .mtl files, grayscale): how mirror-like the
+// surface is
+#ifdef HAS_HEIGHT_MAP
+#ifdef HAS_TEXTURE_ARRAYS
+uniform sampler2DArray texture_height_array;
+uniform sampler2D texture_height_atlas;
+#define HEIGHT_TEXEL mapTexel(packedTexel(3, texture_height_array, texture_height_atlas), materials[drawIndex].channels[3])
+#else
+uniform sampler2D texture_height1;
+uniform int texture_height1_channel;
+#define HEIGHT_TEXEL mapTexel(texture(texture_height1, TexCoords), texture_height1_channel)
+#endif
+#endif
+
+#ifdef HAS_NORMAL_MAP
+// the tangent space normal of a normal map texel. Some maps (the nanosuit's) are stored gamma encoded, so of the two
+// decodes the one giving a unit normal is taken.
+vec3 mapNormal(vec3 texel)
+{
+    vec3 linear = texel * 2.0 - 1.0;
+    vec3 encoded = pow(texel, vec3(2.2)) * 2.0 - 1.0;
+    return abs(dot(encoded, encoded) - 1.0) < abs(dot(linear, linear) - 1.0) ? encoded : linear;
+}
+#endif
+
+// the shading normal: the interpolated one, bent by the normal map when there is one (and tangents to map it with)
+vec3 surfaceNormal()
+{
+    vec3 N = normalize(Normal);
+#ifdef HAS_NORMAL_MAP
+    if (dot(Tangent, Tangent) > 0.0)
+    {
+        mat3 TBN = mat3(normalize(Tangent), normalize(Bitangent), N);
+        N = normalize(TBN * mapNormal(NORMAL_TEXEL.rgb));
+    }
+#endif
+    return gl_FrontFacing ? N : -N;
+}
 
 void main()
-{    
-    FragColor = texture(texture_diffuse1, TexCoords);
-}
\ No newline at end of file
+{
+#ifdef HAS_DIFFUSE_MAP
+    vec4 color = DIFFUSE_TEXEL;
+#else
+    vec4 color = vec4(0.8, 0.8, 0.8, 1.0);
+#endif
+#ifdef HAS_SPECULAR_MAP
+    vec3 specularColor = SPECULAR_TEXEL;
+#else
+    vec3 specularColor = DEFAULT_SPECULAR;
+#endif
+#ifdef HAS_HEIGHT_MAP
+    float reflectivity = HEIGHT_TEXEL.r;
+#else
+    float reflectivity = 0.0;
+#endif
+#ifdef HAS_IBL
+    color.rgb = environmentLighting(color.rgb, surfaceNormal(), specularColor, reflectivity);
+#else
+    color.rgb = directLighting(color.rgb, surfaceNormal(), specularColor, reflectivity);
+#endif
+    FragColor = color;
+}
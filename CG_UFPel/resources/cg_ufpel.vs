@@ -2,8 +2,17 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec4 aTangent; // w: glTF handedness, 1 for the other meshes' vec3 tangents
+layout (location = 4) in vec3 aBitangent;
 
 out vec2 TexCoords;
+out vec3 WorldPos;
+out vec3 Normal;
+out vec3 CamPos;
+#ifdef HAS_NORMAL_MAP
+out vec3 Tangent;
+out vec3 Bitangent;
+#endif
 
 uniform mat4 model;
 uniform mat4 view;
@@ -11,6 +20,15 @@ uniform mat4 projection;
 
 void main()
 {
-    TexCoords = aTexCoords;    
+    TexCoords = aTexCoords;
+    WorldPos = vec3(model * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+#ifdef HAS_NORMAL_MAP
+    // glTF meshes have no bitangent (the attribute reads as zero): it is rebuilt from the normal
+    Tangent = mat3(model) * aTangent.xyz;
+    Bitangent = mat3(model) * (dot(aBitangent, aBitangent) > 0.0 ? aBitangent : cross(aNormal, aTangent.xyz) * aTangent.w);
+#endif
+    // the view matrix is rigid, so the camera position is its inverse translation
+    CamPos = -transpose(mat3(view)) * view[3].xyz;
     gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+}
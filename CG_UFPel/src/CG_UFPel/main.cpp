@@ -10,46 +10,73 @@
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/golden.h>
+#include <learnopengl/replay.h>
+#include <learnopengl/log.h>
+#include <learnopengl/ibl.h>
+#include <learnopengl/skybox.h>
+#include <learnopengl/asset_database.h>
+#include <learnopengl/scene.h>
 
 #include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <chrono>
+#include <memory>
 
 #include <cmath>
 
-#define N_MODELOS 3
-#define N_CAMERAS 3
 #define N_PASSOS_MODELO 4
 #define N_PASSOS_CAMERA 4
+// PSNR mnimo (dB) para um frame ser aceito contra a imagem de referncia
+#define GOLDEN_PSNR_MIN 40.0
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(Shader s, Model m, GLFWwindow *window);
+void processInput(Shader &s, GLFWwindow *window);
 
 // funes modelo
-void escala(Shader s, Model m, GLFWwindow* window, float tempo);
-void translacao(Shader s, Model m, GLFWwindow* window, float tempo);
-void bezier(Shader s, Model m, GLFWwindow* window, float tempo, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2);
-void rotacao(Shader s, Model m, GLFWwindow* window, float tempo);
-void rotacaoPonto(Shader s, Model m, GLFWwindow* window, float tempo, glm::vec3 p);
-void animacao(Shader s, Model m, GLFWwindow* window, float tempoTotal);
+void escala(Shader &s, GLFWwindow* window, float tempo);
+void translacao(Shader &s, GLFWwindow* window, float tempo);
+void bezier(Shader &s, GLFWwindow* window, float tempo, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2);
+void rotacao(Shader &s, GLFWwindow* window, float tempo);
+void rotacaoPonto(Shader &s, GLFWwindow* window, float tempo, glm::vec3 p);
+void animacao(Shader &s, GLFWwindow* window, float tempoTotal);
 // funes camera
-void translacaoCamera(Shader s, Model m, GLFWwindow* window, float tempo);
-void bezierCamera(Shader s, Model m, GLFWwindow* window, float tempo, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2);
-void rotacaoCamera(Shader s, Model m, GLFWwindow* window, float tempo);
-void rotacaoPontoCamera(Shader s, Model m, GLFWwindow* window, float tempo, glm::vec3 p);
-void zoomCamera(Shader s, Model m, GLFWwindow* window, float tempo);
-void ruidoCamera(Shader s, Model m, GLFWwindow* window, float tempo);
-void lookPontoCamera(Shader s, Model m, GLFWwindow* window, float tempo, glm::vec3 p);
-void lookModeloCamera(Shader s, Model m, GLFWwindow* window, float tempo, int modelo);
-void animacaoCamera(Shader s, Model m, GLFWwindow* window, float tempoTotal);
+void translacaoCamera(Shader &s, GLFWwindow* window, float tempo);
+void bezierCamera(Shader &s, GLFWwindow* window, float tempo, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2);
+void rotacaoCamera(Shader &s, GLFWwindow* window, float tempo);
+void rotacaoPontoCamera(Shader &s, GLFWwindow* window, float tempo, glm::vec3 p);
+void zoomCamera(Shader &s, GLFWwindow* window, float tempo);
+void ruidoCamera(Shader &s, GLFWwindow* window, float tempo);
+void lookPontoCamera(Shader &s, GLFWwindow* window, float tempo, glm::vec3 p);
+void lookModeloCamera(Shader &s, GLFWwindow* window, float tempo, Entity modelo);
+void animacaoCamera(Shader &s, GLFWwindow* window, float tempoTotal);
+// regresso por imagens de referncia
+int renderGolden(Shader &s, bool atualiza);
+#ifdef LOGL_BENCHMARKS
+// confere que desenhar a cena no aloca memria do heap
+int verificaDesenho(Shader &s);
+#endif
+// cu: desenhado por ltimo em cada frame com a cmera definida no frame
+void defineCamera(Shader &s, const glm::mat4 &projection, const glm::mat4 &view);
+void desenhaCeu();
+// desenha as malhas de um n de modelo e informa o tamanho delas na tela ao gerenciador de texturas
+void desenhaModelo(Shader &s, const RenderMesh &r, const glm::mat4 &model);
+// atualiza a cena e desenha as entidades com modelo que esto na vista; retorna quantas foram desenhadas
+size_t desenhaCena(Shader &s);
+// cu e streaming de texturas no fim de cada frame
+void terminaFrame();
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
-// camera
-int cameraAtual = 0;
-Camera camera[N_CAMERAS] = { glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.75f, 0.25f, 5.0f), glm::vec3(-0.25f, 0.5f, 4.0f) };
+// camera: a entidade da cena cuja cmera  usada
+Entity cameraAtual = NoEntity;
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
@@ -59,14 +86,186 @@ float currentFrame = 0.0f;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-// MODELO
-int modeloAtual = 0;
-// escala inicial 0.05
-glm::vec3 escalas[N_MODELOS] = { glm::vec3(0.05f), glm::vec3(0.05f), glm::vec3(0.05f) };
-glm::vec3 pAtuais[N_MODELOS] = { glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.5f, 0.0f, 0.0f), glm::vec3(-0.5f, 0.0f, 0.0f) };
+// CENA: modelos e cmeras so entidades, e posio, rotao e escala, o modelo desenhado, a esfera envolvente e a
+// cmera so componentes guardados cada um num array contguo
+Scene cena;
+
+Camera &cameraAtiva() {
+	return cena.Cameras.get(cameraAtual);
+}
+
+// MODELO: a entidade que as animaes movem
+Entity modeloAtual = NoEntity;
+// as razes das instncias do modelo; os ns dele ficam abaixo delas na hierarquia da cena
+std::vector<Entity> instancias;
+
+// relgio, teclado e rudo passam pelo replay para que uma sesso gravada possa ser repetida exatamente
+Replay replay;
+
+// CU
+Skybox ceu;
+glm::mat4 projecaoAtual, viewAtual;
+
+// TEXTURAS: memria de vdeo limitada, mips de cima descartados das texturas distantes ou sem uso
+TextureResidency residencia;
+// ENVIOS: os mips que a residncia traz de volta so lidos e enviados  GPU numa thread com contexto compartilhado
+UploadThread envios;
+
+#ifdef LOGL_BENCHMARKS
+// ALOCAES: nas compilaes com LOGL_BENCHMARKS toda alocao do heap  contada, para o --bench-import comparar a
+// importao com e sem arenas
+void* operator new(std::size_t tamanho) {
+	HeapAllocations++;
+	if (void* p = std::malloc(tamanho ? tamanho : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+// informa as alocaes do heap e o tempo de importar um modelo com os temporrios da importao no heap e em arenas
+// (--bench-import); o cache de malhas no  usado
+void BenchmarkImport(const std::string &caminho) {
+	const int RODADAS = 3;
+	bool usavaArenas = ImportArenasEnabled;
+	unsigned long long alocacoes[2];
+	double ms[2];
+	for (int modo = 0; modo < 2; modo++) {
+		ImportArenasEnabled = modo == 1;
+		// uma carga antes, para o arquivo j estar mapeado e as threads aquecidas
+		{
+			ObjScene aquecimento;
+			if (!ObjLoader::Load(caminho, aquecimento, false)) {
+				LOG_WARN("IMPORT:: can't load %s", caminho);
+				ImportArenasEnabled = usavaArenas;
+				return;
+			}
+		}
+		unsigned long long antes = HeapAllocations;
+		std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now();
+		for (int rodada = 0; rodada < RODADAS; rodada++) {
+			ObjScene importada;
+			ObjLoader::Load(caminho, importada, false);
+		}
+		ms[modo] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - inicio).count() / RODADAS;
+		alocacoes[modo] = (HeapAllocations - antes) / RODADAS;
+	}
+	ImportArenasEnabled = usavaArenas;
+	LOG_INFO("IMPORT:: %s: %llu heap allocations in %.1f ms without arenas, %llu in %.1f ms with them", caminho,
+	         alocacoes[0], ms[0], alocacoes[1], ms[1]);
+}
+#endif
 
-int main()
+int main(int argc, char** argv)
 {
+    // --golden renders the fixed camera poses offscreen and compares them to resources/golden/*.ppm,
+    // --golden-update writes the frames as golden_camera<n>.ppm in the working directory instead, to be copied over them
+    bool modoGolden = false;
+    bool atualizaGolden = false;
+    // --no-texture-arrays keeps the per-mesh texture binds (for A/B comparisons against the packed path)
+    bool empacotaTexturas = true;
+    // --ibl lights the models with the environment of newport_loft.hdr
+    bool usaIBL = false;
+    // --texture-budget <MB> limits the memory of the model textures, skybox and environment maps together
+    // (only the per-mesh textures shrink, so it works best with --no-texture-arrays)
+    // --bench-mesh-cache logs the mesh cache's compression ratio and decode speed for the bundled models and exits
+    // --bench-scene <n> logs how long the scene's systems take to update n entities in hierarchies, moving and static, and exits
+    // --bench-import logs the heap allocations and time of importing the bundled models with and without arenas, and exits
+    // --check-draw draws the first camera's view a few times offscreen and fails when drawing the scene allocates
+    // (both only in builds configured with LOGL_BENCHMARKS, which count the allocations)
+    // --assimp reads the .obj models through Assimp instead of the native loader (for A/B comparisons)
+    // --sync-uploads streams the textures on the render thread instead of the upload thread (for A/B comparisons)
+    // --pin-threads pins the job system's workers to one core each
+    // --bench-jobs logs how building a mip chain and importing the bundled models scale with the job system's threads, and exits
+    // --record <log> saves input and frame times, --replay <log> plays them back,
+    // --fixed-step <s> uses a fixed timestep instead of the wall clock (record) or the recorded times (replay)
+    const char* arquivoGravacao = NULL;
+    const char* arquivoReplay = NULL;
+    float passoFixo = 0.0f;
+    bool enviosSincronos = false;
+    bool modoVerificacao = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--golden") == 0)
+            modoGolden = true;
+        else if (std::strcmp(argv[i], "--golden-update") == 0)
+            modoGolden = atualizaGolden = true;
+        else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            arquivoGravacao = argv[++i];
+        else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            arquivoReplay = argv[++i];
+        else if (std::strcmp(argv[i], "--fixed-step") == 0 && i + 1 < argc)
+            passoFixo = (float)std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--no-texture-arrays") == 0)
+            empacotaTexturas = false;
+        else if (std::strcmp(argv[i], "--ibl") == 0)
+            usaIBL = true;
+        else if (std::strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+            residencia.Budget = (size_t)std::atof(argv[++i]) << 20;
+        else if (std::strcmp(argv[i], "--assimp") == 0)
+            ModelForceAssimp = true;
+        else if (std::strcmp(argv[i], "--sync-uploads") == 0)
+            enviosSincronos = true;
+        else if (std::strcmp(argv[i], "--pin-threads") == 0)
+            Jobs.start(JobSystem::DefaultWorkers(), true);
+        else if (std::strcmp(argv[i], "--bench-jobs") == 0) {
+            std::vector<unsigned char> imagem((size_t)2048 * 2048 * 4);
+            for (size_t p = 0; p < imagem.size(); p++)
+                imagem[p] = (unsigned char)(p * 2654435761u >> 24);
+            BenchmarkJobs("mip chain 2048x2048", [&]() {
+                MipChain cadeia;
+                BuildMipChain(&imagem[0], 2048, 2048, 4, true, cadeia);
+            });
+            const char* modelos[] = { "nanosuit", "cyborg", "planet", "rock" };
+            for (int m = 0; m < 4; m++) {
+                std::string caminho = FileSystem::getPath(std::string("resources/objects/") + modelos[m] + "/" + modelos[m] + ".obj");
+                BenchmarkJobs(("import " + caminho).c_str(), [&]() {
+                    ObjScene importada;
+                    ObjLoader::Load(caminho, importada, false);
+                });
+            }
+            return 0;
+        }
+        else if (std::strcmp(argv[i], "--bench-mesh-cache") == 0) {
+            const char* modelos[] = { "nanosuit", "cyborg", "planet", "rock" };
+            for (int m = 0; m < 4; m++)
+                BenchmarkMeshCache(FileSystem::getPath(std::string("resources/objects/") + modelos[m] + "/" + modelos[m] + ".obj"));
+            return 0;
+        }
+        else if (std::strcmp(argv[i], "--bench-scene") == 0 && i + 1 < argc) {
+            BenchmarkScene((size_t)std::atof(argv[++i]));
+            return 0;
+        }
+        else if (std::strcmp(argv[i], "--bench-import") == 0) {
+#ifdef LOGL_BENCHMARKS
+            const char* modelos[] = { "nanosuit", "cyborg", "planet", "rock" };
+            for (int m = 0; m < 4; m++)
+                BenchmarkImport(FileSystem::getPath(std::string("resources/objects/") + modelos[m] + "/" + modelos[m] + ".obj"));
+            return 0;
+#else
+            LOG_ERROR("IMPORT:: --bench-import needs a build configured with -DLOGL_BENCHMARKS=ON");
+            return 1;
+#endif
+        }
+        else if (std::strcmp(argv[i], "--check-draw") == 0) {
+#ifdef LOGL_BENCHMARKS
+            modoVerificacao = true;
+#else
+            LOG_ERROR("DRAW:: --check-draw needs a build configured with -DLOGL_BENCHMARKS=ON");
+            return 1;
+#endif
+        }
+    }
+    // golden images are always produced by the software rasterizer so they don't depend on the GPU driver
+    if (modoGolden) {
+#ifdef _WIN32
+        _putenv_s("LIBGL_ALWAYS_SOFTWARE", "1");
+#else
+        setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+#endif
+    }
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -77,13 +276,15 @@ int main()
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
 #endif
+    if (modoGolden || modoVerificacao)
+        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
 
     // glfw window creation
     // --------------------
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
     if (window == NULL)
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
+        LOG_ERROR("Failed to create GLFW window");
         glfwTerminate();
         return -1;
     }
@@ -99,99 +300,363 @@ int main()
     // ---------------------------------------
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
+        LOG_ERROR("Failed to initialize GLAD");
         return -1;
     }
 
     // configure global opengl state
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
+    // shader e modelo so importados pelo banco de assets, que guarda os arquivos que cada um leu (.obj, .mtl,
+    // texturas, fontes do shader): quando um deles muda, s o que depende dele  reimportado
+    AssetDatabase assets;
+    // a thread de envio l e envia  GPU os mips do streaming e os assets reimportados, que entram na cena entre dois
+    // frames quando chegam; as imagens de referncia no usam nenhum dos dois,
+    // nem a verificao do desenho, que conta as alocaes de todas as threads
+    if (!modoGolden && !modoVerificacao && !enviosSincronos && envios.start(window)) {
+        residencia.Uploads = &envios;
+        assets.Uploads = &envios;
+    }
 
     // build and compile shaders
     // -------------------------
-    Shader ourShader(FileSystem::getPath("resources/cg_ufpel.vs").c_str(), FileSystem::getPath("resources/cg_ufpel.fs").c_str());
+    std::string caminhoVS = FileSystem::getPath("resources/cg_ufpel.vs");
+    std::string caminhoFS = FileSystem::getPath("resources/cg_ufpel.fs");
+    Shader ourShader;
+    assets.add(caminhoVS, [&]() -> AssetDatabase::Swap {
+        std::shared_ptr<Shader> novo(new Shader());
+        if (!Shader::prepare(caminhoVS.c_str(), caminhoFS.c_str(), *novo))
+            return AssetDatabase::Swap();
+        return [&ourShader, novo]() { return ourShader.swapIn(*novo); };
+    });
+
+    // iluminao do ambiente: mapas pr-calculados na primeira execuo e lidos do cache nas seguintes
+    IBL ibl;
+    if (usaIBL && ibl.load(FileSystem::getPath("resources/textures/hdr/newport_loft.hdr"))) {
+        ourShader.enableFeatures(SHADER_IBL);
+        ibl.bind(ourShader);
+    }
+    // cu: as seis faces so decodificadas em paralelo e ficam comprimidas no cache para as prximas execues
+    std::vector<std::string> faces;
+    const char* nomesFaces[6] = { "right", "left", "top", "bottom", "front", "back" };
+    for (int i = 0; i < 6; i++)
+        faces.push_back(FileSystem::getPath(std::string("resources/textures/skybox/") + nomesFaces[i] + ".jpg"));
+    ceu.load(faces, FileSystem::getPath("resources/skybox.vs").c_str(), FileSystem::getPath("resources/skybox.fs").c_str());
+    // o que no  gerenciado pela residncia tambm conta no oramento, antes do modelo decidir se as texture arrays cabem nele
+    if (ceu.Ready)
+        residencia.addFixed(GL_TEXTURE_CUBE_MAP, ceu.Cubemap);
+    if (ibl.Ready) {
+        residencia.addFixed(GL_TEXTURE_CUBE_MAP, ibl.IrradianceMap);
+        residencia.addFixed(GL_TEXTURE_CUBE_MAP, ibl.PrefilterMap);
+        residencia.addFixed(GL_TEXTURE_2D, ibl.BRDFLUT);
+    }
 
     // load models
     // -----------
-    Model ourModel(FileSystem::getPath("resources/objects/nanosuit/nanosuit.obj"));
+    std::string caminhoModelo = FileSystem::getPath("resources/objects/nanosuit/nanosuit.obj");
+    Model ourModel;
+    // cena inicial: trs instncias do modelo, em escala 0.05, e trs cmeras
+    const glm::vec3 posicoesModelos[] = { glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.5f, 0.0f, 0.0f), glm::vec3(-0.5f, 0.0f, 0.0f) };
+    for (int i = 0; i < 3; i++) {
+        Entity e = cena.create();
+        cena.Transforms.add(e, posicoesModelos[i], glm::quat(), glm::vec3(0.05f));
+        instancias.push_back(e);
+    }
+    const glm::vec3 posicoesCameras[] = { glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.75f, 0.25f, 5.0f), glm::vec3(-0.25f, 0.5f, 4.0f) };
+    for (int i = 0; i < 3; i++)
+        cena.Cameras.add(cena.create(), Camera(posicoesCameras[i]));
+    modeloAtual = instancias[0];
+    cameraAtual = cena.Cameras.entity(0);
+    assets.add(caminhoModelo, [&]() -> AssetDatabase::Swap {
+        std::shared_ptr<Model> novo(new Model(caminhoModelo, false, &residencia));
+        if (novo->meshes.empty())
+            return AssetDatabase::Swap();
+        // agrupa as texturas do modelo em texture arrays: um nico conjunto de binds por modelo
+        if (empacotaTexturas)
+            novo->PackTextures();
+        // o resto  feito na thread de render: os vertex arrays no so compartilhados entre contextos
+        return [&, novo]() {
+            novo->CreateVertexArrays();
+            ourModel = std::move(*novo);
+            // compila de uma vez as variantes de shader que os materiais do modelo usam
+            ourShader.prepareVariants(ourModel.VariantKeys());
+            // os ns do modelo antigo saem da cena e os do novo entram abaixo de cada instncia
+            for (size_t i = 0; i < instancias.size(); i++) {
+                cena.destroyDescendants(instancias[i]);
+                cena.instantiate(&ourModel, instancias[i]);
+            }
+            return true;
+        };
+    });
+    LOG_INFO("TEXTURAS:: %.1f MB gerenciados + %.1f MB fixos, oramento %.1f MB", residencia.ResidentBytes / 1048576.0, residencia.FixedBytes / 1048576.0, residencia.Budget / 1048576.0);
+    // os destrutores liberam a memria de GPU, mas o modelo e o shader vivem at o fim do main: liberados antes do contexto
+    auto liberaGL = [&]() {
+        envios.stop();
+        ourModel.release();
+        ourShader.release();
+        ceu.release();
+        ibl.release();
+    };
+    if (modoGolden) {
+        int falhas = renderGolden(ourShader, atualizaGolden);
+        liberaGL();
+        glfwTerminate();
+        return falhas;
+    }
+#ifdef LOGL_BENCHMARKS
+    if (modoVerificacao) {
+        int falhas = verificaDesenho(ourShader);
+        liberaGL();
+        glfwTerminate();
+        return falhas;
+    }
+#endif
     
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+    // record/replay starts after loading so only the session itself is timed
+    replay.setCallbacks(mouse_callback, scroll_callback);
+    if (arquivoReplay != NULL && !replay.startPlayback(arquivoReplay, passoFixo)) {
+        liberaGL();
+        glfwTerminate();
+        return -1;
+    }
+    else if (arquivoGravacao != NULL && !replay.startRecording(arquivoGravacao, passoFixo)) {
+        liberaGL();
+        glfwTerminate();
+        return -1;
+    }
+
+    // edies nos arquivos dos assets so aplicadas com o programa rodando
+    assets.watch();
+
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
     {
         // per-frame time logic
-        currentFrame = glfwGetTime();
+        currentFrame = replay.getTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
         // input
-        processInput(ourShader, ourModel, window);
+        processInput(ourShader, window);
         // render
         glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         // don't forget to enable shader before setting uniforms
         ourShader.use();
         // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera[cameraAtual].Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera[cameraAtual].GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
+        glm::mat4 projection = glm::perspective(glm::radians(cameraAtiva().Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 view = cameraAtiva().GetViewMatrix();
+        defineCamera(ourShader, projection, view);
 		// render the loaded model
-		for (int i = 0; i < N_MODELOS; i++) {
-			glm::mat4 model;
-			model = glm::translate(model, pAtuais[i]); // translate it down so it's at the center of the scene
-			model = glm::scale(model, escalas[i]);	// it's a bit too big for our scene, so scale it down
-
-			ourShader.setMat4("model", model);
-			ourModel.Draw(ourShader);
-		}
+		desenhaCena(ourShader);
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
+        terminaFrame();
         glfwSwapBuffers(window);
-        glfwPollEvents();
+        replay.pollEvents(window);
+        // troca os assets reimportados entre dois frames, quando nada est sendo desenhado
+        assets.update();
     }
+    replay.close();
+    assets.stopWatching();
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
+    liberaGL();
     glfwTerminate();
     return 0;
 }
 
-void animacao(Shader s, Model m, GLFWwindow* window, float tempoTotal) {
+// define view/projection no shader e guarda as matrizes para o cu do frame
+void defineCamera(Shader &s, const glm::mat4 &projection, const glm::mat4 &view) {
+	s.setMat4("projection", projection);
+	s.setMat4("view", view);
+	projecaoAtual = projection;
+	viewAtual = view;
+}
+
+// o cu fica no plano de fundo (z = w) e  desenhado depois dos modelos: o teste de profundidade descarta
+// cedo os pixels cobertos por eles
+void desenhaCeu() {
+	ceu.Draw(viewAtual, projecaoAtual);
+}
+
+void desenhaModelo(Shader &s, const RenderMesh &r, const glm::mat4 &model) {
+	s.setMat4("model", model);
+	r.Asset->RequestTextures(viewAtual, projecaoAtual, model, SCR_HEIGHT, r.FirstMesh, r.MeshCount);
+	r.Asset->Draw(s, r.FirstMesh, r.MeshCount);
+}
+
+// o sistema de transformaes atualiza as matrizes da cena; as entidades cuja esfera envolvente est fora da vista
+// no so desenhadas. O teste de visibilidade roda em jobs, e o desenho, na ordem da cena, fica nesta thread
+size_t desenhaCena(Shader &s) {
+	cena.update();
+	Frustum vista(projecaoAtual * viewAtual);
+	size_t total = cena.Renders.size();
+	unsigned char *visivel = FrameArena.allocate<unsigned char>(total);
+	Jobs.parallelFor(total, 64, [&](size_t primeiro, size_t ultimo) {
+		for (size_t i = primeiro; i < ultimo; i++) {
+			Entity e = cena.Renders.entity(i);
+			const BoundingSphere *esfera = cena.Bounds.find(e);
+			visivel[i] = cena.Transforms.has(e) && (!esfera || vista.intersects(esfera->Center, esfera->Radius));
+		}
+	});
+	size_t desenhadas = 0;
+	for (size_t i = 0; i < total; i++)
+		if (visivel[i]) {
+			desenhaModelo(s, cena.Renders.at(i), cena.Transforms.world(cena.Renders.entity(i)));
+			desenhadas++;
+		}
+	return desenhadas;
+}
+
+// as texturas usadas no frame trazem de volta os mips que precisam e, acima do oramento, as menos necessrias
+// perdem os mips de cima
+void terminaFrame() {
+	desenhaCeu();
+	// os mips que chegaram  GPU entram nas texturas antes das decises deste frame
+	envios.poll();
+	residencia.update();
+	// os dados temporrios do frame so liberados de uma vez
+	FrameArena.reset();
+}
+
+// renderiza a cena de cada cmera fixa num framebuffer offscreen e compara com a imagem de referncia. Cada cmera
+// fica na sua posio olhando para o centro dos modelos da cena. Um frame sem nenhum modelo, ou igual ao de outra
+// cmera, falha tambm ao atualizar: uma referncia assim no verifica nada.
+// retorna o nmero de frames que falharam
+int renderGolden(Shader &s, bool atualiza) {
+	int falhas = 0;
+	OffscreenTarget target(SCR_WIDTH, SCR_HEIGHT);
+
+	// o centro da caixa que envolve as esferas dos modelos
+	cena.update();
+	glm::vec3 minimo(0.0f), maximo(0.0f);
+	for (size_t i = 0; i < cena.Bounds.size(); i++) {
+		const BoundingSphere &esfera = cena.Bounds.at(i);
+		glm::vec3 menor = esfera.Center - glm::vec3(esfera.Radius), maior = esfera.Center + glm::vec3(esfera.Radius);
+		minimo = i == 0 ? menor : glm::min(minimo, menor);
+		maximo = i == 0 ? maior : glm::max(maximo, maior);
+	}
+	glm::vec3 centro = (minimo + maximo) * 0.5f;
+
+	std::vector<GoldenImage> frames;
+	for (size_t c = 0; c < cena.Cameras.size(); c++) {
+		target.bind();
+		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		s.use();
+
+		// view/projection transformations
+		Camera &camera = cena.Cameras.at(c);
+		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 view = glm::lookAt(camera.Position, centro, camera.WorldUp);
+		defineCamera(s, projection, view);
+
+		// render the loaded model
+		size_t desenhadas = desenhaCena(s);
+		desenhaCeu();
+		glFinish();
+
+		std::string nome = "camera" + std::to_string(c);
+		GoldenImage frame = target.readPixels();
+		size_t igual = 0;
+		while (igual < frames.size() && frames[igual].pixels != frame.pixels)
+			igual++;
+		if (desenhadas == 0) {
+			LOG_ERROR("GOLDEN::FAIL %s draws none of the scene's models", nome);
+			falhas++;
+		}
+		else if (igual < frames.size()) {
+			LOG_ERROR("GOLDEN::FAIL %s renders the same frame as camera%u", nome, (unsigned)igual);
+			falhas++;
+		}
+		else if (!CompareGolden(frame, FileSystem::getPath("resources/golden/" + nome + ".ppm"), "golden_" + nome, GOLDEN_PSNR_MIN, atualiza))
+			falhas++;
+		frames.push_back(frame);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return falhas;
+}
+
+#ifdef LOGL_BENCHMARKS
+// desenha a vista da primeira cmera num framebuffer offscreen e conta as alocaes do heap de cada desenhaCena
+// (--check-draw): malhas, modelos e shaders s so movidos e o que  de um frame vai para a FrameArena, ento
+// desenhar no aloca nada, e muito menos copia vrtices. O primeiro frame prepara o que  criado no primeiro uso
+// (variantes de shader, pedidos de textura, blocos da arena, filas dos jobs) e no  contado.
+// Retorna o nmero de frames que alocaram, ou 1 quando no h nada na cena para desenhar
+int verificaDesenho(Shader &s) {
+	const int FRAMES = 3;
+	if (cena.Renders.size() == 0) {
+		LOG_ERROR("DRAW::FAIL the scene has nothing to draw");
+		return 1;
+	}
+	int falhas = 0;
+	OffscreenTarget target(SCR_WIDTH, SCR_HEIGHT);
+	target.bind();
+	s.use();
+	Camera &camera = cena.Cameras.at(0);
+	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+	defineCamera(s, projection, camera.GetViewMatrix());
+	for (int frame = 0; frame <= FRAMES; frame++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		unsigned long long antes = HeapAllocations;
+		desenhaCena(s);
+		unsigned long long alocacoes = HeapAllocations - antes;
+		glFinish();
+		FrameArena.reset();
+		if (frame == 0)
+			continue;
+		if (alocacoes > 0) {
+			LOG_ERROR("DRAW::FAIL frame %d: %llu heap allocations drawing %u entities", frame, alocacoes, (unsigned)cena.Renders.size());
+			falhas++;
+		}
+		else
+			LOG_INFO("DRAW::PASS frame %d: no heap allocations drawing %u entities", frame, (unsigned)cena.Renders.size());
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return falhas;
+}
+#endif
+
+void animacao(Shader &s, GLFWwindow* window, float tempoTotal) {
 	// per-frame time logic
 	int passosRestantes = N_PASSOS_MODELO;
-	float inicio = glfwGetTime();
-	currentFrame = glfwGetTime();
-	glm::vec3 pInicial = pAtuais[modeloAtual];
+	float inicio = replay.getTime();
+	currentFrame = replay.getTime();
+	glm::vec3 pInicial = cena.Transforms.position(modeloAtual);
 
 	// 1
 	deltaTime = currentFrame - inicio;
 	passosRestantes--;
 	// 2
-	currentFrame = glfwGetTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
-	bezier(s, m, window, (float)((tempoTotal - deltaTime) / passosRestantes), pInicial, glm::vec3(1.0f, 0.5f, 0.0f), glm::vec3(1.5f, 1.5f, 0.0f));
+	bezier(s, window, (float)((tempoTotal - deltaTime) / passosRestantes), pInicial, glm::vec3(1.0f, 0.5f, 0.0f), glm::vec3(1.5f, 1.5f, 0.0f));
 	passosRestantes--;
 	// 3
-	currentFrame = glfwGetTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
-	rotacao(s, m, window, (float)((tempoTotal - deltaTime) / passosRestantes));
+	rotacao(s, window, (float)((tempoTotal - deltaTime) / passosRestantes));
 	passosRestantes--;
 	// 4
-	currentFrame = glfwGetTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
-	translacao(s, m, window, (float)((tempoTotal - deltaTime) / passosRestantes));
+	translacao(s, window, (float)((tempoTotal - deltaTime) / passosRestantes));
 }
 
 // rotacao
-void rotacaoPonto(Shader s, Model m, GLFWwindow* window, float tempo, glm::vec3 p) {
+void rotacaoPonto(Shader &s, GLFWwindow* window, float tempo, glm::vec3 p) {
 	// per-frame time logic
-	float inicio = glfwGetTime();
-	currentFrame = glfwGetTime();
+	float inicio = replay.getTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
 
 	float angulo;
+	glm::vec3 pInicial = cena.Transforms.position(modeloAtual);
 
 	while (deltaTime <= tempo) {
 		angulo = (float)((deltaTime * 360.f) / tempo);
@@ -203,38 +668,31 @@ void rotacaoPonto(Shader s, Model m, GLFWwindow* window, float tempo, glm::vec3
 		// don't forget to enable shader before setting uniforms
 		s.use();
 
-		// render the loaded model
-		for (int i = 0; i < N_MODELOS; i++) {
-			glm::mat4 model;
-			if (i == modeloAtual) {
-				model = glm::translate(model, p);
-				model = glm::rotate(model, glm::radians(angulo), glm::vec3(1.0f, 0.0f, 0.0f));
-				model = glm::rotate(model, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-				model = glm::rotate(model, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-				model = glm::translate(model, p);
-			}
-			else
-				model = glm::translate(model, pAtuais[i]);
-			model = glm::scale(model, escalas[i]);	// it's a bit too big for our scene, so scale it down
+		// translada at p, gira e translada de novo: translate(p) * rotate * translate(p) = translate(p + rotate * p) * rotate
+		glm::quat giro = glm::angleAxis(glm::radians(angulo), glm::vec3(1.0f, 0.0f, 0.0f));
+		cena.Transforms.setRotation(modeloAtual, giro);
+		cena.Transforms.setPosition(modeloAtual, p + giro * p);
 
-			s.setMat4("model", model);
-			m.Draw(s);
-		}
+		// render the loaded model
+		desenhaCena(s);
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		terminaFrame();
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		replay.pollEvents(window);
 
-		currentFrame = glfwGetTime();
+		currentFrame = replay.getTime();
 		deltaTime = currentFrame - inicio;
 	}
+	cena.Transforms.setPosition(modeloAtual, pInicial);
+	cena.Transforms.setRotation(modeloAtual, glm::quat());
 }
 
 // rotacao
-void rotacao(Shader s, Model m, GLFWwindow* window, float tempo) {
+void rotacao(Shader &s, GLFWwindow* window, float tempo) {
 	// per-frame time logic
-	float inicio = glfwGetTime();
-	currentFrame = glfwGetTime();
+	float inicio = replay.getTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
 
 	float angulo;
@@ -249,34 +707,26 @@ void rotacao(Shader s, Model m, GLFWwindow* window, float tempo) {
 		// don't forget to enable shader before setting uniforms
 		s.use();
 
-		// render the loaded model
-		for (int i = 0; i < N_MODELOS; i++) {
-			glm::mat4 model;
-			model = glm::translate(model, pAtuais[i]);
-			if (i == modeloAtual) {
-				model = glm::rotate(model, glm::radians(0.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-				model = glm::rotate(model, glm::radians(angulo), glm::vec3(0.0f, 1.0f, 0.0f));
-				model = glm::rotate(model, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-			}
-			model = glm::scale(model, escalas[i]);	// it's a bit too big for our scene, so scale it down
+		cena.Transforms.setRotation(modeloAtual, glm::angleAxis(glm::radians(angulo), glm::vec3(0.0f, 1.0f, 0.0f)));
 
-			s.setMat4("model", model);
-			m.Draw(s);
-		}
+		// render the loaded model
+		desenhaCena(s);
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		terminaFrame();
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		replay.pollEvents(window);
 
-		currentFrame = glfwGetTime();
+		currentFrame = replay.getTime();
 		deltaTime = currentFrame - inicio;
 	}
+	cena.Transforms.setRotation(modeloAtual, glm::quat());
 }
 
 // bezier
-void bezier(Shader s, Model m, GLFWwindow* window, float tempo, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2) {
-	float inicio = glfwGetTime();
-	currentFrame = glfwGetTime();
+void bezier(Shader &s, GLFWwindow* window, float tempo, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2) {
+	float inicio = replay.getTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
 	float t = (float) deltaTime / tempo;
 
@@ -286,42 +736,36 @@ void bezier(Shader s, Model m, GLFWwindow* window, float tempo, glm::vec3 p0, gl
 
 		s.use();
 
-		printf("t: %f\n", t);
-		pAtuais[modeloAtual].x = pow(1 - t, 2) * p0.x +
+		glm::vec3 pAtual = cena.Transforms.position(modeloAtual);
+		pAtual.x = pow(1 - t, 2) * p0.x +
 			(1 - t) * 2 * t * p1.x +
 			t * t * p2.x;
-		printf("x: %f\n", pAtuais[modeloAtual].x);
 
-		pAtuais[modeloAtual].y = pow(1 - t, 2) * p0.y +
+		pAtual.y = pow(1 - t, 2) * p0.y +
 			(1 - t) * 2 * t * p1.y +
 			t * t * p2.y;
-		printf("y: %f\n", pAtuais[modeloAtual].y);
+		cena.Transforms.setPosition(modeloAtual, pAtual);
+		LOG_THROTTLED(LOG_LEVEL_DEBUG, 100, "bezier t: %f x: %f y: %f", t, pAtual.x, pAtual.y);
 
-		for (int i = 0; i < N_MODELOS; i++) {
-			glm::mat4 model;
-			model = glm::translate(model, pAtuais[i]);
-			model = glm::scale(model, escalas[i]);
-
-			s.setMat4("model", model);
-			m.Draw(s);
-		}
+		desenhaCena(s);
 
+		terminaFrame();
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		replay.pollEvents(window);
 
-		currentFrame = glfwGetTime();
+		currentFrame = replay.getTime();
 		deltaTime = currentFrame - inicio;
 		t = deltaTime * 0.1f;
 	}
 }
 
 // translacao linear
-void translacao(Shader s, Model m, GLFWwindow* window, float tempo) {
+void translacao(Shader &s, GLFWwindow* window, float tempo) {
 	// per-frame time logic
-	float inicio = glfwGetTime();
-	currentFrame = glfwGetTime();
+	float inicio = replay.getTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
-	glm::vec3 pInicial = pAtuais[modeloAtual];
+	glm::vec3 pInicial = cena.Transforms.position(modeloAtual);
 
 	while (deltaTime <= tempo) {
 		// render
@@ -331,32 +775,26 @@ void translacao(Shader s, Model m, GLFWwindow* window, float tempo) {
 		// don't forget to enable shader before setting uniforms
 		s.use();
 
-		pAtuais[modeloAtual].x = pInicial.x + (float)deltaTime * 0.1;
+		cena.Transforms.setPosition(modeloAtual, glm::vec3(pInicial.x + (float)deltaTime * 0.1f, pInicial.y, pInicial.z));
 
 		// render the loaded model
-		for (int i = 0; i < N_MODELOS; i++) {
-			glm::mat4 model;
-			model = glm::translate(model, pAtuais[i]); // translate it down so it's at the center of the scene
-			model = glm::scale(model, escalas[i]);	// it's a bit too big for our scene, so scale it down
-
-			s.setMat4("model", model);
-			m.Draw(s);
-		}
+		desenhaCena(s);
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		terminaFrame();
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		replay.pollEvents(window);
 
-		currentFrame = glfwGetTime();
+		currentFrame = replay.getTime();
 		deltaTime = currentFrame - inicio;
 	}
 }
 
 // escala
-void escala(Shader s, Model m, GLFWwindow* window, float tempo) {
+void escala(Shader &s, GLFWwindow* window, float tempo) {
 	// per-frame time logic
-	float inicio = glfwGetTime();
-	currentFrame = glfwGetTime();
+	float inicio = replay.getTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
 
 	while (deltaTime <= tempo) {
@@ -367,63 +805,57 @@ void escala(Shader s, Model m, GLFWwindow* window, float tempo) {
 		// don't forget to enable shader before setting uniforms
 		s.use();
 
-		escalas[modeloAtual] += (float)deltaTime * 0.0001;
+		cena.Transforms.setScale(modeloAtual, cena.Transforms.scale(modeloAtual) + glm::vec3((float)deltaTime * 0.0001f));
 
 		// render the loaded model
-		for (int i = 0; i < N_MODELOS; i++) {
-			glm::mat4 model;
-			model = glm::translate(model, pAtuais[i]); // translate it down so it's at the center of the scene
-			model = glm::scale(model, escalas[i]);	// it's a bit too big for our scene, so scale it down
-
-			s.setMat4("model", model);
-			m.Draw(s);
-		}
+		desenhaCena(s);
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		terminaFrame();
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		replay.pollEvents(window);
 
-		currentFrame = glfwGetTime();
+		currentFrame = replay.getTime();
 		deltaTime = currentFrame - inicio;
 	}
 }
 
 // FUNES CAMERA
 // animacao
-void animacaoCamera(Shader s, Model m, GLFWwindow* window, float tempoTotal) {
+void animacaoCamera(Shader &s, GLFWwindow* window, float tempoTotal) {
 	// per-frame time logic
 	int passosRestantes = N_PASSOS_CAMERA;
-	float inicio = glfwGetTime();
-	currentFrame = glfwGetTime();
-	glm::vec3 pInicial = camera[cameraAtual].Position;
+	float inicio = replay.getTime();
+	currentFrame = replay.getTime();
+	glm::vec3 pInicial = cameraAtiva().Position;
 
 	// 1
 	deltaTime = currentFrame - inicio;
-	translacaoCamera(s, m, window, (float)((tempoTotal - deltaTime) / passosRestantes));
+	translacaoCamera(s, window, (float)((tempoTotal - deltaTime) / passosRestantes));
 	passosRestantes--;
 	// 2
-	currentFrame = glfwGetTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
-	bezierCamera(s, m, window, (float)((tempoTotal - deltaTime) / passosRestantes), pInicial, glm::vec3(1.0f, 0.5f, 0.0f), glm::vec3(1.5f, 1.5f, 0.0f));
+	bezierCamera(s, window, (float)((tempoTotal - deltaTime) / passosRestantes), pInicial, glm::vec3(1.0f, 0.5f, 0.0f), glm::vec3(1.5f, 1.5f, 0.0f));
 	passosRestantes--;
 	// 3
-	currentFrame = glfwGetTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
-	rotacaoCamera(s, m, window, (float)((tempoTotal - deltaTime) / passosRestantes));
+	rotacaoCamera(s, window, (float)((tempoTotal - deltaTime) / passosRestantes));
 	passosRestantes--;
 	// 4
-	currentFrame = glfwGetTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
-	zoomCamera(s, m, window, (float)((tempoTotal - deltaTime) / passosRestantes));
+	zoomCamera(s, window, (float)((tempoTotal - deltaTime) / passosRestantes));
 }
 
 // look at modelo realizando movimento de translao
-void lookModeloCamera(Shader s, Model m, GLFWwindow* window, float tempo, int modelo) {
+void lookModeloCamera(Shader &s, GLFWwindow* window, float tempo, Entity modelo) {
 	// per-frame time logic
-	float inicio = glfwGetTime();
-	currentFrame = glfwGetTime();
+	float inicio = replay.getTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
-	glm::vec3 pInicial = pAtuais[modelo];
+	glm::vec3 pInicial = cena.Transforms.position(modelo);
 
 	while (deltaTime <= tempo) {
 		// render
@@ -433,38 +865,31 @@ void lookModeloCamera(Shader s, Model m, GLFWwindow* window, float tempo, int mo
 		// don't forget to enable shader before setting uniforms
 		s.use();
 
-		pAtuais[modelo].x = pInicial.x + (float)deltaTime * 0.1;
+		cena.Transforms.setPosition(modelo, glm::vec3(pInicial.x + (float)deltaTime * 0.1f, pInicial.y, pInicial.z));
 
 		// view/projection transformations
-		glm::mat4 projection = glm::perspective(glm::radians(camera[cameraAtual].Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		glm::mat4 view = glm::lookAt(camera[cameraAtual].Position, pAtuais[modelo], camera[cameraAtual].Up);
-		s.setMat4("projection", projection);
-		s.setMat4("view", view);
+		glm::mat4 projection = glm::perspective(glm::radians(cameraAtiva().Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 view = glm::lookAt(cameraAtiva().Position, cena.Transforms.position(modelo), cameraAtiva().Up);
+		defineCamera(s, projection, view);
 
 		// render the loaded model
-		for (int i = 0; i < N_MODELOS; i++) {
-			glm::mat4 model;
-			model = glm::translate(model, pAtuais[i]);
-			model = glm::scale(model, escalas[i]);	// it's a bit too big for our scene, so scale it down
-
-			s.setMat4("model", model);
-			m.Draw(s);
-		}
+		desenhaCena(s);
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		terminaFrame();
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		replay.pollEvents(window);
 
-		currentFrame = glfwGetTime();
+		currentFrame = replay.getTime();
 		deltaTime = currentFrame - inicio;
 	}
 }
 
 //lookAt ponto
-void lookPontoCamera(Shader s, Model m, GLFWwindow* window, float tempo, glm::vec3 p) {
+void lookPontoCamera(Shader &s, GLFWwindow* window, float tempo, glm::vec3 p) {
 	// per-frame time logic
-	float inicio = glfwGetTime();
-	currentFrame = glfwGetTime();
+	float inicio = replay.getTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
 
 	while (deltaTime <= tempo) {
@@ -476,35 +901,28 @@ void lookPontoCamera(Shader s, Model m, GLFWwindow* window, float tempo, glm::ve
 		s.use();
 
 		// view/projection transformations
-		glm::mat4 projection = glm::perspective(glm::radians(camera[cameraAtual].Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		glm::mat4 view = glm::lookAt(camera[cameraAtual].Position, p, camera[cameraAtual].Up);
-		s.setMat4("projection", projection);
-		s.setMat4("view", view);
+		glm::mat4 projection = glm::perspective(glm::radians(cameraAtiva().Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 view = glm::lookAt(cameraAtiva().Position, p, cameraAtiva().Up);
+		defineCamera(s, projection, view);
 
 		// render the loaded model
-		for (int i = 0; i < N_MODELOS; i++) {
-			glm::mat4 model;
-			model = glm::translate(model, pAtuais[i]);
-			model = glm::scale(model, escalas[i]);	// it's a bit too big for our scene, so scale it down
-
-			s.setMat4("model", model);
-			m.Draw(s);
-		}
+		desenhaCena(s);
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		terminaFrame();
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		replay.pollEvents(window);
 
-		currentFrame = glfwGetTime();
+		currentFrame = replay.getTime();
 		deltaTime = currentFrame - inicio;
 	}
 }
 
 // ruido
-void ruidoCamera(Shader s, Model m, GLFWwindow* window, float tempo) {
+void ruidoCamera(Shader &s, GLFWwindow* window, float tempo) {
 	// per-frame time logic
-	float inicio = glfwGetTime();
-	currentFrame = glfwGetTime();
+	float inicio = replay.getTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
 
 	float yoffset;
@@ -519,45 +937,38 @@ void ruidoCamera(Shader s, Model m, GLFWwindow* window, float tempo) {
 		// don't forget to enable shader before setting uniforms
 		s.use();
 
-		camera[cameraAtual].Position.y += (rand() % 200 - 100)*0.0001f;
+		cameraAtiva().Position.y += ((int)(replay.random() % 200) - 100)*0.0001f;
 
-		if (camera[cameraAtual].Zoom >= 1.0f && camera[cameraAtual].Zoom <= 45.0f)
-			camera[cameraAtual].Zoom -= yoffset;
-		if (camera[cameraAtual].Zoom <= 1.0f)
-			camera[cameraAtual].Zoom = 1.0f;
-		if (camera[cameraAtual].Zoom >= 45.0f)
-			camera[cameraAtual].Zoom = 45.0f;
+		if (cameraAtiva().Zoom >= 1.0f && cameraAtiva().Zoom <= 45.0f)
+			cameraAtiva().Zoom -= yoffset;
+		if (cameraAtiva().Zoom <= 1.0f)
+			cameraAtiva().Zoom = 1.0f;
+		if (cameraAtiva().Zoom >= 45.0f)
+			cameraAtiva().Zoom = 45.0f;
 
 		// view/projection transformations
-		glm::mat4 projection = glm::perspective(glm::radians(camera[cameraAtual].Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		glm::mat4 view = camera[cameraAtual].GetViewMatrix();
-		s.setMat4("projection", projection);
-		s.setMat4("view", view);
+		glm::mat4 projection = glm::perspective(glm::radians(cameraAtiva().Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 view = cameraAtiva().GetViewMatrix();
+		defineCamera(s, projection, view);
 
 		// render the loaded model
-		for (int i = 0; i < N_MODELOS; i++) {
-			glm::mat4 model;
-			model = glm::translate(model, pAtuais[i]);
-			model = glm::scale(model, escalas[i]);	// it's a bit too big for our scene, so scale it down
-
-			s.setMat4("model", model);
-			m.Draw(s);
-		}
+		desenhaCena(s);
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		terminaFrame();
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		replay.pollEvents(window);
 
-		currentFrame = glfwGetTime();
+		currentFrame = replay.getTime();
 		deltaTime = currentFrame - inicio;
 	}
 }
 
 // zoom
-void zoomCamera(Shader s, Model m, GLFWwindow* window, float tempo) {
+void zoomCamera(Shader &s, GLFWwindow* window, float tempo) {
 	// per-frame time logic
-	float inicio = glfwGetTime();
-	currentFrame = glfwGetTime();
+	float inicio = replay.getTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
 
 	float yoffset;
@@ -572,43 +983,36 @@ void zoomCamera(Shader s, Model m, GLFWwindow* window, float tempo) {
 		// don't forget to enable shader before setting uniforms
 		s.use();
 
-		if (camera[cameraAtual].Zoom >= 1.0f && camera[cameraAtual].Zoom <= 45.0f)
-			camera[cameraAtual].Zoom -= yoffset;
-		if (camera[cameraAtual].Zoom <= 1.0f)
-			camera[cameraAtual].Zoom = 1.0f;
-		if (camera[cameraAtual].Zoom >= 45.0f)
-			camera[cameraAtual].Zoom = 45.0f;
+		if (cameraAtiva().Zoom >= 1.0f && cameraAtiva().Zoom <= 45.0f)
+			cameraAtiva().Zoom -= yoffset;
+		if (cameraAtiva().Zoom <= 1.0f)
+			cameraAtiva().Zoom = 1.0f;
+		if (cameraAtiva().Zoom >= 45.0f)
+			cameraAtiva().Zoom = 45.0f;
 
 		// view/projection transformations
-		glm::mat4 projection = glm::perspective(glm::radians(camera[cameraAtual].Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		glm::mat4 view = camera[cameraAtual].GetViewMatrix();
-		s.setMat4("projection", projection);
-		s.setMat4("view", view);
+		glm::mat4 projection = glm::perspective(glm::radians(cameraAtiva().Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 view = cameraAtiva().GetViewMatrix();
+		defineCamera(s, projection, view);
 
 		// render the loaded model
-		for (int i = 0; i < N_MODELOS; i++) {
-			glm::mat4 model;
-			model = glm::translate(model, pAtuais[i]);
-			model = glm::scale(model, escalas[i]);	// it's a bit too big for our scene, so scale it down
-
-			s.setMat4("model", model);
-			m.Draw(s);
-		}
+		desenhaCena(s);
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		terminaFrame();
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		replay.pollEvents(window);
 
-		currentFrame = glfwGetTime();
+		currentFrame = replay.getTime();
 		deltaTime = currentFrame - inicio;
 	}
 }
 
 // rotacao num ponto
-void rotacaoPontoCamera(Shader s, Model m, GLFWwindow* window, float tempo, glm::vec3 p) {
+void rotacaoPontoCamera(Shader &s, GLFWwindow* window, float tempo, glm::vec3 p) {
 	// per-frame time logic
-	float inicio = glfwGetTime();
-	currentFrame = glfwGetTime();
+	float inicio = replay.getTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
 
 	float angulo;
@@ -623,41 +1027,34 @@ void rotacaoPontoCamera(Shader s, Model m, GLFWwindow* window, float tempo, glm:
 		// don't forget to enable shader before setting uniforms
 		s.use();
 
-		camera[cameraAtual].Position = p;
+		cameraAtiva().Position = p;
 
 		// view/projection transformations
-		glm::mat4 projection = glm::perspective(glm::radians(camera[cameraAtual].Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		glm::mat4 view = camera[cameraAtual].GetViewMatrix();
+		glm::mat4 projection = glm::perspective(glm::radians(cameraAtiva().Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 view = cameraAtiva().GetViewMatrix();
 		view = glm::rotate(view, glm::radians(0.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 		view = glm::rotate(view, glm::radians(angulo), glm::vec3(0.0f, 1.0f, 0.0f));
 		view = glm::rotate(view, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		s.setMat4("projection", projection);
-		s.setMat4("view", view);
+		defineCamera(s, projection, view);
 
 		// render the loaded model
-		for (int i = 0; i < N_MODELOS; i++) {
-			glm::mat4 model;
-			model = glm::translate(model, pAtuais[i]);
-			model = glm::scale(model, escalas[i]);	// it's a bit too big for our scene, so scale it down
-
-			s.setMat4("model", model);
-			m.Draw(s);
-		}
+		desenhaCena(s);
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		terminaFrame();
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		replay.pollEvents(window);
 
-		currentFrame = glfwGetTime();
+		currentFrame = replay.getTime();
 		deltaTime = currentFrame - inicio;
 	}
 }
 
 // rotacao
-void rotacaoCamera(Shader s, Model m, GLFWwindow* window, float tempo) {
+void rotacaoCamera(Shader &s, GLFWwindow* window, float tempo) {
 	// per-frame time logic
-	float inicio = glfwGetTime();
-	currentFrame = glfwGetTime();
+	float inicio = replay.getTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
 
 	float angulo;
@@ -673,37 +1070,30 @@ void rotacaoCamera(Shader s, Model m, GLFWwindow* window, float tempo) {
 		s.use();
 
 		// view/projection transformations
-		glm::mat4 projection = glm::perspective(glm::radians(camera[cameraAtual].Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		glm::mat4 view = camera[cameraAtual].GetViewMatrix();
+		glm::mat4 projection = glm::perspective(glm::radians(cameraAtiva().Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 view = cameraAtiva().GetViewMatrix();
 		view = glm::rotate(view, glm::radians(0.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 		view = glm::rotate(view, glm::radians(angulo), glm::vec3(0.0f, 1.0f, 0.0f));
 		view = glm::rotate(view, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		s.setMat4("projection", projection);
-		s.setMat4("view", view);
+		defineCamera(s, projection, view);
 
 		// render the loaded model
-		for (int i = 0; i < N_MODELOS; i++) {
-			glm::mat4 model;
-			model = glm::translate(model, pAtuais[i]);
-			model = glm::scale(model, escalas[i]);	// it's a bit too big for our scene, so scale it down
-
-			s.setMat4("model", model);
-			m.Draw(s);
-		}
+		desenhaCena(s);
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		terminaFrame();
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		replay.pollEvents(window);
 
-		currentFrame = glfwGetTime();
+		currentFrame = replay.getTime();
 		deltaTime = currentFrame - inicio;
 	}
 }
 
 // bezier
-void bezierCamera(Shader s, Model m, GLFWwindow* window, float tempo, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2) {
-	float inicio = glfwGetTime();
-	currentFrame = glfwGetTime();
+void bezierCamera(Shader &s, GLFWwindow* window, float tempo, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2) {
+	float inicio = replay.getTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
 	float t = (float)deltaTime / tempo;
 
@@ -713,46 +1103,37 @@ void bezierCamera(Shader s, Model m, GLFWwindow* window, float tempo, glm::vec3
 
 		s.use();
 
-		printf("t: %f\n", t);
-		camera[cameraAtual].Position.x = pow(1 - t, 2) * p0.x +
+		cameraAtiva().Position.x = pow(1 - t, 2) * p0.x +
 			(1 - t) * 2 * t * p1.x +
 			t * t * p2.x;
-		printf("x: %f\n", camera[cameraAtual].Position.x);
 
-		camera[cameraAtual].Position.y = pow(1 - t, 2) * p0.y +
+		cameraAtiva().Position.y = pow(1 - t, 2) * p0.y +
 			(1 - t) * 2 * t * p1.y +
 			t * t * p2.y;
-		printf("y: %f\n", camera[cameraAtual].Position.y);
+		LOG_THROTTLED(LOG_LEVEL_DEBUG, 100, "bezierCamera t: %f x: %f y: %f", t, cameraAtiva().Position.x, cameraAtiva().Position.y);
 
 		// view/projection transformations
-		glm::mat4 projection = glm::perspective(glm::radians(camera[cameraAtual].Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		glm::mat4 view = camera[cameraAtual].GetViewMatrix();
-		s.setMat4("projection", projection);
-		s.setMat4("view", view);
-
-		for (int i = 0; i < N_MODELOS; i++) {
-			glm::mat4 model;
-			model = glm::translate(model, pAtuais[i]);
-			model = glm::scale(model, escalas[i]);
-
-			s.setMat4("model", model);
-			m.Draw(s);
-		}
+		glm::mat4 projection = glm::perspective(glm::radians(cameraAtiva().Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 view = cameraAtiva().GetViewMatrix();
+		defineCamera(s, projection, view);
+
+		desenhaCena(s);
 
+		terminaFrame();
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		replay.pollEvents(window);
 
-		currentFrame = glfwGetTime();
+		currentFrame = replay.getTime();
 		deltaTime = currentFrame - inicio;
 		t = deltaTime * 0.1f;
 	}
 }
 
 // translacao linear camera
-void translacaoCamera(Shader s, Model m, GLFWwindow* window, float tempo) {
+void translacaoCamera(Shader &s, GLFWwindow* window, float tempo) {
 	// per-frame time logic
-	float inicio = glfwGetTime();
-	currentFrame = glfwGetTime();
+	float inicio = replay.getTime();
+	currentFrame = replay.getTime();
 	deltaTime = currentFrame - inicio;
 
 	while (deltaTime <= tempo) {
@@ -763,107 +1144,101 @@ void translacaoCamera(Shader s, Model m, GLFWwindow* window, float tempo) {
 		// don't forget to enable shader before setting uniforms
 		s.use();
 
-		camera[cameraAtual].Position.x += (float)deltaTime * 0.01;
+		cameraAtiva().Position.x += (float)deltaTime * 0.01;
 
 		// view/projection transformations
-		glm::mat4 projection = glm::perspective(glm::radians(camera[cameraAtual].Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		glm::mat4 view = camera[cameraAtual].GetViewMatrix();
-		s.setMat4("projection", projection);
-		s.setMat4("view", view);
+		glm::mat4 projection = glm::perspective(glm::radians(cameraAtiva().Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 view = cameraAtiva().GetViewMatrix();
+		defineCamera(s, projection, view);
 
 		// render the loaded model
-		for (int i = 0; i < N_MODELOS; i++) {
-			glm::mat4 model;
-			model = glm::translate(model, pAtuais[i]); // translate it down so it's at the center of the scene
-			model = glm::scale(model, escalas[i]);	// it's a bit too big for our scene, so scale it down
-
-			s.setMat4("model", model);
-			m.Draw(s);
-		}
+		desenhaCena(s);
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		terminaFrame();
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		replay.pollEvents(window);
 
-		currentFrame = glfwGetTime();
+		currentFrame = replay.getTime();
 		deltaTime = currentFrame - inicio;
 	}
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
-void processInput(Shader s, Model m, GLFWwindow *window)
+void processInput(Shader &s, GLFWwindow *window)
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    if (replay.getKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    if (glfwGetKey(window, GLFW_KEY_KP_8) == GLFW_PRESS)
-		camera[cameraAtual].ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_KP_2) == GLFW_PRESS)
-		camera[cameraAtual].ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_KP_4) == GLFW_PRESS)
-		camera[cameraAtual].ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_KP_6) == GLFW_PRESS)
-		camera[cameraAtual].ProcessKeyboard(RIGHT, deltaTime);
+    if (replay.getKey(window, GLFW_KEY_KP_8) == GLFW_PRESS)
+		cameraAtiva().ProcessKeyboard(FORWARD, deltaTime);
+    if (replay.getKey(window, GLFW_KEY_KP_2) == GLFW_PRESS)
+		cameraAtiva().ProcessKeyboard(BACKWARD, deltaTime);
+    if (replay.getKey(window, GLFW_KEY_KP_4) == GLFW_PRESS)
+		cameraAtiva().ProcessKeyboard(LEFT, deltaTime);
+    if (replay.getKey(window, GLFW_KEY_KP_6) == GLFW_PRESS)
+		cameraAtiva().ProcessKeyboard(RIGHT, deltaTime);
 	// ---------------------------------------------------------------------------------------------
 	// TROCA MODELOS
-	if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
-		modeloAtual = (int)((modeloAtual + 1) % N_MODELOS);
+	if (replay.getKey(window, GLFW_KEY_M) == GLFW_PRESS) {
+		size_t atual = std::find(instancias.begin(), instancias.end(), modeloAtual) - instancias.begin();
+		modeloAtual = instancias[(atual + 1) % instancias.size()];
 		Sleep(500.0f);
 	}
 	// TROCA CAMERAS
-	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
-		cameraAtual = (int)((cameraAtual + 1) % N_CAMERAS);
+	if (replay.getKey(window, GLFW_KEY_C) == GLFW_PRESS) {
+		cameraAtual = cena.Cameras.next(cameraAtual);
 		Sleep(500.0f);
 	}
 	// MODELOS
 	// TRANSLAO LINEAR EIXO X
-	if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS)
-		translacao(s, m, window, 5.0f);
+	if (replay.getKey(window, GLFW_KEY_T) == GLFW_PRESS)
+		translacao(s, window, 5.0f);
 	// BEZIER QUADRTICO
-	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS)
-		bezier(s, m, window, 5.0f, pAtuais[modeloAtual], glm::vec3(1.0f, 0.5f, 0.0f), glm::vec3(1.5f, 1.5f, 0.0f));
+	if (replay.getKey(window, GLFW_KEY_B) == GLFW_PRESS)
+		bezier(s, window, 5.0f, cena.Transforms.position(modeloAtual), glm::vec3(1.0f, 0.5f, 0.0f), glm::vec3(1.5f, 1.5f, 0.0f));
 	// ROTAO
-	if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
-		rotacao(s, m, window, 5.0f);
+	if (replay.getKey(window, GLFW_KEY_R) == GLFW_PRESS)
+		rotacao(s, window, 5.0f);
 	// ROTAO NUM PONTO
-	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
-		rotacaoPonto(s, m, window, 10.0f, glm::vec3(0.25f, 0.0f, 0.0f));
+	if (replay.getKey(window, GLFW_KEY_P) == GLFW_PRESS)
+		rotacaoPonto(s, window, 10.0f, glm::vec3(0.25f, 0.0f, 0.0f));
 	// ESCALA
-	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-		escala(s, m, window, 1.0f);
+	if (replay.getKey(window, GLFW_KEY_E) == GLFW_PRESS)
+		escala(s, window, 1.0f);
 	// ANIMAO
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-		animacao(s, m, window, 10.0f);
+	if (replay.getKey(window, GLFW_KEY_A) == GLFW_PRESS)
+		animacao(s, window, 10.0f);
 	// ---------------------------------------------------------------------------------------------
 	// CAMERAS
 	// TRANSLAO LINEAR EIXO X
-	if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
-		translacaoCamera(s, m, window, 2.0f);
+	if (replay.getKey(window, GLFW_KEY_1) == GLFW_PRESS)
+		translacaoCamera(s, window, 2.0f);
 	// BEZIER QUADRTICO p0 = ponto atual p1 = 1 0.5 0 p2 = 1.5 1.5 0
-	if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
-		bezierCamera(s, m, window, 5.0f, camera[cameraAtual].Position, glm::vec3(1.0f, 0.5f, 0.0f), glm::vec3(1.5f, 1.5f, 0.0f));
+	if (replay.getKey(window, GLFW_KEY_2) == GLFW_PRESS)
+		bezierCamera(s, window, 5.0f, cameraAtiva().Position, glm::vec3(1.0f, 0.5f, 0.0f), glm::vec3(1.5f, 1.5f, 0.0f));
 	// ROTAO
-	if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
-		rotacaoCamera(s, m, window, 5.0f);
+	if (replay.getKey(window, GLFW_KEY_3) == GLFW_PRESS)
+		rotacaoCamera(s, window, 5.0f);
 	// ROTAO NUM PONTO
-	if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS)
-		rotacaoPontoCamera(s, m, window, 10.0f, glm::vec3(-0.25f, 0.5f, 4.0f));
+	if (replay.getKey(window, GLFW_KEY_4) == GLFW_PRESS)
+		rotacaoPontoCamera(s, window, 10.0f, glm::vec3(-0.25f, 0.5f, 4.0f));
 	// ZOOM
-	if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS)
-		zoomCamera(s, m, window, 0.25f);
+	if (replay.getKey(window, GLFW_KEY_5) == GLFW_PRESS)
+		zoomCamera(s, window, 0.25f);
 	// RUIDO
-	if (glfwGetKey(window, GLFW_KEY_6) == GLFW_PRESS)
-		ruidoCamera(s, m, window, 2.0f);
+	if (replay.getKey(window, GLFW_KEY_6) == GLFW_PRESS)
+		ruidoCamera(s, window, 2.0f);
 	// LOOK AT PONTO
-	if (glfwGetKey(window, GLFW_KEY_7) == GLFW_PRESS)
-		lookPontoCamera(s, m, window, 5.0f, glm::vec3(-0.5f, 0.0f, 0.0f));
+	if (replay.getKey(window, GLFW_KEY_7) == GLFW_PRESS)
+		lookPontoCamera(s, window, 5.0f, glm::vec3(-0.5f, 0.0f, 0.0f));
 	// LOOK AT PONTO
-	if (glfwGetKey(window, GLFW_KEY_8) == GLFW_PRESS)
-		lookModeloCamera(s, m, window, 5.0f, 0);
+	if (replay.getKey(window, GLFW_KEY_8) == GLFW_PRESS)
+		lookModeloCamera(s, window, 5.0f, instancias[0]);
 	// ANIMAO
-	if (glfwGetKey(window, GLFW_KEY_9) == GLFW_PRESS)
-		animacaoCamera(s, m, window, 10.0f);
+	if (replay.getKey(window, GLFW_KEY_9) == GLFW_PRESS)
+		animacaoCamera(s, window, 10.0f);
 	// ---------------------------------------------------------------------------------------------
 }
 
@@ -880,6 +1255,9 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 // -------------------------------------------------------
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 {
+    if (!replay.acceptEvent(REPLAY_CURSOR, xpos, ypos))
+        return;
+
     if (firstMouse)
     {
         lastX = xpos;
@@ -893,12 +1271,15 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
     lastX = xpos;
     lastY = ypos;
 
-	camera[cameraAtual].ProcessMouseMovement(xoffset, yoffset);
+	cameraAtiva().ProcessMouseMovement(xoffset, yoffset);
 }
 
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
-	camera[cameraAtual].ProcessMouseScroll(yoffset);
+	if (!replay.acceptEvent(REPLAY_SCROLL, xoffset, yoffset))
+		return;
+
+	cameraAtiva().ProcessMouseScroll(yoffset);
 }
@@ -0,0 +1,153 @@
+// Packs a resource directory into one archive for includes/learnopengl/archive.h:
+//     pack_assets <root> <directory> <archive>
+// Every file under <root>/<directory> (dot files excluded) is stored under its path relative to <root>.
+#include <learnopengl/archive.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+struct PackedFile {
+    std::string name;
+    std::vector<char> stored;
+    ArchiveEntry entry;
+};
+
+// relative paths of the files under root/directory, recursively
+void listFiles(const std::string &root, const std::string &directory, std::vector<std::string> &files)
+{
+#ifdef _WIN32
+    WIN32_FIND_DATAA found;
+    HANDLE search = FindFirstFileA((root + "/" + directory + "/*").c_str(), &found);
+    if (search == INVALID_HANDLE_VALUE)
+        return;
+    do
+    {
+        std::string name = found.cFileName;
+        if (name[0] == '.')
+            continue;
+        if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            listFiles(root, directory + "/" + name, files);
+        else
+            files.push_back(directory + "/" + name);
+    } while (FindNextFileA(search, &found));
+    FindClose(search);
+#else
+    DIR* dir = opendir((root + "/" + directory).c_str());
+    if (!dir)
+        return;
+    while (dirent* item = readdir(dir))
+    {
+        std::string name = item->d_name;
+        if (name[0] == '.')
+            continue;
+        struct stat info;
+        if (stat((root + "/" + directory + "/" + name).c_str(), &info) != 0)
+            continue;
+        if (S_ISDIR(info.st_mode))
+            listFiles(root, directory + "/" + name, files);
+        else
+            files.push_back(directory + "/" + name);
+    }
+    closedir(dir);
+#endif
+}
+
+bool hashOrder(const PackedFile &a, const PackedFile &b)
+{
+    return a.entry.hash < b.entry.hash;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 4)
+    {
+        std::fprintf(stderr, "usage: pack_assets <root> <directory> <archive>\n");
+        return 1;
+    }
+    std::string root = argv[1];
+    std::vector<std::string> names;
+    listFiles(root, argv[2], names);
+
+    std::vector<PackedFile> files(names.size());
+    size_t totalSize = 0, totalStored = 0;
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        PackedFile &file = files[i];
+        file.name = names[i];
+        std::memset(&file.entry, 0, sizeof(file.entry));
+        std::ifstream in((root + "/" + file.name).c_str(), std::ios::binary);
+        std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (!in.good() && !in.eof())
+        {
+            std::fprintf(stderr, "pack_assets: can't read %s\n", file.name.c_str());
+            return 1;
+        }
+        // compressed only when it saves at least an eighth; images are usually compressed already. glTF binaries are
+        // always stored, their buffers are uploaded to GL straight from the mapped archive
+        std::string extension = file.name.substr(file.name.find_last_of('.') + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        std::vector<char> compressed;
+        if (!data.empty() && extension != "glb" && extension != "bin")
+            ArchiveCompress(&data[0], data.size(), compressed);
+        bool useCompressed = !compressed.empty() && compressed.size() < data.size() - data.size() / 8;
+        file.stored.swap(useCompressed ? compressed : data);
+        file.entry.hash = Cache::Hash(file.name);
+        file.entry.size = useCompressed ? data.size() : file.stored.size();
+        file.entry.storedSize = file.stored.size();
+        file.entry.compression = useCompressed ? ARCHIVE_LZ : ARCHIVE_STORED;
+        file.entry.nameSize = (uint32_t)file.name.size();
+        totalSize += (size_t)file.entry.size;
+        totalStored += file.stored.size();
+    }
+    std::sort(files.begin(), files.end(), hashOrder);
+
+    // header, index and path table, then the data
+    ArchiveHeader header = { ARCHIVE_MAGIC, ARCHIVE_VERSION, (uint32_t)files.size(), 0 };
+    std::string namesTable;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        files[i].entry.nameOffset = (uint32_t)namesTable.size();
+        namesTable += files[i].name;
+    }
+    header.namesSize = (uint32_t)namesTable.size();
+    size_t offset = sizeof(ArchiveHeader) + files.size() * sizeof(ArchiveEntry) + namesTable.size();
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        offset = (offset + ARCHIVE_ALIGNMENT - 1) / ARCHIVE_ALIGNMENT * ARCHIVE_ALIGNMENT;
+        files[i].entry.offset = offset;
+        offset += files[i].stored.size();
+    }
+
+    std::ofstream out(argv[3], std::ios::binary);
+    out.write((const char*)&header, sizeof(header));
+    for (size_t i = 0; i < files.size(); i++)
+        out.write((const char*)&files[i].entry, sizeof(ArchiveEntry));
+    out.write(namesTable.data(), namesTable.size());
+    size_t position = sizeof(ArchiveHeader) + files.size() * sizeof(ArchiveEntry) + namesTable.size();
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        static const char padding[ARCHIVE_ALIGNMENT] = { 0 };
+        out.write(padding, (std::streamsize)(files[i].entry.offset - position));
+        if (!files[i].stored.empty())
+            out.write(&files[i].stored[0], files[i].stored.size());
+        position = (size_t)files[i].entry.offset + files[i].stored.size();
+    }
+    if (!out)
+    {
+        std::fprintf(stderr, "pack_assets: can't write %s\n", argv[3]);
+        return 1;
+    }
+    std::printf("pack_assets: %u files, %.1f MB (%.1f MB stored) -> %s\n", (unsigned int)files.size(), totalSize / 1048576.0,
+                totalStored / 1048576.0, argv[3]);
+    return 0;
+}